@@ -0,0 +1,172 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <mutex>
+#include <thread>
+#include "Annotation.h"
+#include "Search.h"
+
+static const char EvalMagic[8] = "CBEVALS";
+// a move that leaves a won position won is not a mistake however much the margin shrinks
+static const int MarkScoreCap = 1000;
+
+const char* moveMarkText(int mark)
+{
+    switch (mark) {
+        case MarkInaccuracy: return "?!";
+        case MarkMistake: return "?";
+        case MarkBlunder: return "??";
+        default: return "";
+    }
+}
+
+GameAnnotator::GameAnnotator(const AnnotateOptions& options)
+    : _options(options)
+{
+    _options.threads = std::max(1, _options.threads);
+}
+
+bool GameAnnotator::build(const GameDatabase& database, std::ostream& log)
+{
+    _stats = AnnotateStats();
+    auto start = std::chrono::steady_clock::now();
+    const uint64_t games = database.size();
+
+    // every game takes its plies + 1 records, so a game's records can be written as soon as it is done
+    std::vector<uint64_t> gameStarts(games + 1);
+    for (uint64_t id = 0; id < games; id++) {
+        gameStarts[id + 1] = gameStarts[id] + database.game(id).plies + 1;
+    }
+    EvalFileHeader header = {};
+    std::memcpy(header.magic, EvalMagic, sizeof(header.magic));
+    header.version = EvalFileVersion;
+    header.nodes = _options.nodes;
+    header.gameCount = games;
+    header.recordCount = gameStarts[games];
+    header.gameStarts = sizeof(EvalFileHeader);
+    header.records = header.gameStarts + gameStarts.size() * sizeof(uint64_t);
+
+    const std::string path = database.basePath() + ".evals";
+    FILE* file = std::fopen(path.c_str(), "wb");
+    bool ok = file
+        && std::fwrite(&header, sizeof(header), 1, file) == 1
+        && std::fwrite(gameStarts.data(), sizeof(uint64_t), gameStarts.size(), file) == gameStarts.size();
+    std::atomic<bool> failed(!ok);
+    std::mutex fileMutex;
+
+    SearchLimits limits;
+    limits.depth = MAX_PLY - 1;
+    limits.nodes = _options.nodes;
+
+    // games differ a lot in length and every ply is a search, so threads take one game at a time
+    std::atomic<uint64_t> nextGame(0);
+    std::vector<std::thread> workers;
+    for (int i = 0; i < _options.threads && !failed; i++) {
+        workers.emplace_back([&]() {
+            GameState position;
+            Search engine(_options.hashMegabytes);
+            std::vector<BitMove> legal;
+            std::vector<EvalRecord> records;
+            AnnotateStats local;
+            for (uint64_t id = nextGame++; id < games && !failed; id = nextGame++) {
+                const GameView game = database.game(id);
+                records.assign(game.plies + 1, EvalRecord{});
+                engine.clear();
+                char firstMover = WHITE;
+                database.replay(id, position, legal, [&](int ply, const GameState& reached, const BitMove&) {
+                    if (ply == 0) firstMover = reached.color;
+                    const SearchResult result = engine.think(reached, limits);
+                    EvalRecord& record = records[ply];
+                    record.score = int16_t(reached.color == WHITE ? result.score : -result.score);
+                    record.bestMove = result.bestMove;
+                    record.depth = uint8_t(std::clamp(result.depth, 1, 255));
+                    local.nodes += result.nodes;
+                    local.plies++;
+                    return true;
+                });
+
+                // a move is judged by the drop from the score before it to the score after it, for the side that played it
+                for (int ply = 0; ply < game.plies; ply++) {
+                    if (!records[ply].depth || !records[ply + 1].depth) break;
+                    const int before = std::clamp<int>(records[ply].score, -MarkScoreCap, MarkScoreCap);
+                    const int after = std::clamp<int>(records[ply + 1].score, -MarkScoreCap, MarkScoreCap);
+                    const bool whiteMoved = (firstMover == WHITE) == (ply % 2 == 0);
+                    const int loss = whiteMoved ? before - after : after - before;
+                    records[ply].mark = loss >= _options.blunder ? MarkBlunder
+                        : loss >= _options.mistake ? MarkMistake
+                        : loss >= _options.inaccuracy ? MarkInaccuracy : MarkNone;
+                    local.marks[records[ply].mark]++;
+                }
+                local.games++;
+
+                std::lock_guard<std::mutex> lock(fileMutex);
+                if (!seekFile(file, header.records + gameStarts[id] * sizeof(EvalRecord))
+                    || std::fwrite(records.data(), sizeof(EvalRecord), records.size(), file) != records.size()) {
+                    failed = true;
+                }
+            }
+            std::lock_guard<std::mutex> lock(fileMutex);
+            _stats.games += local.games;
+            _stats.plies += local.plies;
+            _stats.nodes += local.nodes;
+            for (int mark = 0; mark < 4; mark++) {
+                _stats.marks[mark] += local.marks[mark];
+            }
+        });
+    }
+    for (auto& thread : workers) {
+        thread.join();
+    }
+    if (file && std::fclose(file) != 0) failed = true;
+
+    _stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (!file || failed) {
+        log << "could not write " << path << std::endl;
+        return false;
+    }
+    log << std::fixed << std::setprecision(1) << "evaluations: " << _stats.plies << " positions of " << _stats.games
+        << " games at " << _options.nodes << " nodes in " << _stats.seconds << "s" << std::endl;
+    return true;
+}
+
+GameEvaluations::GameEvaluations()
+    : _header(nullptr)
+    , _gameStarts(nullptr)
+    , _records(nullptr)
+{
+}
+
+bool GameEvaluations::open(const std::string& basePath)
+{
+    close();
+    if (!_file.open(basePath + ".evals")) return false;
+    _header = reinterpret_cast<const EvalFileHeader*>(_file.data());
+    const bool valid = _file.size() >= sizeof(EvalFileHeader)
+        && std::memcmp(_header->magic, EvalMagic, sizeof(EvalMagic)) == 0
+        && _header->version == EvalFileVersion
+        && _header->records + _header->recordCount * sizeof(EvalRecord) <= _file.size();
+    if (!valid) {
+        close();
+        return false;
+    }
+    _gameStarts = reinterpret_cast<const uint64_t*>(_file.data() + _header->gameStarts);
+    _records = reinterpret_cast<const EvalRecord*>(_file.data() + _header->records);
+    return true;
+}
+
+void GameEvaluations::close()
+{
+    _file.close();
+    _header = nullptr;
+    _gameStarts = nullptr;
+    _records = nullptr;
+}
+
+std::span<const EvalRecord> GameEvaluations::game(uint64_t id) const
+{
+    if (!_header || id >= _header->gameCount) return {};
+    return std::span<const EvalRecord>(_records + _gameStarts[id], _gameStarts[id + 1] - _gameStarts[id]);
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <span>
+#include <string>
+#include "GameDatabase.h"
+#include "MappedFile.h"
+
+//
+// base.evals: an engine evaluation of every position of every game (ply 0 to the last move)
+//   an EvalFileHeader, gameCount + 1 uint64 record starts, then one EvalRecord per position
+// scores are from white's point of view so a game reads as a graph, the mark judges the move played
+// from the position by how much the score dropped for the side that played it
+//
+
+constexpr uint32_t EvalFileVersion = 1;
+
+enum MoveMark : uint8_t {
+    MarkNone,
+    MarkInaccuracy,                 // ?!
+    MarkMistake,                    // ?
+    MarkBlunder                     // ??
+};
+
+struct EvalFileHeader {
+    char magic[8];                  // "CBEVALS"
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t nodes;                 // budget each position was searched with
+    uint64_t gameCount;
+    uint64_t recordCount;
+    uint64_t gameStarts;            // file offsets
+    uint64_t records;
+};
+
+struct EvalRecord {
+    int16_t score;                  // centipawns for white, mates are +-MATE_SCORE less the plies to mate
+    BitMove bestMove;               // null on the final position of a finished game
+    uint8_t mark;                   // MoveMark of the move played from here
+    uint8_t depth;                  // last completed iteration, at least 1, 0 for positions the stored moves could not reach
+};
+static_assert(sizeof(EvalRecord) == 6, "EvalRecord must stay 6 bytes");
+
+struct AnnotateOptions {
+    int threads = 1;
+    uint64_t nodes = 20000;         // per position
+    size_t hashMegabytes = 16;      // per thread
+    // centipawns the mover's score has to drop for each mark, scores are capped at +-1000 first
+    int inaccuracy = 50;
+    int mistake = 100;
+    int blunder = 250;
+};
+
+struct AnnotateStats {
+    uint64_t games = 0;
+    uint64_t plies = 0;             // positions searched
+    uint64_t nodes = 0;
+    uint64_t marks[4] = {};         // moves per MoveMark
+    double seconds = 0.0;
+
+    double pliesPerSecond() const { return seconds > 0.0 ? plies / seconds : 0.0; }
+};
+
+//
+// searches every position of a database with a node budget and writes base.evals
+// each thread takes one game at a time and plays through it with one Search, so the transposition table
+// built for a ply is there for the next; the table is cleared between games, which keeps a game's
+// evaluations the same whatever thread or order it was annotated in
+//
+class GameAnnotator
+{
+public:
+    GameAnnotator(const AnnotateOptions& options);
+
+    bool build(const GameDatabase& database, std::ostream& log);
+    const AnnotateStats& stats() const { return _stats; }
+
+private:
+    AnnotateOptions _options;
+    AnnotateStats _stats;
+};
+
+//
+// reads base.evals through a memory map, safe to share between threads
+//
+class GameEvaluations
+{
+public:
+    GameEvaluations();
+
+    bool open(const std::string& basePath);
+    void close();
+    bool isOpen() const { return _header != nullptr; }
+
+    uint64_t gameCount() const { return _header ? _header->gameCount : 0; }
+    uint64_t nodes() const { return _header ? _header->nodes : 0; }
+    // plies + 1 records, empty for a game outside the file
+    std::span<const EvalRecord> game(uint64_t id) const;
+
+private:
+    MappedFile _file;
+    const EvalFileHeader* _header;
+    const uint64_t* _gameStarts;
+    const EvalRecord* _records;
+};
+
+// "?!", "?", "??" or an empty string
+const char* moveMarkText(int mark);
@@ -0,0 +1,82 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include "BatchEval.h"
+
+// big enough to keep the shared counter quiet, small enough to balance the tail
+constexpr size_t BatchChunk = 64;
+
+BatchEvaluator::BatchEvaluator(const BatchOptions& options)
+    : _options(options)
+    , _seconds(0.0)
+    , _count(0)
+{
+    _options.threads = std::max(1, _options.threads);
+}
+
+template <typename Decode>
+std::vector<BatchResult> BatchEvaluator::run(size_t count, Decode decode)
+{
+    std::vector<BatchResult> results(count);
+    std::atomic<size_t> next(0);
+    const bool search = _options.depth > 0 || _options.nodes > 0;
+
+    SearchLimits limits;
+    limits.depth = _options.depth > 0 ? _options.depth : MAX_PLY - 1;
+    limits.nodes = _options.nodes;
+
+    auto worker = [&]() {
+        GameState position;
+        std::unique_ptr<Search> engine;
+        if (search) engine = std::make_unique<Search>(_options.hashMegabytes);
+
+        for (;;) {
+            const size_t begin = next.fetch_add(BatchChunk);
+            if (begin >= count) break;
+            const size_t end = std::min(count, begin + BatchChunk);
+            for (size_t i = begin; i < end; i++) {
+                BatchResult& result = results[i];
+                if (!decode(i, position)) continue;
+                result.valid = true;
+                if (engine) {
+                    // a fresh table for every position, so a score does not depend on what the thread searched before
+                    engine->clear();
+                    SearchResult searched = engine->think(position, limits);
+                    result.score = searched.score;
+                    result.bestMove = searched.bestMove;
+                    result.nodes = searched.nodes;
+                } else {
+                    result.score = position.evaluate();
+                }
+            }
+        }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int i = 0; i < _options.threads; i++) {
+        workers.emplace_back(worker);
+    }
+    for (auto& thread : workers) {
+        thread.join();
+    }
+    _seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    _count = count;
+    return results;
+}
+
+std::vector<BatchResult> BatchEvaluator::evaluate(std::span<const std::string> fens)
+{
+    return run(fens.size(), [&](size_t index, GameState& position) {
+        return position.initFromFEN(fens[index]);
+    });
+}
+
+std::vector<BatchResult> BatchEvaluator::evaluate(std::span<const PackedPosition> positions)
+{
+    return run(positions.size(), [&](size_t index, GameState& position) {
+        return positions[index].unpack(position);
+    });
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <span>
+#include <string>
+#include <vector>
+#include "PackedPosition.h"
+#include "Search.h"
+
+struct BatchOptions {
+    int threads = 1;
+    int depth = 0;                  // 0 with no node limit means static evaluation only
+    uint64_t nodes = 0;             // fixed node budget per position, 0 for none
+    size_t hashMegabytes = 4;       // per thread
+};
+
+struct BatchResult {
+    bool valid = false;             // false when the input could not be parsed
+    int score = 0;                  // from the side to move's point of view
+    BitMove bestMove;               // null for static evaluation
+    uint64_t nodes = 0;
+};
+
+//
+// scores many independent positions across worker threads
+// each worker owns its GameState and Search, positions are handed out in small chunks
+// the Search is cleared before every position, so results are the same for any thread count
+//
+class BatchEvaluator
+{
+public:
+    BatchEvaluator(const BatchOptions& options);
+
+    std::vector<BatchResult> evaluate(std::span<const std::string> fens);
+    std::vector<BatchResult> evaluate(std::span<const PackedPosition> positions);
+
+    // throughput of the last evaluate call
+    double seconds() const { return _seconds; }
+    double positionsPerSecond() const { return _seconds > 0.0 ? _count / _seconds : 0.0; }
+
+private:
+    // decode(index, position) fills position and returns false for bad input
+    template <typename Decode>
+    std::vector<BatchResult> run(size_t count, Decode decode);
+
+    BatchOptions _options;
+    double _seconds;
+    size_t _count;
+};
@@ -0,0 +1,161 @@
+#include <chrono>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include "Bench.h"
+#include "PackedDataset.h"
+#include "Search.h"
+
+static const char* BenchPositions[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq -",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - -",
+    "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq -",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ -",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - -",
+    "rnbqkb1r/pp1p1ppp/4pn2/2p5/2PP4/5N2/PP2PPPP/RNBQKB1R w KQkq -",
+    "r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq -",
+    "r1bqkbnr/pppp1ppp/2n5/1B2p3/4P3/5N2/PPPP1PPP/RNBQK2R b KQkq -",
+    "rnbqkbnr/pp1ppppp/8/2p5/4P3/8/PPPP1PPP/RNBQKBNR w KQkq c6",
+    "rnbqkb1r/pppppppp/5n2/8/3P4/8/PPP1PPPP/RNBQKBNR w KQkq -",
+    "rnbqkbnr/ppp1pppp/8/3p4/2PP4/8/PP2PPPP/RNBQKBNR b KQkq c3",
+    "r1bqk2r/pppp1ppp/2n2n2/2b1p3/2B1P3/3P1N2/PPP2PPP/RNBQK2R w KQkq -",
+    "rnbqk2r/ppp1bppp/4pn2/3p2B1/2PP4/2N5/PP2PPPP/R2QKBNR w KQkq -",
+    "rnbqkb1r/1p2pppp/p2p1n2/8/3NP3/2N5/PPP2PPP/R1BQKB1R w KQkq -",
+    "r1bq1rk1/ppp2ppp/2np1n2/2b1p3/2B1P3/2PP1N2/PP3PPP/RNBQ1RK1 w - -",
+    "rnbq1rk1/ppp1ppbp/3p1np1/8/2PPP3/2N2N2/PP3PPP/R1BQKB1R w KQ -",
+    "r2qkb1r/pp2nppp/3p4/2pNN1B1/2BnP3/3P4/PPP2PPP/R2bK2R w KQkq -",
+    "2kr3r/pp1q1ppp/2nbpn2/3p4/3P4/2NBPN2/PPQ2PPP/R3K2R w KQ -",
+    "r1b1k2r/ppppnppp/2n2q2/2b5/3NP3/2P1B3/PP3PPP/RN1QKB1R w KQkq -",
+    "4k3/8/8/8/8/8/4P3/4K3 w - -",
+    "8/8/4k3/8/8/4K3/4P3/8 w - -",
+    "8/8/8/4k3/8/8/8/4KR2 w - -",
+    "8/5k2/8/8/8/8/1Q6/4K3 w - -",
+    "6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - -",
+    "8/8/1p6/1P1k4/8/3K4/8/8 w - -",
+    "8/p7/8/1P6/8/8/6k1/K7 w - -",
+    "5k2/8/8/8/8/8/8/3RK3 w - -",
+    "8/8/3k4/8/2PK4/8/8/8 w - -",
+    "r1bqkbnr/pppp1ppp/2n5/4p3/2B1P3/5Q2/PPPP1PPP/RNB1K1NR w KQkq -",
+    "r1bqkb1r/pppp1ppp/2n2n2/4p2Q/2B1P3/8/PPPP1PPP/RNB1K1NR w KQkq -",
+    "3r1rk1/p1q2ppp/1pb1pn2/2p5/2PP4/P1B1PN2/1P1Q1PPP/2R2RK1 w - -",
+    "2r2rk1/1bqnbppp/pp1ppn2/8/2PNP3/1PN1B3/P1Q1BPPP/2RR2K1 w - -",
+    "r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N2N2/PP2BPPP/R1BQ1RK1 w - -",
+    "1r4k1/5ppp/8/8/8/8/5PPP/1R4K1 w - -",
+    "8/8/8/3k4/8/8/2K5/2R5 w - -",
+    "r5k1/5ppp/8/8/8/8/PPP5/1K5R w - -",
+    "6k1/pp3ppp/8/8/8/8/PP3PPP/6K1 w - -",
+    "8/pp3k2/2p5/3p4/3P4/2P5/PP3K2/8 w - -",
+    "4r1k1/pp3ppp/8/3n4/8/2B5/PP3PPP/4R1K1 w - -",
+    "2r3k1/5ppp/p7/1p6/8/P3B3/1P3PPP/2R3K1 w - -",
+    "r1b2rk1/pp1nqppp/2p1p3/3p4/2PPn3/2NBPN2/PPQ2PPP/R4RK1 w - -",
+    "rn1qkbnr/ppp2ppp/3p4/4p3/2B1P1b1/5N2/PPPP1PPP/RNBQK2R w KQkq -",
+    "rnbqkbnr/ppp2ppp/8/3pp3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq d6",
+    "r1bqkbnr/pp1ppppp/2n5/2p5/4P3/2N5/PPPP1PPP/R1BQKBNR w KQkq -",
+    "rnbqk2r/pppp1ppp/5n2/2b1p3/2B1P3/5N2/PPPP1PPP/RNBQK2R w KQkq -",
+    "8/8/8/8/4k3/8/3PPP2/4K3 w - -",
+    "4k2r/8/8/8/8/8/8/R3K3 w Qk -",
+    "r3k3/8/8/8/8/8/8/4K2R b Kq -",
+    "r2q1rk1/pb1nbppp/1p2pn2/2pp4/3P4/1PNBPN2/PB3PPP/R2Q1RK1 w - -"
+};
+
+uint64_t runBench(int depth, std::ostream& out)
+{
+    const int positionCount = sizeof(BenchPositions) / sizeof(BenchPositions[0]);
+    SearchLimits limits;
+    limits.depth = depth;
+    Search search;
+
+    uint64_t totalNodes = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < positionCount; i++) {
+        GameState position;
+        position.initFromFEN(BenchPositions[i]);
+        // every position starts cold so the signature does not depend on the order they run in
+        search.clear();
+        SearchResult result = search.think(position, limits);
+        totalNodes += result.nodes;
+        out << "Position " << (i + 1) << "/" << positionCount << " (" << BenchPositions[i] << "): "
+            << result.nodes << " nodes, bestmove " << GameState::moveToUCI(result.bestMove) << std::endl;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    out << "===========================" << std::endl;
+    out << "Depth           : " << depth << std::endl;
+    out << "Total time (ms) : " << (uint64_t)(seconds * 1000.0) << std::endl;
+    out << "Nodes searched  : " << totalNodes << std::endl;
+    out << "Nodes/second    : " << (uint64_t)(seconds > 0.0 ? totalNodes / seconds : 0.0) << std::endl;
+    return totalNodes;
+}
+
+void runSeeBench(int iterations, std::ostream& out)
+{
+    const int positionCount = sizeof(BenchPositions) / sizeof(BenchPositions[0]);
+    std::vector<GameState> positions(positionCount);
+    std::vector<std::vector<BitMove>> captures(positionCount);
+    for (int i = 0; i < positionCount; i++) {
+        positions[i].initFromFEN(BenchPositions[i]);
+        for (const BitMove& move : positions[i].generateAllMoves()) {
+            if (positions[i].isCapture(move)) captures[i].push_back(move);
+        }
+    }
+
+    uint64_t calls = 0;
+    int64_t checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int iteration = 0; iteration < iterations; iteration++) {
+        for (int i = 0; i < positionCount; i++) {
+            for (const BitMove& move : captures[i]) {
+                checksum += positions[i].see(move);
+                calls++;
+            }
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    out << "SEE calls       : " << calls << std::endl;
+    out << "Checksum        : " << checksum << std::endl;
+    out << "Total time (ms) : " << (uint64_t)(seconds * 1000.0) << std::endl;
+    out << "Calls/second    : " << (uint64_t)(seconds > 0.0 ? calls / seconds : 0.0) << std::endl;
+}
+
+bool runDatasetBench(const std::string& path, int threads, uint64_t seed, std::ostream& out)
+{
+    PackedDataset dataset;
+    if (!dataset.open(path)) {
+        std::cerr << "could not map " << path << std::endl;
+        return false;
+    }
+    threads = std::max(1, threads);
+    const std::vector<uint32_t> order = dataset.blockOrder(seed);
+
+    std::atomic<uint64_t> decoded(0);
+    std::atomic<uint64_t> checksum(0);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int shard = 0; shard < threads; shard++) {
+        workers.emplace_back([&, shard]() {
+            GameState position;
+            uint64_t count = 0;
+            uint64_t keys = 0;
+            dataset.forEachInShard(order, shard, threads, seed, [&](const PackedPosition& record) {
+                if (!record.unpack(position)) return;
+                keys += position.hash;
+                count++;
+            });
+            decoded += count;
+            checksum += keys;
+        });
+    }
+    for (auto& thread : workers) {
+        thread.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    out << "Records         : " << decoded << " of " << dataset.size() << " in " << dataset.blockCount() << " blocks" << std::endl;
+    out << "Checksum        : " << std::hex << checksum << std::dec << std::endl;
+    out << "Total time (ms) : " << (uint64_t)(seconds * 1000.0) << std::endl;
+    out << "Records/second  : " << (uint64_t)(seconds > 0.0 ? decoded / seconds : 0.0) << std::endl;
+    out << "MB/second       : " << (uint64_t)(seconds > 0.0 ? decoded * sizeof(PackedPosition) / seconds / 1e6 : 0.0) << std::endl;
+    return true;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+constexpr int BENCH_DEFAULT_DEPTH = 5;
+
+// Searches a fixed set of positions to a fixed depth on one thread.
+// The node total is the bench signature: it only changes when the search itself changes,
+// so a patch that is meant to be a pure speedup has to leave it alone.
+uint64_t runBench(int depth, std::ostream& out);
+
+// Times GameState::see over every capture in the bench positions and reports calls per second.
+void runSeeBench(int iterations, std::ostream& out);
+
+// Decodes every record of a packed dataset into GameStates on several threads and reports records per second.
+// Returns false, with the error on stderr, when the file cannot be mapped.
+bool runDatasetBench(const std::string& path, int threads, uint64_t seed, std::ostream& out);
@@ -4,6 +4,7 @@
 #include <intrin.h>
 #endif
 #include <iostream>
+#include <cstdint>
 
 enum ChessPiece
 {
@@ -45,6 +46,20 @@ class BitBoard {
         _data |= other;
         return *this;
     }
+    BitBoard& operator|=(const BitBoard& other) {
+        _data |= other._data;
+        return *this;
+    }
+    BitBoard& operator&=(const uint64_t other) {
+        _data &= other;
+        return *this;
+    }
+    BitBoard operator|(const BitBoard& other) const {
+        return BitBoard(_data | other._data);
+    }
+    BitBoard operator&(const BitBoard& other) const {
+        return BitBoard(_data & other._data);
+    }
     BitBoard operator<<(const int shift) const {
         return BitBoard(_data << shift);
     }
@@ -71,6 +86,19 @@ class BitBoard {
         std::cout << std::flush;
     }
 
+    // index of the lowest set bit, -1 when the board is empty
+    int firstBit() const {
+        return _data ? bitScanForward(_data) : -1;
+    }
+
+    int countBits() const {
+#if defined(_MSC_VER) && !defined(__clang__)
+        return (int)__popcnt64(_data);
+#else
+        return __builtin_popcountll(_data);
+#endif
+    }
+
     inline int bitScanForward(uint64_t bb) const {
 #if defined(_MSC_VER) && !defined(__clang__)
         unsigned long index;
@@ -85,20 +113,3 @@ private:
     uint64_t    _data;
 
 };
-
-struct BitMove {
-    int from;
-    int to;
-    int piece;
-    
-    BitMove(int from, int to, ChessPiece piece)
-        : from(from), to(to), piece(piece) { }
-        
-    BitMove() : from(0), to(0), piece(NoPiece) { }
-    
-    bool operator==(const BitMove& other) const {
-        return from == other.from && 
-               to == other.to && 
-               piece == other.piece;
-    }
-};
\ No newline at end of file
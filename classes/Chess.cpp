@@ -1,37 +1,19 @@
 #include "Chess.h"
 #include <limits>
 #include <cmath>
-#include "MagicBitboards.h"
 
 Chess::Chess()
 {
     _grid = new Grid(8, 8);
-    for(int i=0; i<64; i++) {
-        _knightBitboards[i] = generateKnightMoveBitboard(i);
-    }
-    initMagicBitboards();
-    for(int i=0; i<128; i++) { _bitboardLookup[i] = EMPTY_SQUARES; }
-
-    _bitboardLookup['P'] = WHITE_PAWNS;
-    _bitboardLookup['N'] = WHITE_KNIGHTS;
-    _bitboardLookup['B'] = WHITE_BISHOPS;
-    _bitboardLookup['R'] = WHITE_ROOKS;
-    _bitboardLookup['Q'] = WHITE_QUEENS;
-    _bitboardLookup['K'] = WHITE_KING;
-
-    _bitboardLookup['p'] = BLACK_PAWNS;
-    _bitboardLookup['n'] = BLACK_KNIGHTS;
-    _bitboardLookup['b'] = BLACK_BISHOPS;
-    _bitboardLookup['r'] = BLACK_ROOKS;
-    _bitboardLookup['q'] = BLACK_QUEENS;
-    _bitboardLookup['k'] = BLACK_KING;
-
-    _bitboardLookup['0'] = EMPTY_SQUARES;
+    _search.setIterationCallback([this](const SearchResult& iteration) {
+        std::lock_guard<std::mutex> lock(_analysisMutex);
+        _analysisLines.push_back(iteration);
+    });
 }
 
 Chess::~Chess()
 {
-    cleanupMagicBitboards();
+    stopBackgroundSearch();
     delete _grid;
 }
 
@@ -70,8 +52,12 @@ void Chess::setUpBoard()
     _grid->initializeChessSquares(pieceSize, "boardsquare.png");
     FENtoBoard("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR");
 
+    stopBackgroundSearch();
     _currentPlayer = WHITE;
-    _moves = generateAllMoves();
+    _gameState.init(stateString().c_str(), WHITE);
+    _search.clear();
+    _moves = _gameState.generateAllMoves();
+    _opening = nullptr;
     startGame();
 }
 
@@ -142,9 +128,9 @@ bool Chess::canBitMoveFrom(Bit &bit, BitHolder &src)
     if (square) {
         int squareIndex = square->getSquareIndex();
         for(auto move : _moves) {
-            if (move.from == squareIndex) {
+            if (move.from() == squareIndex) {
                 ret = true;
-                auto dest = _grid->getSquareByIndex(move.to);
+                auto dest = _grid->getSquareByIndex(move.to());
                 dest->setHighlighted(true);
             }
         }
@@ -159,7 +145,7 @@ bool Chess::canBitMoveFromTo(Bit &bit, BitHolder &src, BitHolder &dst)
     if (square) {
         int squareIndex = square->getSquareIndex();
         for(auto move : _moves) {
-            if (move.to == squareIndex && move.from == srdsquare->getSquareIndex()) {
+            if (move.to() == squareIndex && move.from() == srdsquare->getSquareIndex()) {
                 return true;
             }
         }
@@ -174,18 +160,43 @@ void Chess::clearBoardHighlights() {
 }
 
 void Chess::bitMovedFromTo(Bit &bit, BitHolder &src, BitHolder &dst) {
+    int fromSquare = static_cast<ChessSquare&>(src).getSquareIndex();
+    int toSquare = static_cast<ChessSquare&>(dst).getSquareIndex();
+    // there is no promotion picker, dragging a pawn to the last rank always makes a queen
+    for (auto move : _moves) {
+        if (move.from() == fromSquare && move.to() == toSquare && (!move.isPromotion() || move.promotion() == Queen)) {
+            makeMove(move);
+            return;
+        }
+    }
+}
+
+void Chess::makeMove(const BitMove& move)
+{
+    // anything searching in the background was looking at the position we are leaving,
+    // unless the human played exactly the reply we were pondering on
+    const bool ponderHit = _pondering && move == _ponderMove;
+    if (!ponderHit) {
+        stopBackgroundSearch();
+    }
+    applySpecialMoveToBoard(move);
+    _gameState.playMove(move);
+    if (const EcoOpening* opening = EcoTable::instance().find(_gameState.hashWithoutEnPassant())) {
+        _opening = opening;
+    }
 
     _currentPlayer = (_currentPlayer == WHITE ? BLACK : WHITE);
-    _moves = generateAllMoves();
+    _moves = _gameState.generateAllMoves();
     clearBoardHighlights();
     endTurn();
     if (_currentPlayer == BLACK) {
-        updateAI();
+        updateAI(ponderHit);
     }
 }
 
 void Chess::stopGame()
 {
+    stopBackgroundSearch();
     _grid->forEachSquare([](ChessSquare* square, int x, int y) {
         square->destroyBit();
     });
@@ -211,7 +222,7 @@ Player* Chess::checkForWinner()
 
 bool Chess::checkForDraw()
 {
-    return false;
+    return _gameState.repetitionCount() >= 2 || _gameState.isFiftyMoveDraw() || _gameState.hasInsufficientMaterial();
 }
 
 std::string Chess::initialStateString()
@@ -242,407 +253,289 @@ void Chess::setStateString(const std::string &s)
     });
 }
 
-void Chess::addPawnBitboardMovesToList(std::vector<BitMove>& moves, const BitBoard bitboard, const int shift) {
-    if (bitboard.getData() == 0)
-        return;
-    bitboard.forEachBit([&](int toSquare) {
-        int fromSquare = toSquare - shift;
-        moves.emplace_back(fromSquare, toSquare, Pawn);
-    });
-}
-
-void Chess::generatePawnMoveList(
-    std::vector<BitMove>& moves, 
-    BitBoard pawns, 
-    BitBoard emptySquares, 
-    BitBoard enemyPieces, 
-    char color)
-{
-    if (pawns.getData() == 0) return;
-
-    constexpr uint64_t NotAFile = 0xFEFEFEFEFEFEFEFEULL; 
-    constexpr uint64_t NotHFile = 0x7F7F7F7F7F7F7F7FULL;
-
-    constexpr uint64_t Rank3 = 0x0000000000FF0000ULL; 
-    constexpr uint64_t Rank6 = 0x0000FF0000000000ULL; 
-
-    uint64_t p = pawns.getData();
-    uint64_t empty = emptySquares.getData();
-    uint64_t enemy = enemyPieces.getData();
-
-    BitBoard single = (color == WHITE) ? BitBoard((p << 8) & empty)
-                                       : BitBoard((p >> 8) & empty);
-
-    BitBoard dbl = (color == WHITE)
-        ? BitBoard(((single.getData() & Rank3) << 8) & empty)
-        : BitBoard(((single.getData() & Rank6) >> 8) & empty);
-
-    BitBoard capturesL = (color == WHITE)
-        ? BitBoard(((p & NotAFile) << 7) & enemy)
-        : BitBoard(((p & NotHFile) >> 9) & enemy);
-
-    BitBoard capturesR = (color == WHITE)
-        ? BitBoard(((p & NotHFile) << 9) & enemy)
-        : BitBoard(((p & NotAFile) >> 7) & enemy);
-
-    int fwdShift     = (color == WHITE) ? 8 : -8;
-    int dblShift     = (color == WHITE) ? 16 : -16;
-    int leftShift    = (color == WHITE) ? 7 : -9;
-    int rightShift   = (color == WHITE) ? 9 : -7;
-
-    addPawnBitboardMovesToList(moves, single,     fwdShift);
-    addPawnBitboardMovesToList(moves, dbl,        dblShift);
-    addPawnBitboardMovesToList(moves, capturesL,  leftShift);
-    addPawnBitboardMovesToList(moves, capturesR,  rightShift);
-}
-
-void Chess::addMoveIfValid(
-    const char *state,
-    std::vector<BitMove>& moves,
-    int fromRow, int fromCol,
-    int toRow, int toCol,
-    ChessPiece piece)
+void Chess::applySpecialMoveToBoard(const BitMove& move)
 {
-    if (toRow < 0 || toRow >= 8 || toCol < 0 || toCol >= 8) return;
-
-    moves.emplace_back(fromRow*8 + fromCol, toRow*8 + toCol, piece);
+    if (move.isCastling()) {
+        bool kingSide = move.to() > move.from();
+        int rookFrom = kingSide ? move.to() + 1 : move.to() - 2;
+        int rookTo = kingSide ? move.to() - 1 : move.to() + 1;
+        ChessSquare* rookSrc = _grid->getSquareByIndex(rookFrom);
+        ChessSquare* rookDst = _grid->getSquareByIndex(rookTo);
+        Bit* rook = rookSrc->bit();
+        if (rook) {
+            rookDst->dropBitAtPoint(rook, ImVec2(0, 0));
+            rookSrc->setBit(nullptr);
+        }
+    } else if (move.isEnPassant()) {
+        int capturedSquare = move.to() + (_currentPlayer == WHITE ? -8 : 8);
+        _grid->getSquareByIndex(capturedSquare)->destroyBit();
+    } else if (move.isPromotion()) {
+        int playerNumber = (_currentPlayer == WHITE) ? 0 : 1;
+        ChessSquare* square = _grid->getSquareByIndex(move.to());
+        Bit* piece = PieceForPlayer(playerNumber, move.promotion());
+        piece->setPosition(square->getPosition());
+        piece->setGameTag(playerNumber == 0 ? move.promotion() : (move.promotion() + 128));
+        square->setBit(piece);
+    }
 }
 
-void Chess::generatePawnMoves(
-    const char *state,
-    std::vector<BitMove>& moves,
-    int row, int col,
-    int color)
+void Chess::updateAI(bool ponderHit)
 {
-    const int direction = (color == WHITE) ? 1 : -1;
-    const int startRow  = (color == WHITE) ? 1 : 6;
-
-    // forward 1
-    if (stateNotation(state, row + direction, col) == '0') {
-        addMoveIfValid(state, moves, row, col, row + direction, col, Pawn);
-
-        // forward 2 from start
-        if (row == startRow &&
-            stateNotation(state, row + 2 * direction, col) == '0')
+    SearchResult result;
+    if (ponderHit) {
+        // the ponder search is already on this position, it stops as soon as it is deep enough
+        _search.ponderHit();
+        _backgroundThread.join();
+        _pondering = false;
+        result = _backgroundResult;
+    } else {
+        // same fixed depth the AI has always used, the search itself lives in the engine library
         {
-            addMoveIfValid(state, moves,
-                row, col,
-                row + 2 * direction, col,
-                Pawn);
+            std::lock_guard<std::mutex> lock(_analysisMutex);
+            _analysisLines.clear();
         }
+        result = _search.think(_gameState, SearchLimits());
     }
+    _lastSearch = result;
 
-    // captures
-    for (int dx : {-1, +1}) {
-        int nc = col + dx;
-        if (nc < 0 || nc >= 8) continue;
-
-        char target = stateNotation(state, row + direction, nc);
-        if (target == '0') continue; // empty
-
-        bool targetIsBlack = (target >= 'a');
-        int targetColor = targetIsBlack ? BLACK : WHITE;
-
-        if (targetColor != color)
-            addMoveIfValid(state, moves, row, col, row + direction, nc, Pawn);
-    }
-}
-
-BitBoard Chess::generateKnightMoveBitboard(int square) {
-    BitBoard bitboard = 0ULL;
-    int rank = square / 8;
-    int file = square % 8;
-    
-    // the L shape combos shown in class
-    std::pair<int, int> knightOffsets[] = {
-        { 2, 1 }, { 2, -1 }, { -2, 1 }, { -2, -1 },
-        { 1, 2 }, { 1, -2 }, { -1, 2 }, { -1, -2 }
-    };
-
-    constexpr uint64_t oneBit = 1;
-    for (auto [dr, df] : knightOffsets) {
-        int r = rank + dr, f = file + df;
-        if (r >= 0 && r < 8 && f >= 0 && f < 8) {
-            bitboard |= oneBit << (r * 8 + f);
+    if (!result.bestMove.isNull()) {
+        std::cout << "search stats: " << result.stats.toJSON() << std::endl;
+        int srcSquare = result.bestMove.from();
+        int dstSquare = result.bestMove.to();
+        BitHolder& src = getHolderAt(srcSquare & 7, srcSquare / 8);
+        BitHolder& dst = getHolderAt(dstSquare & 7, dstSquare / 8);
+        Bit* bit = src.bit();
+        if (!bit) {
+            std::cerr << "AI selected a move from an empty source square! Aborting AI move." << std::endl;
+            return;
+        }
+        dst.dropBitAtPoint(bit, ImVec2(0, 0));
+        src.setBit(nullptr);
+        // the search may have picked an underpromotion, so play its exact move
+        makeMove(result.bestMove);
+        if (_ponderEnabled) {
+            startPondering(result);
         }
     }
-    
-    return bitboard;
 }
 
-// get all moves from the position the knight(s) is in, and find all combos of the L
-void Chess::generateKnightMoves(std::vector<BitMove>& moves, BitBoard knightBoard, uint64_t occupancy) {
-    knightBoard.forEachBit([&](int fromSquare) {
-        BitBoard moveBitboard = BitBoard(_knightBitboards[fromSquare].getData() & occupancy);
-        moveBitboard.forEachBit([&](int toSquare) {
-           moves.emplace_back(fromSquare, toSquare, Knight);
-        });
+void Chess::startBackgroundSearch(const GameState& position, const SearchLimits& limits, bool ponder)
+{
+    stopBackgroundSearch();
+    _search.setPondering(ponder);
+    {
+        std::lock_guard<std::mutex> lock(_analysisMutex);
+        _analysisLines.clear();
+    }
+    _backgroundDone = false;
+    _backgroundThread = std::thread([this, position, limits]() {
+        _backgroundResult = _search.think(position, limits);
+        _backgroundDone = true;
     });
 }
 
-void Chess::generateKingMoves(std::vector<BitMove>& moves, BitBoard kingBoard, uint64_t occupancy) {
-    kingBoard.forEachBit([&](int fromSquare) {
-        BitBoard moveBitboard = BitBoard(KingAttacks[fromSquare] & occupancy);
-        moveBitboard.forEachBit([&](int toSquare) {
-           moves.emplace_back(fromSquare, toSquare, King);
-        });
-    });
+void Chess::stopBackgroundSearch()
+{
+    if (!_backgroundThread.joinable()) return;
+    // think() clears the stop flag when it starts, so keep asking until it has really finished
+    _search.setPondering(false);
+    while (!_backgroundDone) {
+        _search.stop();
+        std::this_thread::yield();
+    }
+    _backgroundThread.join();
+    _pondering = false;
+    _analyzing = false;
 }
 
-void Chess::generateBishopMoves(std::vector<BitMove>& moves, BitBoard bishopBoard, uint64_t occupancy, uint64_t friendlies) {
-    bishopBoard.forEachBit([&](int fromSquare) {
-        BitBoard moveBitboard = BitBoard(getBishopAttacks(fromSquare, occupancy) & ~friendlies);
-        // Efficiently iterate through only the set bits
-        moveBitboard.forEachBit([&](int toSquare) {
-           moves.emplace_back(fromSquare, toSquare, Bishop);
-        });
-    });
+// search the position after the reply the AI expects while the human is thinking
+void Chess::startPondering(const SearchResult& result)
+{
+    if (result.pv.size() < 2 || _currentPlayer != WHITE) return;
+    GameState position = _gameState;
+    position.playMove(result.pv[1]);
+    if (position.generateAllMoves().empty()) return;
+
+    startBackgroundSearch(position, SearchLimits(), true);
+    _ponderMove = result.pv[1];
+    _pondering = true;
 }
 
-void Chess::generateRookMoves(
-    std::vector<BitMove>& moves,
-    BitBoard rookBoard,
-    uint64_t occupancy,
-    uint64_t friendlies)
+void Chess::startAnalysis()
 {
-    rookBoard.forEachBit([&](int fromSquare) {
-        BitBoard moveBitboard = BitBoard(getRookAttacks(fromSquare, occupancy) & ~friendlies);
-        moveBitboard.forEachBit([&](int toSquare) {
-            moves.emplace_back(fromSquare, toSquare, Rook);
-        });
-    });
+    SearchLimits limits;
+    limits.infinite = true;
+    limits.multiPV = _multiPV;
+    startBackgroundSearch(_gameState, limits, false);
+    _analyzing = true;
 }
 
-void Chess::generateQueenMoves(
-    std::vector<BitMove>& moves,
-    BitBoard queenBoard,
-    uint64_t occupancy,
-    uint64_t friendlies)
+void Chess::drawFrame()
 {
-    queenBoard.forEachBit([&](int fromSquare) {
-
-        uint64_t attacks =
-            getRookAttacks(fromSquare, occupancy) |
-            getBishopAttacks(fromSquare, occupancy);
-
-        BitBoard moveBitboard = BitBoard(attacks & ~friendlies);
-
-        moveBitboard.forEachBit([&](int toSquare) {
-            moves.emplace_back(fromSquare, toSquare, Queen);
-        });
-    });
+    Game::drawFrame();
+    drawSearchStats();
+    drawAnalysis();
+    drawExplorer();
 }
 
-std::vector<BitMove> Chess::generateAllMoves(const std::string& state, int playerColor)
+void Chess::drawExplorer()
 {
-    std::vector<BitMove> moves;
-    moves.reserve(32);
-
-    // Build bitboards from state string
-    for (int i=0; i<e_numBitboards; i++) {
-        _bitboards[i] = 0;
+    ImGui::Begin("Opening Explorer");
+    if (_opening) {
+        ImGui::Text("%s %s", _opening->code, _opening->name);
+    } else {
+        ImGui::Text("No ECO opening yet");
     }
-
-    for(int i = 0; i<64; i++) {
-        int bitIndex = _bitboardLookup[ static_cast<unsigned char>(state[i]) ];
-        _bitboards[bitIndex] |= 1ULL << i;
+    ImGui::InputText("Database", _explorerPath, sizeof(_explorerPath));
+    ImGui::SameLine();
+    if (ImGui::Button("Open")) {
+        _explorer.open(_explorerPath);
+    }
+    if (!_explorer.isOpen()) {
+        ImGui::Text("No explorer open, build one with: engine explorer --db %s", _explorerPath);
+        ImGui::End();
+        return;
     }
 
-    bool isWhite = (playerColor == WHITE);
-
-    int knightIndex = isWhite ? WHITE_KNIGHTS : BLACK_KNIGHTS;
-    int kingIndex   = isWhite ? WHITE_KING    : BLACK_KING;
-    int pawnIndex   = isWhite ? WHITE_PAWNS   : BLACK_PAWNS;
-    int bishopIndex = isWhite ? WHITE_BISHOPS : BLACK_BISHOPS;
-    int enemyIndex  = isWhite ? BLACK_ALL_PIECES : WHITE_ALL_PIECES;
-    int rookIndex   = isWhite ? WHITE_ROOKS   : BLACK_ROOKS;
-    int queenIndex  = isWhite ? WHITE_QUEENS  : BLACK_QUEENS;
-
-    _bitboards[OCCUPANCY] = 0;
-    _bitboards[WHITE_ALL_PIECES] = 0;
-    _bitboards[BLACK_ALL_PIECES] = 0;
-    for (int sq = 0; sq < 64; ++sq) {
-        char c = state[sq];
-        if (c != '0') {
-            _bitboards[OCCUPANCY] |= 1ULL << sq;
-            if (isupper(static_cast<unsigned char>(c)))
-                _bitboards[WHITE_ALL_PIECES] |= 1ULL << sq;
-            else
-                _bitboards[BLACK_ALL_PIECES] |= 1ULL << sq;
+    // a lookup is one probe into the mapped table, cheap enough to repeat every frame
+    const std::span<const ExplorerMove> moves = _explorer.moves(_gameState.positionKey());
+    if (moves.empty()) {
+        ImGui::Text("Position not in the database (%llu positions up to ply %d)", (unsigned long long)_explorer.positionCount(), _explorer.maxPly());
+        ImGui::End();
+        return;
+    }
+    // while a piece is dragged only its moves stay bright and the one under it is marked
+    const int dragFrom = _dragBit && _oldHolder ? static_cast<ChessSquare*>(_oldHolder)->getSquareIndex() : -1;
+    const int dragTo = dragFrom >= 0 && _dropTarget ? static_cast<ChessSquare*>(_dropTarget)->getSquareIndex() : -1;
+    if (ImGui::BeginTable("explorer", 6, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+        ImGui::TableSetupColumn("Move");
+        ImGui::TableSetupColumn("Games");
+        ImGui::TableSetupColumn("White / Draw / Black");
+        ImGui::TableSetupColumn("Score");
+        ImGui::TableSetupColumn("Rating");
+        ImGui::TableSetupColumn("Last played");
+        ImGui::TableHeadersRow();
+        for (const ExplorerMove& move : moves) {
+            const bool dimmed = dragFrom >= 0 && move.move.from() != dragFrom;
+            const double games = move.games;
+            ImGui::TableNextRow();
+            if (move.move.from() == dragFrom && move.move.to() == dragTo) {
+                ImGui::TableSetBgColor(ImGuiTableBgTarget_RowBg1, ImGui::GetColorU32(ImGuiCol_TextSelectedBg));
+            }
+            if (dimmed) ImGui::PushStyleColor(ImGuiCol_Text, ImGui::GetStyleColorVec4(ImGuiCol_TextDisabled));
+            ImGui::TableNextColumn(); ImGui::TextUnformatted(GameState::moveToUCI(move.move).c_str());
+            ImGui::TableNextColumn(); ImGui::Text("%u", move.games);
+            ImGui::TableNextColumn(); ImGui::Text("%.0f%% / %.0f%% / %.0f%%", 100.0 * move.whiteWins / games,
+                                                  100.0 * move.draws / games, 100.0 * move.blackWins / games);
+            ImGui::TableNextColumn(); ImGui::Text("%.1f%%", 100.0 * (move.whiteWins + 0.5 * move.draws) / games);
+            ImGui::TableNextColumn(); ImGui::Text("%u", move.averageRating);
+            ImGui::TableNextColumn(); ImGui::Text("%u.%02u.%02u", move.lastPlayed / 10000, move.lastPlayed / 100 % 100, move.lastPlayed % 100);
+            if (dimmed) ImGui::PopStyleColor();
         }
+        ImGui::EndTable();
     }
-
-    uint64_t empty = ~_bitboards[OCCUPANCY].getData();
-
-    // generate moves
-    generateKnightMoves(moves, _bitboards[knightIndex], empty);
-    generateKingMoves  (moves, _bitboards[kingIndex],  empty);
-    generateBishopMoves(moves, _bitboards[bishopIndex],  _bitboards[OCCUPANCY].getData(), _bitboards[bishopIndex].getData());
-    generatePawnMoveList(
-        moves,
-        _bitboards[pawnIndex],
-        BitBoard(empty),
-        _bitboards[enemyIndex],
-        playerColor
-    );
-    generateRookMoves(moves, _bitboards[rookIndex], _bitboards[OCCUPANCY].getData(), _bitboards[rookIndex].getData());
-    generateQueenMoves(moves, _bitboards[queenIndex], _bitboards[OCCUPANCY].getData(), _bitboards[queenIndex].getData());
-
-    return moves;
+    ImGui::End();
 }
 
-std::vector<BitMove> Chess::generateAllMoves()
+void Chess::drawAnalysis()
 {
-    std::vector<BitMove> moves;
-    moves.reserve(32);
-
-    // reset bitboards
-    for (int i = 0; i < e_numBitboards; i++)
-        _bitboards[i] = 0;
-
-    std::string state = stateString();
-
-    // load bitboards
-    for (int sq = 0; sq < 64; sq++) {
-        char c = state[sq];
-        int idx = _bitboardLookup[c];
-        _bitboards[idx] |= 1ULL << sq;
-
-        if (c != '0') {
-            _bitboards[OCCUPANCY] |= 1ULL << sq;
-            if (isupper(c))
-                _bitboards[WHITE_ALL_PIECES] |= 1ULL << sq;
-            else
-                _bitboards[BLACK_ALL_PIECES] |= 1ULL << sq;
+    ImGui::Begin("Analysis");
+    if (ImGui::Checkbox("Ponder on the expected reply", &_ponderEnabled) && !_ponderEnabled && _pondering) {
+        stopBackgroundSearch();
+    }
+    if (_analyzing) {
+        if (ImGui::Button("Stop analysis")) {
+            stopBackgroundSearch();
         }
+    } else {
+        if (ImGui::Button("Analyze position")) {
+            startAnalysis();
+        }
+        ImGui::SameLine();
+        ImGui::SliderInt("Lines", &_multiPV, 1, 5);
     }
 
-    bool isWhite = (_currentPlayer == WHITE);
-
-    int knightIndex = isWhite ? WHITE_KNIGHTS : BLACK_KNIGHTS;
-    int kingIndex   = isWhite ? WHITE_KING    : BLACK_KING;
-    int pawnIndex   = isWhite ? WHITE_PAWNS   : BLACK_PAWNS;
-    int bishopIndex = isWhite ? WHITE_BISHOPS : BLACK_BISHOPS;
-    int enemyIndex  = isWhite ? BLACK_ALL_PIECES : WHITE_ALL_PIECES;
-    int rookIndex   = isWhite ? WHITE_ROOKS   : BLACK_ROOKS;
-    int queenIndex  = isWhite ? WHITE_QUEENS  : BLACK_QUEENS;
-
-
-    uint64_t empty = ~_bitboards[OCCUPANCY].getData();
-
-    // generate moves
-    generateKnightMoves(moves, _bitboards[knightIndex], empty);
-    generateKingMoves  (moves, _bitboards[kingIndex],  empty);
-    generateBishopMoves(moves, _bitboards[bishopIndex],  _bitboards[OCCUPANCY].getData(), _bitboards[bishopIndex].getData());
-    generatePawnMoveList(
-        moves, 
-        _bitboards[pawnIndex], 
-        BitBoard(empty), 
-        _bitboards[enemyIndex], 
-        _currentPlayer
-    );
-    generateRookMoves(moves, _bitboards[rookIndex],_bitboards[OCCUPANCY].getData(),_bitboards[rookIndex].getData());
-
-    generateQueenMoves(moves, _bitboards[queenIndex], _bitboards[OCCUPANCY].getData(), _bitboards[queenIndex].getData());
-
-    return moves;
-}
-static std::map<char, int> evaluateScores = {
-    {'P', 100}, {'p', -100},    // Pawns
-    {'N', 200}, {'n', -200},    // Knights
-    {'B', 230}, {'b', -230},    // Bishops
-    {'R', 400}, {'r', -400},    // Rooks
-    {'Q', 900}, {'q', -900},    // Queens
-    {'K', 2000}, {'k', -2000},  // Kings
-    {'0', 0}                     // Empty squares
-};
-
-
-int Chess::evaluateBoard(const std::string& state) {
-    int value = 0;
-    for(char ch : state) {
-        value += evaluateScores[ch];
+    if (_pondering) {
+        ImGui::Text("Pondering on %s", GameState::moveToUCI(_ponderMove).c_str());
+    } else if (_analyzing) {
+        ImGui::Text("Analyzing until stopped");
+    } else {
+        ImGui::Text("Idle");
     }
-    return value;
-}
-
-
-int Chess::negamax(std::string& state, int depth, int alpha, int beta, int playerColor)
-{
-    _countMoves++;
 
-    if (depth == 0) {
-        return evaluateBoard(state) * playerColor;
+    std::lock_guard<std::mutex> lock(_analysisMutex);
+    if (!_analysisLines.empty() && _analysisLines.back().lines.size() > 1) {
+        ImGui::Text("Top moves at depth %d", _analysisLines.back().depth);
+        for (const PVLine& line : _analysisLines.back().lines) {
+            std::string pv;
+            for (const BitMove& move : line.pv) {
+                pv += GameState::moveToUCI(move) + " ";
+            }
+            ImGui::Text("%6d  %s", line.score, pv.c_str());
+        }
+        ImGui::Separator();
     }
-
-    auto newMoves = generateAllMoves(state, playerColor);
-
-    int bestVal = negInfinite; 
-
-    for(auto move : newMoves) {
-        char boardSave = state[move.to];
-        char pieceMoving = state[move.from];
-
-        state[move.to] = pieceMoving;
-        state[move.from] = '0';
-
-        bestVal = std::max(bestVal, -negamax(state, depth - 1, -beta, -alpha, -playerColor));
-
-        state[move.from] = pieceMoving;
-        state[move.to] = boardSave;
-
-        // Alpha-beta pruning
-        alpha = std::max(alpha, bestVal);
-        if (alpha >= beta) {
-            break;  // Beta cutoff
+    if (ImGui::BeginTable("lines", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+        ImGui::TableSetupColumn("Depth");
+        ImGui::TableSetupColumn("Score");
+        ImGui::TableSetupColumn("Nodes");
+        ImGui::TableSetupColumn("PV");
+        ImGui::TableHeadersRow();
+        for (auto line = _analysisLines.rbegin(); line != _analysisLines.rend(); ++line) {
+            std::string pv;
+            for (const BitMove& move : line->pv) {
+                pv += GameState::moveToUCI(move) + " ";
+            }
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn(); ImGui::Text("%d", line->depth);
+            ImGui::TableNextColumn(); ImGui::Text("%d", line->score);
+            ImGui::TableNextColumn(); ImGui::Text("%llu", (unsigned long long)line->nodes);
+            ImGui::TableNextColumn(); ImGui::TextUnformatted(pv.c_str());
         }
+        ImGui::EndTable();
     }
-
-    return bestVal;
+    ImGui::End();
 }
 
-
-void Chess::updateAI()
+void Chess::drawSearchStats()
 {
-    int bestVal = negInfinite;
-    BitMove bestMove;
-    std::string state = stateString();
-    _countMoves = 0;
-
-    int playerColor = (_currentPlayer == WHITE) ? WHITE : BLACK;
-    const int searchDepth = 5;
-
-    for(auto move : _moves) {
-        char boardSave = state[move.to];
-        char pieceMoving = state[move.from];
-
-        state[move.to] = pieceMoving;
-        state[move.from] = '0';
-
-        int moveVal = -negamax(state, searchDepth - 1, -posInfinite, -negInfinite, -playerColor);
-
-        state[move.from] = pieceMoving;
-        state[move.to] = boardSave;
-
-        if (moveVal > bestVal) {
-            bestMove = move;
-            bestVal = moveVal;
-        }
+    ImGui::Begin("Search Stats");
+    const SearchStats& stats = _lastSearch.stats;
+    if (stats.iterations.empty()) {
+        ImGui::Text("The AI has not searched yet");
+        ImGui::End();
+        return;
     }
 
-    if(bestVal != negInfinite) {
-        std::cout << "Moves checked: " << _countMoves << std::endl;
-        int srcSquare = bestMove.from;
-        int dstSquare = bestMove.to;
-        BitHolder& src = getHolderAt(srcSquare & 7, srcSquare / 8);
-        BitHolder& dst = getHolderAt(dstSquare & 7, dstSquare / 8);
-        Bit* bit = src.bit();
-        if (!bit) {
-            std::cerr << "AI selected a move from an empty source square! Aborting AI move." << std::endl;
-            return;
+    ImGui::Text("Best move: %s  score %d  depth %d  seldepth %d", GameState::moveToUCI(_lastSearch.bestMove).c_str(),
+                _lastSearch.score, _lastSearch.depth, stats.selDepth);
+    ImGui::Text("Nodes: %llu  quiescence: %llu  nps: %.0f  time: %.3fs", (unsigned long long)stats.nodes,
+                (unsigned long long)stats.qnodes, stats.nps(), stats.seconds);
+    ImGui::Text("TT probes: %llu  hits: %llu (%.1f%%)  cutoffs: %llu", (unsigned long long)stats.ttProbes,
+                (unsigned long long)stats.ttHits, stats.ttHitRate() * 100.0, (unsigned long long)stats.ttCutoffs);
+    ImGui::Text("First move cutoffs: %.1f%%  EBF: %.2f", stats.firstMoveCutoffRate() * 100.0,
+                stats.effectiveBranchingFactor());
+    ImGui::Text("Aspiration re-searches: %llu  (fail low %llu, fail high %llu)",
+                (unsigned long long)stats.aspirationResearches(), (unsigned long long)stats.aspirationFailLows,
+                (unsigned long long)stats.aspirationFailHighs);
+
+    if (ImGui::BeginTable("iterations", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+        ImGui::TableSetupColumn("Depth");
+        ImGui::TableSetupColumn("Score");
+        ImGui::TableSetupColumn("Nodes");
+        ImGui::TableSetupColumn("Time (ms)");
+        ImGui::TableHeadersRow();
+        for (const IterationStats& iteration : stats.iterations) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn(); ImGui::Text("%d", iteration.depth);
+            ImGui::TableNextColumn(); ImGui::Text("%d", iteration.score);
+            ImGui::TableNextColumn(); ImGui::Text("%llu", (unsigned long long)iteration.nodes);
+            ImGui::TableNextColumn(); ImGui::Text("%.1f", iteration.seconds * 1000.0);
         }
-        dst.dropBitAtPoint(bit, ImVec2(0, 0));
-        src.setBit(nullptr);
-        bitMovedFromTo(*bit, src, dst);
+        ImGui::EndTable();
+    }
+    if (ImGui::Button("Copy as JSON")) {
+        ImGui::SetClipboardText(stats.toJSON().c_str());
     }
+    ImGui::End();
 }
@@ -1,33 +1,14 @@
 #pragma once
 
+#include <mutex>
 #include "Game.h"
 #include "Grid.h"
-#include "Bitboard.h"
+#include "Eco.h"
+#include "GameState.h"
+#include "OpeningExplorer.h"
+#include "Search.h"
 
 constexpr int pieceSize = 80;
-constexpr int WHITE = +1;
-constexpr int BLACK = -1;
-
-enum AllBitBoards
-{
-    WHITE_PAWNS,
-    WHITE_KNIGHTS,
-    WHITE_BISHOPS,
-    WHITE_ROOKS,
-    WHITE_QUEENS,
-    WHITE_KING,
-    BLACK_PAWNS,
-    BLACK_KNIGHTS,
-    BLACK_BISHOPS,
-    BLACK_ROOKS,
-    BLACK_QUEENS,
-    BLACK_KING,
-    WHITE_ALL_PIECES,
-    BLACK_ALL_PIECES,
-    OCCUPANCY,
-    EMPTY_SQUARES,
-    e_numBitboards
-};
 
 class Chess : public Game
 {
@@ -36,6 +17,7 @@ public:
     ~Chess();
 
     void setUpBoard() override;
+    void drawFrame() override;
 
     bool canBitMoveFrom(Bit &bit, BitHolder &src) override;
     bool canBitMoveFromTo(Bit &bit, BitHolder &src, BitHolder &dst) override;
@@ -53,7 +35,6 @@ public:
     void clearBoardHighlights() override;
 
     Grid* getGrid() override { return _grid; }
-    int evaluateBoard(const std::string& state);
 
 private:
     char stateNotation(const char* state, int row, int col) { return state[row * 8 + col]; }
@@ -62,41 +43,45 @@ private:
     void FENtoBoard(const std::string& fen);
     char pieceNotation(int x, int y) const;
 
-    // knight stuff
-    BitBoard _knightBitboards[64];
-    BitBoard generateKnightMoveBitboard(int square);
-    void generateKnightMoves(std::vector<BitMove>& moves, BitBoard knightBoard, uint64_t occupancy);
-    // king stuff
-    void generateKingMoves(std::vector<BitMove>& moves, BitBoard kingBoard, uint64_t occupancy);
-
-    // pawn stuff
-    void generatePawnMoveList(std::vector<BitMove>& moves, const BitBoard pawns, const BitBoard emptySquares, const BitBoard enemyPieces, char color);
-    void addPawnBitboardMovesToList(std::vector<BitMove>& moves, const BitBoard bitboard, const int shift);
-    void generatePawnMoves(const char *state, std::vector<BitMove>& moves, int row, int col, int colorAsInt);
+    // mirror a move the engine knows about onto the grid: castling rooks, en passant and promotions
+    void makeMove(const BitMove& move);
+    void applySpecialMoveToBoard(const BitMove& move);
 
-    // bishop
-    void generateBishopMoves(std::vector<BitMove>& moves, BitBoard bishopBoard, uint64_t occupancy, uint64_t friendlies);
-
-    //rook
-    void generateRookMoves(std::vector<BitMove>& moves,BitBoard rookBoard,uint64_t occupancy,uint64_t friendlies);
-
-    //queen
-    void generateQueenMoves(std::vector<BitMove>& moves,BitBoard queenBoard,uint64_t occupancy,uint64_t friendlies);
+    // AI 
+    void updateAI(bool ponderHit);
+    void drawSearchStats();
 
-    std::vector<BitMove> generateAllMoves(const std::string& state, int playerColor);
-    std::vector<BitMove> generateAllMoves();  
-    void addMoveIfValid(const char *state, std::vector<BitMove>& moves, int fromRow, int fromCol, int toRow, int toCol, ChessPiece piece);
+    // background searches: pondering on the reply we expect, or analysis until stopped
+    void startPondering(const SearchResult& result);
+    void startAnalysis();
+    void startBackgroundSearch(const GameState& position, const SearchLimits& limits, bool ponder);
+    void stopBackgroundSearch();
+    void drawAnalysis();
 
-    // AI 
-    int negamax(std::string& state, int depth, int alpha, int beta, int playerColor);
-    void updateAI();
+    // moves played from the current position in a database, follows the board and the piece being dragged
+    void drawExplorer();
 
-    int posInfinite = INT_MAX;
-    int negInfinite = INT_MIN;
-    int _countMoves = 0;
     int _currentPlayer = WHITE;
     Grid* _grid;
     std::vector<BitMove>    _moves;
-    BitBoard _bitboards[e_numBitboards];
-    int _bitboardLookup[128];
+    GameState _gameState;
+    Search _search;
+    SearchResult _lastSearch;
+
+    std::thread _backgroundThread;
+    std::atomic<bool> _backgroundDone{true};
+    SearchResult _backgroundResult;
+    bool _ponderEnabled = true;
+    bool _pondering = false;
+    bool _analyzing = false;
+    int _multiPV = 1;
+    BitMove _ponderMove;
+    // iterations streamed from whichever search is running, newest last
+    std::mutex _analysisMutex;
+    std::vector<SearchResult> _analysisLines;
+
+    // deepest ECO line the game has reached so far
+    const EcoOpening* _opening = nullptr;
+    OpeningExplorer _explorer;
+    char _explorerPath[256] = "games";
 };
@@ -0,0 +1,133 @@
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <thread>
+#include "DataGen.h"
+#include "Match.h"
+
+static double nowSeconds()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+DataGenerator::DataGenerator(const DataGenOptions& options)
+    : _options(options)
+    , _nextGame(0)
+    , _written(0)
+    , _file(nullptr)
+    , _log(&std::cout)
+    , _startSeconds(0.0)
+{
+    _options.threads = std::max(1, _options.threads);
+}
+
+void DataGenerator::playGame(Search& search, uint64_t gameIndex, std::vector<PackedPosition>& buffer)
+{
+    GameState position;
+    Match::openingFor(_openings, _options.seed, gameIndex, _options.randomPlies, position);
+    search.clear();
+
+    SearchLimits limits;
+    limits.depth = MAX_PLY - 1;
+    limits.nodes = _options.nodes;
+
+    const size_t firstRecord = buffer.size();
+    int result = 0;
+    for (int ply = 0; ply < _options.maxPlies; ply++) {
+        if (position.generateAllMoves().empty()) {
+            if (position.isInCheck()) result = position.color == WHITE ? -1 : 1;
+            break;
+        }
+        if (position.hasInsufficientMaterial() || position.repetitionCount() >= 2 || position.isFiftyMoveDraw()) break;
+
+        SearchResult searched = search.think(position, limits);
+        // a found mate decides the game, playing it out adds nothing but noise
+        if (std::abs(searched.score) > MATE_BOUND) {
+            const int sideToMove = position.color == WHITE ? 1 : -1;
+            result = searched.score > 0 ? sideToMove : -sideToMove;
+            break;
+        }
+        // only quiet positions are useful to an evaluation that never sees the capture sequence
+        if (!position.isInCheck() && !position.isTactical(searched.bestMove)) {
+            PackedPosition record;
+            record.pack(position);
+            record.score = static_cast<int16_t>(searched.score);
+            record.ply = static_cast<uint16_t>(ply);
+            buffer.push_back(record);
+        }
+        position.playMove(searched.bestMove);
+    }
+
+    for (size_t i = firstRecord; i < buffer.size(); i++) {
+        buffer[i].result = static_cast<int8_t>(result);
+    }
+}
+
+void DataGenerator::flush(std::vector<PackedPosition>& buffer)
+{
+    if (buffer.empty()) return;
+    std::lock_guard<std::mutex> lock(_fileMutex);
+    const uint64_t written = _written;
+    if (written < _options.positions) {
+        const size_t count = static_cast<size_t>(std::min<uint64_t>(buffer.size(), _options.positions - written));
+        std::fwrite(buffer.data(), sizeof(PackedPosition), count, _file);
+        _written = written + count;
+
+        const double seconds = nowSeconds() - _startSeconds;
+        *_log << std::fixed << std::setprecision(1) << _written << " positions, " << _nextGame << " games, "
+              << (seconds > 0.0 ? _written / seconds : 0.0) << " positions/s" << std::endl;
+    }
+    buffer.clear();
+}
+
+void DataGenerator::worker()
+{
+    Search search(2);
+    // small runs would otherwise play far past the target before anything reaches the file
+    const size_t flushAt = static_cast<size_t>(std::min<uint64_t>(_options.bufferPositions, _options.positions / _options.threads + 1));
+    std::vector<PackedPosition> buffer;
+    buffer.reserve(flushAt + _options.maxPlies);
+    while (_written < _options.positions) {
+        playGame(search, _nextGame++, buffer);
+        if (buffer.size() >= flushAt) {
+            flush(buffer);
+        }
+    }
+    flush(buffer);
+}
+
+uint64_t DataGenerator::run(std::ostream& log)
+{
+    _log = &log;
+    _nextGame = 0;
+    _written = 0;
+    if (!_options.bookPath.empty() && !Match::loadOpenings(_options.bookPath, _openings)) {
+        log << "could not read any openings from " << _options.bookPath << ", using random openings" << std::endl;
+    }
+
+    _file = std::fopen(_options.outputPath.c_str(), "wb");
+    if (!_file) {
+        log << "could not open " << _options.outputPath << std::endl;
+        return 0;
+    }
+    // the workers already batch their writes, a large stdio buffer keeps each one to a few system calls
+    std::vector<char> fileBuffer(1 << 20);
+    std::setvbuf(_file, fileBuffer.data(), _IOFBF, fileBuffer.size());
+
+    _startSeconds = nowSeconds();
+    std::vector<std::thread> workers;
+    for (int i = 0; i < _options.threads; i++) {
+        workers.emplace_back(&DataGenerator::worker, this);
+    }
+    for (auto& thread : workers) {
+        thread.join();
+    }
+    std::fclose(_file);
+    _file = nullptr;
+
+    const double seconds = nowSeconds() - _startSeconds;
+    log << std::fixed << std::setprecision(1) << "wrote " << _written << " positions from " << _nextGame << " games to "
+        << _options.outputPath << " in " << seconds << "s, " << (seconds > 0.0 ? _written / seconds : 0.0)
+        << " positions/s" << std::endl;
+    return _written;
+}
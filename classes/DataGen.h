@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+#include <cstdio>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "PackedPosition.h"
+#include "Search.h"
+
+struct DataGenOptions {
+    std::string outputPath;
+    uint64_t positions = 1000000;   // stop once this many records are written
+    int threads = 1;
+    uint64_t nodes = 5000;          // search budget per move
+    std::string bookPath;           // optional EPD/FEN openings, random walks otherwise
+    int randomPlies = 8;
+    uint64_t seed = 1;
+    int maxPlies = 400;             // longer games are recorded as draws
+    size_t bufferPositions = 4096;  // records a worker collects before taking the file lock
+};
+
+//
+// plays fixed node self-play games on every thread and writes the quiet positions
+// with their search score and the final game result as PackedPosition records
+//
+class DataGenerator
+{
+public:
+    DataGenerator(const DataGenOptions& options);
+
+    // returns the number of records written, progress goes to log
+    uint64_t run(std::ostream& log);
+
+private:
+    void worker();
+    // plays one game and appends its positions to buffer, game results filled in
+    void playGame(Search& search, uint64_t gameIndex, std::vector<PackedPosition>& buffer);
+    void flush(std::vector<PackedPosition>& buffer);
+
+    DataGenOptions _options;
+    std::vector<std::string> _openings;
+    std::atomic<uint64_t> _nextGame;
+    std::atomic<uint64_t> _written;
+
+    std::mutex _fileMutex;
+    FILE* _file;
+    std::ostream* _log;
+    double _startSeconds;
+};
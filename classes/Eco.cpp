@@ -0,0 +1,225 @@
+#include <algorithm>
+#include <iostream>
+#include "Eco.h"
+
+// the main line of the common ECO codes, a code may appear on several lines
+static const EcoOpening EcoOpenings[] = {
+    { "A00", "Polish Opening", "b4" },
+    { "A00", "Grob Opening", "g4" },
+    { "A00", "Hungarian Opening", "g3" },
+    { "A00", "Van't Kruijs Opening", "e3" },
+    { "A00", "Mieses Opening", "d3" },
+    { "A00", "Saragossa Opening", "c3" },
+    { "A00", "Anderssen Opening", "a3" },
+    { "A00", "Van Geet Opening", "Nc3" },
+    { "A00", "Amar Opening", "Nh3" },
+    { "A01", "Nimzo-Larsen Attack", "b3" },
+    { "A02", "Bird's Opening", "f4" },
+    { "A03", "Bird's Opening", "f4 d5" },
+    { "A04", "Reti Opening", "Nf3" },
+    { "A05", "Reti Opening", "Nf3 Nf6" },
+    { "A06", "Reti Opening", "Nf3 d5" },
+    { "A07", "King's Indian Attack", "Nf3 d5 g3" },
+    { "A08", "King's Indian Attack", "Nf3 d5 g3 c5 Bg2" },
+    { "A09", "Reti Opening", "Nf3 d5 c4" },
+    { "A10", "English Opening", "c4" },
+    { "A11", "English, Caro-Kann Defensive System", "c4 c6" },
+    { "A13", "English Opening", "c4 e6" },
+    { "A15", "English, Anglo-Indian Defence", "c4 Nf6" },
+    { "A16", "English Opening", "c4 Nf6 Nc3" },
+    { "A17", "English Opening", "c4 Nf6 Nc3 e6" },
+    { "A18", "English, Mikenas-Carls Variation", "c4 Nf6 Nc3 e6 e4" },
+    { "A20", "English Opening", "c4 e5" },
+    { "A21", "English Opening", "c4 e5 Nc3" },
+    { "A22", "English Opening", "c4 e5 Nc3 Nf6" },
+    { "A25", "English, Sicilian Reversed", "c4 e5 Nc3 Nc6" },
+    { "A27", "English, Three Knights System", "c4 e5 Nc3 Nc6 Nf3" },
+    { "A28", "English, Four Knights System", "c4 e5 Nc3 Nc6 Nf3 Nf6" },
+    { "A30", "English, Symmetrical Variation", "c4 c5" },
+    { "A34", "English, Symmetrical Variation", "c4 c5 Nc3" },
+    { "A40", "Queen's Pawn Game", "d4" },
+    { "A41", "Queen's Pawn Game", "d4 d6" },
+    { "A43", "Old Benoni Defence", "d4 c5" },
+    { "A45", "Queen's Pawn Game", "d4 Nf6" },
+    { "A46", "Queen's Pawn Game", "d4 Nf6 Nf3" },
+    { "A47", "Queen's Indian Defence", "d4 Nf6 Nf3 b6" },
+    { "A48", "King's Indian, East Indian Defence", "d4 Nf6 Nf3 g6" },
+    { "A50", "Queen's Pawn Game", "d4 Nf6 c4" },
+    { "A51", "Budapest Gambit", "d4 Nf6 c4 e5" },
+    { "A53", "Old Indian Defence", "d4 Nf6 c4 d6" },
+    { "A56", "Benoni Defence", "d4 Nf6 c4 c5" },
+    { "A57", "Benko Gambit", "d4 Nf6 c4 c5 d5 b5" },
+    { "A60", "Benoni Defence", "d4 Nf6 c4 c5 d5 e6" },
+    { "A80", "Dutch Defence", "d4 f5" },
+    { "A81", "Dutch Defence", "d4 f5 g3" },
+    { "A82", "Dutch, Staunton Gambit", "d4 f5 e4" },
+    { "A84", "Dutch Defence", "d4 f5 c4" },
+    { "B00", "King's Pawn Opening", "e4" },
+    { "B00", "Nimzowitsch Defence", "e4 Nc6" },
+    { "B00", "Owen Defence", "e4 b6" },
+    { "B01", "Scandinavian Defence", "e4 d5" },
+    { "B01", "Scandinavian Defence", "e4 d5 exd5 Qxd5" },
+    { "B02", "Alekhine's Defence", "e4 Nf6" },
+    { "B03", "Alekhine's Defence", "e4 Nf6 e5 Nd5 d4" },
+    { "B06", "Modern Defence", "e4 g6" },
+    { "B07", "Pirc Defence", "e4 d6 d4 Nf6" },
+    { "B08", "Pirc, Classical Variation", "e4 d6 d4 Nf6 Nc3 g6 Nf3" },
+    { "B09", "Pirc, Austrian Attack", "e4 d6 d4 Nf6 Nc3 g6 f4" },
+    { "B10", "Caro-Kann Defence", "e4 c6" },
+    { "B12", "Caro-Kann Defence", "e4 c6 d4 d5" },
+    { "B12", "Caro-Kann, Advance Variation", "e4 c6 d4 d5 e5" },
+    { "B13", "Caro-Kann, Exchange Variation", "e4 c6 d4 d5 exd5" },
+    { "B15", "Caro-Kann Defence", "e4 c6 d4 d5 Nc3" },
+    { "B18", "Caro-Kann, Classical Variation", "e4 c6 d4 d5 Nc3 dxe4 Nxe4 Bf5" },
+    { "B20", "Sicilian Defence", "e4 c5" },
+    { "B21", "Sicilian, Smith-Morra Gambit", "e4 c5 d4" },
+    { "B22", "Sicilian, Alapin Variation", "e4 c5 c3" },
+    { "B23", "Sicilian, Closed", "e4 c5 Nc3" },
+    { "B27", "Sicilian Defence", "e4 c5 Nf3" },
+    { "B30", "Sicilian Defence", "e4 c5 Nf3 Nc6" },
+    { "B30", "Sicilian, Rossolimo Variation", "e4 c5 Nf3 Nc6 Bb5" },
+    { "B32", "Sicilian Defence", "e4 c5 Nf3 Nc6 d4 cxd4 Nxd4" },
+    { "B33", "Sicilian Defence", "e4 c5 Nf3 Nc6 d4 cxd4 Nxd4 Nf6" },
+    { "B33", "Sicilian, Sveshnikov Variation", "e4 c5 Nf3 Nc6 d4 cxd4 Nxd4 Nf6 Nc3 e5" },
+    { "B40", "Sicilian Defence", "e4 c5 Nf3 e6" },
+    { "B44", "Sicilian, Taimanov Variation", "e4 c5 Nf3 e6 d4 cxd4 Nxd4 Nc6" },
+    { "B50", "Sicilian Defence", "e4 c5 Nf3 d6" },
+    { "B51", "Sicilian, Moscow Variation", "e4 c5 Nf3 d6 Bb5+" },
+    { "B54", "Sicilian Defence", "e4 c5 Nf3 d6 d4 cxd4 Nxd4" },
+    { "B56", "Sicilian Defence", "e4 c5 Nf3 d6 d4 cxd4 Nxd4 Nf6 Nc3" },
+    { "B57", "Sicilian, Classical Variation", "e4 c5 Nf3 d6 d4 cxd4 Nxd4 Nf6 Nc3 Nc6" },
+    { "B70", "Sicilian, Dragon Variation", "e4 c5 Nf3 d6 d4 cxd4 Nxd4 Nf6 Nc3 g6" },
+    { "B80", "Sicilian, Scheveningen Variation", "e4 c5 Nf3 d6 d4 cxd4 Nxd4 Nf6 Nc3 e6" },
+    { "B90", "Sicilian, Najdorf Variation", "e4 c5 Nf3 d6 d4 cxd4 Nxd4 Nf6 Nc3 a6" },
+    { "C00", "French Defence", "e4 e6" },
+    { "C01", "French, Exchange Variation", "e4 e6 d4 d5 exd5" },
+    { "C02", "French, Advance Variation", "e4 e6 d4 d5 e5" },
+    { "C03", "French, Tarrasch Variation", "e4 e6 d4 d5 Nd2" },
+    { "C10", "French Defence", "e4 e6 d4 d5 Nc3" },
+    { "C11", "French Defence", "e4 e6 d4 d5 Nc3 Nf6" },
+    { "C15", "French, Winawer Variation", "e4 e6 d4 d5 Nc3 Bb4" },
+    { "C20", "King's Pawn Game", "e4 e5" },
+    { "C21", "Centre Game", "e4 e5 d4" },
+    { "C23", "Bishop's Opening", "e4 e5 Bc4" },
+    { "C25", "Vienna Game", "e4 e5 Nc3" },
+    { "C30", "King's Gambit", "e4 e5 f4" },
+    { "C33", "King's Gambit Accepted", "e4 e5 f4 exf4" },
+    { "C40", "King's Knight Opening", "e4 e5 Nf3" },
+    { "C41", "Philidor Defence", "e4 e5 Nf3 d6" },
+    { "C42", "Petrov Defence", "e4 e5 Nf3 Nf6" },
+    { "C44", "King's Pawn Game", "e4 e5 Nf3 Nc6" },
+    { "C44", "Scotch Game", "e4 e5 Nf3 Nc6 d4" },
+    { "C45", "Scotch Game", "e4 e5 Nf3 Nc6 d4 exd4 Nxd4" },
+    { "C46", "Three Knights Game", "e4 e5 Nf3 Nc6 Nc3" },
+    { "C47", "Four Knights Game", "e4 e5 Nf3 Nc6 Nc3 Nf6" },
+    { "C50", "Italian Game", "e4 e5 Nf3 Nc6 Bc4" },
+    { "C50", "Giuoco Piano", "e4 e5 Nf3 Nc6 Bc4 Bc5" },
+    { "C51", "Evans Gambit", "e4 e5 Nf3 Nc6 Bc4 Bc5 b4" },
+    { "C53", "Giuoco Piano", "e4 e5 Nf3 Nc6 Bc4 Bc5 c3" },
+    { "C55", "Two Knights Defence", "e4 e5 Nf3 Nc6 Bc4 Nf6" },
+    { "C57", "Two Knights Defence", "e4 e5 Nf3 Nc6 Bc4 Nf6 Ng5" },
+    { "C60", "Ruy Lopez", "e4 e5 Nf3 Nc6 Bb5" },
+    { "C65", "Ruy Lopez, Berlin Defence", "e4 e5 Nf3 Nc6 Bb5 Nf6" },
+    { "C68", "Ruy Lopez, Exchange Variation", "e4 e5 Nf3 Nc6 Bb5 a6 Bxc6" },
+    { "C70", "Ruy Lopez", "e4 e5 Nf3 Nc6 Bb5 a6 Ba4" },
+    { "C78", "Ruy Lopez", "e4 e5 Nf3 Nc6 Bb5 a6 Ba4 Nf6 O-O" },
+    { "C84", "Ruy Lopez, Closed", "e4 e5 Nf3 Nc6 Bb5 a6 Ba4 Nf6 O-O Be7" },
+    { "C88", "Ruy Lopez, Closed", "e4 e5 Nf3 Nc6 Bb5 a6 Ba4 Nf6 O-O Be7 Re1 b5 Bb3" },
+    { "D00", "Queen's Pawn Game", "d4 d5" },
+    { "D02", "Queen's Pawn Game", "d4 d5 Nf3" },
+    { "D02", "London System", "d4 d5 Nf3 Nf6 Bf4" },
+    { "D06", "Queen's Gambit", "d4 d5 c4" },
+    { "D07", "Queen's Gambit, Chigorin Defence", "d4 d5 c4 Nc6" },
+    { "D08", "Queen's Gambit, Albin Counter-Gambit", "d4 d5 c4 e5" },
+    { "D10", "Slav Defence", "d4 d5 c4 c6" },
+    { "D11", "Slav Defence", "d4 d5 c4 c6 Nf3" },
+    { "D20", "Queen's Gambit Accepted", "d4 d5 c4 dxc4" },
+    { "D30", "Queen's Gambit Declined", "d4 d5 c4 e6" },
+    { "D31", "Queen's Gambit Declined", "d4 d5 c4 e6 Nc3" },
+    { "D35", "Queen's Gambit Declined", "d4 d5 c4 e6 Nc3 Nf6" },
+    { "D43", "Semi-Slav Defence", "d4 d5 c4 e6 Nc3 Nf6 Nf3 c6" },
+    { "D80", "Grunfeld Defence", "d4 Nf6 c4 g6 Nc3 d5" },
+    { "D85", "Grunfeld, Exchange Variation", "d4 Nf6 c4 g6 Nc3 d5 cxd5 Nxd5" },
+    { "E00", "Queen's Pawn Game", "d4 Nf6 c4 e6" },
+    { "E01", "Catalan Opening", "d4 Nf6 c4 e6 g3" },
+    { "E10", "Queen's Pawn Game", "d4 Nf6 c4 e6 Nf3" },
+    { "E11", "Bogo-Indian Defence", "d4 Nf6 c4 e6 Nf3 Bb4+" },
+    { "E12", "Queen's Indian Defence", "d4 Nf6 c4 e6 Nf3 b6" },
+    { "E20", "Nimzo-Indian Defence", "d4 Nf6 c4 e6 Nc3 Bb4" },
+    { "E32", "Nimzo-Indian, Classical Variation", "d4 Nf6 c4 e6 Nc3 Bb4 Qc2" },
+    { "E40", "Nimzo-Indian, Rubinstein Variation", "d4 Nf6 c4 e6 Nc3 Bb4 e3" },
+    { "E60", "King's Indian Defence", "d4 Nf6 c4 g6" },
+    { "E61", "King's Indian Defence", "d4 Nf6 c4 g6 Nc3" },
+    { "E70", "King's Indian Defence", "d4 Nf6 c4 g6 Nc3 Bg7 e4" },
+    { "E80", "King's Indian, Samisch Variation", "d4 Nf6 c4 g6 Nc3 Bg7 e4 d6 f3" },
+    { "E90", "King's Indian Defence", "d4 Nf6 c4 g6 Nc3 Bg7 e4 d6 Nf3" },
+    { "E97", "King's Indian, Classical Variation", "d4 Nf6 c4 g6 Nc3 Bg7 e4 d6 Nf3 O-O Be2 e5 O-O Nc6" },
+};
+
+uint16_t ecoFromString(std::string_view code)
+{
+    if (code.size() != 3 || code[0] < 'A' || code[0] > 'E' || code[1] < '0' || code[1] > '9' || code[2] < '0' || code[2] > '9') return 0;
+    return uint16_t(1 + (code[0] - 'A') * 100 + (code[1] - '0') * 10 + (code[2] - '0'));
+}
+
+std::string ecoToString(uint16_t eco)
+{
+    if (eco == 0 || eco > 500) return std::string();
+    const int value = eco - 1;
+    return { char('A' + value / 100), char('0' + value / 10 % 10), char('0' + value % 10) };
+}
+
+const EcoTable& EcoTable::instance()
+{
+    static const EcoTable table;
+    return table;
+}
+
+EcoTable::EcoTable()
+    : _maxPly(0)
+{
+    GameState position;
+    for (const EcoOpening& opening : EcoOpenings) {
+        position.initFromFEN(StartFEN);
+        std::string_view moves = opening.moves;
+        int plies = 0;
+        bool legal = true;
+        while (!moves.empty() && legal) {
+            const size_t end = std::min(moves.find(' '), moves.size());
+            const BitMove move = position.parseSANMove(moves.substr(0, end));
+            moves.remove_prefix(std::min(end + 1, moves.size()));
+            legal = !move.isNull();
+            if (legal) {
+                position.playMove(move);
+                plies++;
+            }
+        }
+        if (!legal) {
+            std::cerr << "ECO line " << opening.code << " " << opening.moves << " is not legal" << std::endl;
+            continue;
+        }
+        _positions.push_back({ position.hashWithoutEnPassant(), &opening });
+        _maxPly = std::max(_maxPly, plies);
+    }
+    std::sort(_positions.begin(), _positions.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+}
+
+const EcoOpening* EcoTable::find(uint64_t key) const
+{
+    auto found = std::lower_bound(_positions.begin(), _positions.end(), key, [](const auto& entry, uint64_t value) {
+        return entry.first < value;
+    });
+    return found != _positions.end() && found->first == key ? found->second : nullptr;
+}
+
+const EcoOpening* EcoTable::classify(const GameState& start, std::span<const BitMove> moves) const
+{
+    GameState position = start;
+    const EcoOpening* deepest = find(position.hashWithoutEnPassant());
+    const size_t plies = std::min(moves.size(), size_t(_maxPly));
+    for (size_t ply = 0; ply < plies; ply++) {
+        position.playMove(moves[ply]);
+        if (const EcoOpening* opening = find(position.hashWithoutEnPassant())) deepest = opening;
+    }
+    return deepest;
+}
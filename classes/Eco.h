@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "GameState.h"
+
+struct EcoOpening {
+    const char* code;
+    const char* name;
+    const char* moves;              // SAN from the standard start
+};
+
+// ECO codes as numbers for the header column: 0 when unknown, 1 + letter * 100 + number for A00 to E99
+uint16_t ecoFromString(std::string_view code);
+std::string ecoToString(uint16_t eco);
+
+//
+// the built in ECO lines compiled to the Zobrist keys of their final positions, so a game is classified by
+// looking up its positions in order and keeping the deepest one found; transpositions land on the right line
+// since the keys leave out the en passant file
+//
+class EcoTable
+{
+public:
+    // built on first use, safe to share between threads
+    static const EcoTable& instance();
+
+    // key from GameState::hashWithoutEnPassant()
+    const EcoOpening* find(uint64_t key) const;
+    // plays at most maxPly() moves from start, nullptr when no position of the game is in the table
+    const EcoOpening* classify(const GameState& start, std::span<const BitMove> moves) const;
+
+    size_t size() const { return _positions.size(); }
+    int maxPly() const { return _maxPly; }
+
+private:
+    EcoTable();
+
+    // sorted by key
+    std::vector<std::pair<uint64_t, const EcoOpening*>> _positions;
+    int _maxPly;
+};
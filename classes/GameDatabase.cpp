@@ -0,0 +1,349 @@
+#include <algorithm>
+#include <cstring>
+#include "Eco.h"
+#include "GameDatabase.h"
+
+static const char GameMagic[8] = "CBGAMES";
+static const char HeaderMagic[8] = "CBHEADS";
+
+static const size_t ColumnBytes[HeaderColumnCount] = { 4, 4, 4, 4, 4, 2, 2, 1, 2 };
+
+// digits of value, stops at the first character that is not one
+static uint32_t parseNumber(std::string_view value)
+{
+    uint32_t number = 0;
+    for (char c : value) {
+        if (c < '0' || c > '9') break;
+        number = number * 10 + (c - '0');
+    }
+    return number;
+}
+
+// "2024.01.05", any "??" part is left 0
+static uint32_t parseDate(std::string_view value)
+{
+    uint32_t parts[3] = { 0, 0, 0 };
+    for (int part = 0; part < 3 && !value.empty(); part++) {
+        const size_t dot = value.find('.');
+        parts[part] = parseNumber(value.substr(0, dot));
+        value = dot == std::string_view::npos ? std::string_view() : value.substr(dot + 1);
+    }
+    return std::min<uint32_t>(parts[0], 9999) * 10000 + std::min<uint32_t>(parts[1], 12) * 100 + std::min<uint32_t>(parts[2], 31);
+}
+
+void GameHeader::fromPgn(const PgnGame& game)
+{
+    white = game.tag("White");
+    black = game.tag("Black");
+    event = game.tag("Event");
+    site = game.tag("Site");
+    date = parseDate(game.tag("Date"));
+    whiteElo = static_cast<uint16_t>(std::min<uint32_t>(parseNumber(game.tag("WhiteElo")), 65535));
+    blackElo = static_cast<uint16_t>(std::min<uint32_t>(parseNumber(game.tag("BlackElo")), 65535));
+    result = game.finished ? game.result : UnknownResult;
+    eco = ecoFromString(game.tag("ECO"));
+}
+
+void EncodedGame::fromPgn(const PgnGame& game)
+{
+    header.fromPgn(game);
+    fen = game.tag("FEN");
+    moves = game.moveIndexes;
+}
+
+bool EncodedGame::fitsBlock() const
+{
+    return 3 + std::min<size_t>(fen.size(), 255) + moves.size() <= GameBlockBytes && moves.size() <= 65535;
+}
+
+GameDatabaseWriter::GameDatabaseWriter()
+    : _file(nullptr)
+    , _failed(false)
+    , _nextSequence(0)
+    , _block(GameBlockBytes)
+    , _blockUsed(0)
+    , _blockCount(0)
+    , _blockBytes(0)
+    , _droppedGames(0)
+{
+}
+
+GameDatabaseWriter::~GameDatabaseWriter()
+{
+    close();
+}
+
+bool GameDatabaseWriter::open(const std::string& basePath)
+{
+    close();
+    _basePath = basePath;
+    _file = std::fopen((basePath + ".games").c_str(), "wb");
+    if (!_file) return false;
+    _failed = false;
+    _nextSequence = 0;
+    _pending.clear();
+    _blockUsed = 0;
+    _blockCount = 0;
+    _blockBytes = 0;
+    _droppedGames = 0;
+    _index.clear();
+    _stringIds.clear();
+    _stringOffsets.assign(1, 0);
+    _stringData.clear();
+    for (auto& names : _names) names.clear();
+    _dates.clear();
+    _whiteElos.clear();
+    _blackElos.clear();
+    _results.clear();
+    _ecos.clear();
+
+    // the real header is written by close() once the counts are known
+    GameFileHeader header = {};
+    _failed = std::fwrite(&header, sizeof(header), 1, _file) != 1;
+    return !_failed;
+}
+
+void GameDatabaseWriter::add(size_t sequence, std::vector<EncodedGame>&& games)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (sequence != _nextSequence) {
+        _pending.emplace(sequence, std::move(games));
+        return;
+    }
+    for (const EncodedGame& game : games) append(game);
+    _nextSequence++;
+    // earlier arrivals that were waiting for this batch
+    for (auto next = _pending.find(_nextSequence); next != _pending.end(); next = _pending.find(_nextSequence)) {
+        for (const EncodedGame& game : next->second) append(game);
+        _pending.erase(next);
+        _nextSequence++;
+    }
+}
+
+uint32_t GameDatabaseWriter::intern(const std::string& text)
+{
+    auto found = _stringIds.find(text);
+    if (found != _stringIds.end()) return found->second;
+    const uint32_t id = static_cast<uint32_t>(_stringOffsets.size() - 1);
+    _stringIds.emplace(text, id);
+    _stringData += text;
+    _stringOffsets.push_back(static_cast<uint32_t>(_stringData.size()));
+    return id;
+}
+
+void GameDatabaseWriter::append(const EncodedGame& game)
+{
+    if (!_file) return;
+    if (!game.fitsBlock()) {
+        _droppedGames++;
+        return;
+    }
+    const size_t fenBytes = std::min<size_t>(game.fen.size(), 255);
+    const size_t recordBytes = 3 + fenBytes + game.moves.size();
+    if (_blockUsed + recordBytes > GameBlockBytes) flushBlock();
+
+    uint8_t* record = _block.data() + _blockUsed;
+    record[0] = static_cast<uint8_t>(game.moves.size());
+    record[1] = static_cast<uint8_t>(game.moves.size() >> 8);
+    record[2] = static_cast<uint8_t>(fenBytes);
+    std::memcpy(record + 3, game.fen.data(), fenBytes);
+    std::memcpy(record + 3 + fenBytes, game.moves.data(), game.moves.size());
+    _index.push_back({ _blockCount, static_cast<uint16_t>(_blockUsed), static_cast<uint16_t>(game.moves.size()) });
+    _blockUsed += recordBytes;
+
+    const GameHeader& header = game.header;
+    _names[0].push_back(intern(header.white));
+    _names[1].push_back(intern(header.black));
+    _names[2].push_back(intern(header.event));
+    _names[3].push_back(intern(header.site));
+    _dates.push_back(header.date);
+    _whiteElos.push_back(header.whiteElo);
+    _blackElos.push_back(header.blackElo);
+    _results.push_back(static_cast<int8_t>(header.result));
+    _ecos.push_back(header.eco);
+}
+
+void GameDatabaseWriter::flushBlock(bool last)
+{
+    if (_blockUsed == 0) return;
+    // the last block only needs its records, padded so the index after it stays aligned
+    const size_t bytes = last ? (_blockUsed + alignof(uint64_t) - 1) & ~(alignof(uint64_t) - 1) : _block.size();
+    std::fill(_block.begin() + _blockUsed, _block.begin() + bytes, 0);
+    if (std::fwrite(_block.data(), bytes, 1, _file) != 1) _failed = true;
+    _blockBytes += bytes;
+    _blockCount++;
+    _blockUsed = 0;
+}
+
+bool GameDatabaseWriter::close()
+{
+    if (!_file) return false;
+    // batches still waiting for a missing sequence number are stored rather than lost
+    for (auto& [sequence, games] : _pending) {
+        for (const EncodedGame& game : games) append(game);
+    }
+    _pending.clear();
+    flushBlock(true);
+
+    GameFileHeader header = {};
+    std::memcpy(header.magic, GameMagic, sizeof(header.magic));
+    header.version = GameDatabaseVersion;
+    header.blockBytes = GameBlockBytes;
+    header.gameCount = _index.size();
+    header.blockCount = _blockCount;
+    header.indexOffset = sizeof(GameFileHeader) + _blockBytes;
+    if (!_index.empty() && std::fwrite(_index.data(), sizeof(GameIndexEntry), _index.size(), _file) != _index.size()) _failed = true;
+    if (std::fseek(_file, 0, SEEK_SET) != 0 || std::fwrite(&header, sizeof(header), 1, _file) != 1) _failed = true;
+    if (std::fclose(_file) != 0) _failed = true;
+    _file = nullptr;
+
+    if (!writeHeaders()) _failed = true;
+    return !_failed;
+}
+
+bool GameDatabaseWriter::writeHeaders()
+{
+    FILE* file = std::fopen((_basePath + ".headers").c_str(), "wb");
+    if (!file) return false;
+
+    HeaderFileHeader header = {};
+    std::memcpy(header.magic, HeaderMagic, sizeof(header.magic));
+    header.version = GameDatabaseVersion;
+    header.columnCount = HeaderColumnCount;
+    header.gameCount = _index.size();
+    header.stringCount = _stringOffsets.size() - 1;
+
+    const void* columns[HeaderColumnCount] = {
+        _names[0].data(), _names[1].data(), _names[2].data(), _names[3].data(),
+        _dates.data(), _whiteElos.data(), _blackElos.data(), _results.data(), _ecos.data()
+    };
+    // every column starts 8 byte aligned so the reader can use it in place
+    auto align = [](uint64_t offset) { return (offset + 7) & ~uint64_t(7); };
+    uint64_t offset = align(sizeof(HeaderFileHeader));
+    for (int column = 0; column < HeaderColumnCount; column++) {
+        header.columns[column] = offset;
+        offset = align(offset + ColumnBytes[column] * header.gameCount);
+    }
+    header.stringOffsets = offset;
+    header.strings = offset + _stringOffsets.size() * sizeof(uint32_t);
+
+    bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1;
+    const char zeros[8] = {};
+    uint64_t written = sizeof(header);
+    auto pad = [&](uint64_t to) {
+        if (to > written) ok = ok && std::fwrite(zeros, 1, to - written, file) == to - written;
+        written = to;
+    };
+    for (int column = 0; column < HeaderColumnCount; column++) {
+        pad(header.columns[column]);
+        const size_t bytes = ColumnBytes[column] * header.gameCount;
+        if (bytes) ok = ok && std::fwrite(columns[column], 1, bytes, file) == bytes;
+        written += bytes;
+    }
+    pad(header.stringOffsets);
+    ok = ok && std::fwrite(_stringOffsets.data(), sizeof(uint32_t), _stringOffsets.size(), file) == _stringOffsets.size();
+    if (!_stringData.empty()) ok = ok && std::fwrite(_stringData.data(), 1, _stringData.size(), file) == _stringData.size();
+    return std::fclose(file) == 0 && ok;
+}
+
+GameDatabase::GameDatabase()
+    : _gameInfo(nullptr)
+    , _headerInfo(nullptr)
+    , _index(nullptr)
+    , _stringOffsets(nullptr)
+    , _strings(nullptr)
+    , _gameCount(0)
+{
+}
+
+bool GameDatabase::open(const std::string& basePath)
+{
+    close();
+    if (!_games.open(basePath + ".games") || !_headers.open(basePath + ".headers")) {
+        close();
+        return false;
+    }
+    _gameInfo = reinterpret_cast<const GameFileHeader*>(_games.data());
+    _headerInfo = reinterpret_cast<const HeaderFileHeader*>(_headers.data());
+    const bool valid = _games.size() >= sizeof(GameFileHeader) && _headers.size() >= sizeof(HeaderFileHeader)
+        && std::memcmp(_gameInfo->magic, GameMagic, sizeof(GameMagic)) == 0
+        && std::memcmp(_headerInfo->magic, HeaderMagic, sizeof(HeaderMagic)) == 0
+        && _gameInfo->version == GameDatabaseVersion && _headerInfo->version == GameDatabaseVersion
+        && _gameInfo->blockBytes == GameBlockBytes && _headerInfo->columnCount == HeaderColumnCount
+        && _gameInfo->gameCount == _headerInfo->gameCount
+        && _gameInfo->indexOffset + _gameInfo->gameCount * sizeof(GameIndexEntry) <= _games.size()
+        && _headerInfo->strings <= _headers.size();
+    if (!valid) {
+        close();
+        return false;
+    }
+    _basePath = basePath;
+    _gameCount = _gameInfo->gameCount;
+    _index = reinterpret_cast<const GameIndexEntry*>(_games.data() + _gameInfo->indexOffset);
+    _stringOffsets = reinterpret_cast<const uint32_t*>(_headers.data() + _headerInfo->stringOffsets);
+    _strings = _headers.data() + _headerInfo->strings;
+    return true;
+}
+
+void GameDatabase::close()
+{
+    _games.close();
+    _headers.close();
+    _gameInfo = nullptr;
+    _headerInfo = nullptr;
+    _index = nullptr;
+    _stringOffsets = nullptr;
+    _strings = nullptr;
+    _gameCount = 0;
+    _basePath.clear();
+}
+
+GameView GameDatabase::game(uint64_t id) const
+{
+    GameView view;
+    if (id >= _gameCount) return view;
+    const GameIndexEntry& entry = _index[id];
+    const uint8_t* record = reinterpret_cast<const uint8_t*>(_games.data()) + sizeof(GameFileHeader)
+        + uint64_t(entry.block) * GameBlockBytes + entry.offset;
+    view.plies = entry.plies;
+    view.fen = std::string_view(reinterpret_cast<const char*>(record + 3), record[2]);
+    view.moves = record + 3 + record[2];
+    return view;
+}
+
+bool GameDatabase::startPosition(uint64_t id, GameState& position) const
+{
+    const GameView view = game(id);
+    return position.initFromFEN(view.fen.empty() ? std::string(StartFEN) : std::string(view.fen));
+}
+
+bool GameDatabase::decode(uint64_t id, GameState& position, std::vector<BitMove>& moves) const
+{
+    moves.clear();
+    std::vector<BitMove> legal;
+    return replay(id, position, legal, [&](int, const GameState&, const BitMove& move) {
+        if (!move.isNull()) moves.push_back(move);
+        return true;
+    });
+}
+
+GameHeader GameDatabase::header(uint64_t id) const
+{
+    GameHeader header;
+    header.white = white(id);
+    header.black = black(id);
+    header.event = event(id);
+    header.site = site(id);
+    header.date = date(id);
+    header.whiteElo = whiteElo(id);
+    header.blackElo = blackElo(id);
+    header.result = result(id);
+    header.eco = eco(id);
+    return header;
+}
+
+std::string_view GameDatabase::stringAt(uint32_t stringId) const
+{
+    if (stringId >= _headerInfo->stringCount) return {};
+    return std::string_view(_strings + _stringOffsets[stringId], _stringOffsets[stringId + 1] - _stringOffsets[stringId]);
+}
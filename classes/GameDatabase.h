@@ -0,0 +1,226 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "MappedFile.h"
+#include "Pgn.h"
+
+//
+// binary game store, a database is a set of files sharing a base path:
+//   base.games    a GameFileHeader, fixed size blocks of game records (the last cut after its records), then one GameIndexEntry per game
+//   base.headers  a HeaderFileHeader, one array per header column, then the interned strings
+// a game record is uint16 plies, uint8 FEN length, the FEN (empty for the standard start), then one byte per ply
+// holding the move's index in GameState::generateAllMoves(), so moves cost a byte and are decoded by replaying
+//
+
+constexpr uint32_t GameBlockBytes = 64 * 1024;
+// games a worker takes from a shared counter at a time when going through a whole database
+constexpr uint64_t GameBatch = 256;
+constexpr uint32_t GameDatabaseVersion = 2;
+// header result of a game that was not finished, the others are +1, 0 and -1 from white's point of view
+constexpr int UnknownResult = 2;
+
+struct GameFileHeader {
+    char magic[8];                  // "CBGAMES"
+    uint32_t version;
+    uint32_t blockBytes;
+    uint64_t gameCount;
+    uint64_t blockCount;
+    uint64_t indexOffset;           // of the GameIndexEntry table, right after the records of the last block
+};
+
+struct GameIndexEntry {
+    uint32_t block;
+    uint16_t offset;                // of the record inside its block
+    uint16_t plies;
+};
+static_assert(sizeof(GameIndexEntry) == 8, "GameIndexEntry must stay 8 bytes");
+
+enum HeaderColumn {
+    ColumnWhite,                    // uint32 string ids
+    ColumnBlack,
+    ColumnEvent,
+    ColumnSite,
+    ColumnDate,                     // uint32 yyyymmdd, unknown parts are 0
+    ColumnWhiteElo,                 // uint16, 0 when unknown
+    ColumnBlackElo,
+    ColumnResult,                   // int8
+    ColumnEco,                      // uint16, see ecoFromString
+    HeaderColumnCount
+};
+
+struct HeaderFileHeader {
+    char magic[8];                  // "CBHEADS"
+    uint32_t version;
+    uint32_t columnCount;
+    uint64_t gameCount;
+    uint64_t stringCount;
+    uint64_t columns[HeaderColumnCount];    // file offset of each column
+    uint64_t stringOffsets;         // stringCount + 1 uint32 offsets into the string data
+    uint64_t strings;
+};
+
+struct GameHeader {
+    std::string white;
+    std::string black;
+    std::string event;
+    std::string site;
+    uint32_t date = 0;
+    uint16_t whiteElo = 0;
+    uint16_t blackElo = 0;
+    int result = UnknownResult;
+    uint16_t eco = 0;
+
+    // from the seven tag roster plus WhiteElo, BlackElo and ECO
+    void fromPgn(const PgnGame& game);
+};
+
+// a game ready to be stored, built on the importing thread
+struct EncodedGame {
+    GameHeader header;
+    std::string fen;
+    std::vector<uint8_t> moves;
+
+    // game must have been replayed, see replayPgnGame
+    void fromPgn(const PgnGame& game);
+    // a record has to fit one block and count its plies in 16 bits, no real game comes close
+    bool fitsBlock() const;
+};
+
+//
+// writes a database from games arriving in numbered batches on several threads,
+// batches are stored in sequence order whatever order they arrive in
+//
+class GameDatabaseWriter
+{
+public:
+    GameDatabaseWriter();
+    ~GameDatabaseWriter();
+    GameDatabaseWriter(const GameDatabaseWriter&) = delete;
+    GameDatabaseWriter& operator=(const GameDatabaseWriter&) = delete;
+
+    bool open(const std::string& basePath);
+    // thread safe, every sequence number from 0 up has to arrive once, empty batches included
+    void add(size_t sequence, std::vector<EncodedGame>&& games);
+    // writes the game index and the header table, false if any write failed
+    bool close();
+
+    uint64_t gameCount() const { return _index.size(); }
+    // games that did not fit a block, they are left out
+    uint64_t droppedGames() const { return _droppedGames; }
+
+private:
+    void append(const EncodedGame& game);
+    void flushBlock(bool last = false);
+    uint32_t intern(const std::string& text);
+    bool writeHeaders();
+
+    std::string _basePath;
+    FILE* _file;
+    bool _failed;
+
+    std::mutex _mutex;
+    size_t _nextSequence;
+    std::map<size_t, std::vector<EncodedGame>> _pending;
+
+    std::vector<uint8_t> _block;
+    size_t _blockUsed;
+    uint32_t _blockCount;
+    uint64_t _blockBytes;           // written so far, the last block is cut short after its records
+    uint64_t _droppedGames;
+    std::vector<GameIndexEntry> _index;
+
+    std::unordered_map<std::string, uint32_t> _stringIds;
+    std::vector<uint32_t> _stringOffsets;
+    std::string _stringData;
+    std::vector<uint32_t> _names[4];    // white, black, event, site
+    std::vector<uint32_t> _dates;
+    std::vector<uint16_t> _whiteElos;
+    std::vector<uint16_t> _blackElos;
+    std::vector<int8_t> _results;
+    std::vector<uint16_t> _ecos;
+};
+
+struct GameView {
+    uint16_t plies = 0;
+    std::string_view fen;           // empty for the standard start position
+    const uint8_t* moves = nullptr;
+};
+
+//
+// read only access to a database through memory maps, any game is found in constant time
+// safe to share between threads
+//
+class GameDatabase
+{
+public:
+    GameDatabase();
+
+    bool open(const std::string& basePath);
+    void close();
+
+    const std::string& basePath() const { return _basePath; }
+    uint64_t size() const { return _gameCount; }
+    // bytes of both files
+    uint64_t bytes() const { return _games.size() + _headers.size(); }
+
+    GameView game(uint64_t id) const;
+    // sets position to the game's start
+    bool startPosition(uint64_t id, GameState& position) const;
+    // replays the game, position ends on its final position; false when a move index is not legal
+    bool decode(uint64_t id, GameState& position, std::vector<BitMove>& moves) const;
+    // replays the game calling visit(ply, position, move) on every position from the start to the end, move is the one
+    // played from it and null on the last position or where the stored move is not legal; returning false from visit
+    // stops early. legal is the caller's scratch list, reused by every ply. false when a move is not legal
+    template <typename Visit>
+    bool replay(uint64_t id, GameState& position, std::vector<BitMove>& legal, Visit&& visit) const
+    {
+        if (id >= _gameCount || !startPosition(id, position)) return false;
+        const GameView view = game(id);
+        for (int ply = 0; ply <= view.plies; ply++) {
+            BitMove move;
+            if (ply < view.plies) {
+                position.generateAllMoves(legal);
+                if (view.moves[ply] < legal.size()) move = legal[view.moves[ply]];
+            }
+            if (!visit(ply, position, move)) return true;
+            if (ply == view.plies) break;
+            if (move.isNull()) return false;
+            position.playMove(move);
+        }
+        return true;
+    }
+
+    std::string_view white(uint64_t id) const { return stringAt(column<uint32_t>(ColumnWhite)[id]); }
+    std::string_view black(uint64_t id) const { return stringAt(column<uint32_t>(ColumnBlack)[id]); }
+    std::string_view event(uint64_t id) const { return stringAt(column<uint32_t>(ColumnEvent)[id]); }
+    std::string_view site(uint64_t id) const { return stringAt(column<uint32_t>(ColumnSite)[id]); }
+    uint32_t date(uint64_t id) const { return column<uint32_t>(ColumnDate)[id]; }
+    uint16_t whiteElo(uint64_t id) const { return column<uint16_t>(ColumnWhiteElo)[id]; }
+    uint16_t blackElo(uint64_t id) const { return column<uint16_t>(ColumnBlackElo)[id]; }
+    int result(uint64_t id) const { return column<int8_t>(ColumnResult)[id]; }
+    uint16_t eco(uint64_t id) const { return column<uint16_t>(ColumnEco)[id]; }
+    GameHeader header(uint64_t id) const;
+
+    std::string_view stringAt(uint32_t stringId) const;
+
+private:
+    template <typename T>
+    const T* column(HeaderColumn which) const { return reinterpret_cast<const T*>(_headers.data() + _headerInfo->columns[which]); }
+
+    std::string _basePath;
+    MappedFile _games;
+    MappedFile _headers;
+    const GameFileHeader* _gameInfo;
+    const HeaderFileHeader* _headerInfo;
+    const GameIndexEntry* _index;
+    const uint32_t* _stringOffsets;
+    const char* _strings;
+    uint64_t _gameCount;
+};
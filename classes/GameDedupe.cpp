@@ -0,0 +1,49 @@
+#include <algorithm>
+#include "GameDedupe.h"
+
+GameFingerprint GameFingerprint::of(const PgnGame& game)
+{
+    // polynomial hash over the 16 bit moves, +1 so a null move still changes it, then a final mix
+    // so sequences that differ in their last move differ in the shard bits too
+    uint64_t hash = game.moves.size();
+    for (const BitMove& move : game.moves) {
+        hash = hash * 0x9E3779B97F4A7C15ULL + move.data + 1;
+    }
+    hash ^= hash >> 31;
+    hash *= 0xBF58476D1CE4E5B9ULL;
+    hash ^= hash >> 29;
+    return { hash, game.finalHash };
+}
+
+DuplicateFilter::DuplicateFilter()
+    : _checked(0)
+    , _duplicates(0)
+{
+}
+
+bool DuplicateFilter::insert(const GameFingerprint& fingerprint)
+{
+    Shard& shard = _shards[fingerprint.moves >> 56];
+    bool inserted;
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        inserted = shard.seen.insert(fingerprint).second;
+    }
+    _checked++;
+    if (!inserted) _duplicates++;
+    return inserted;
+}
+
+DedupeStats DuplicateFilter::stats()
+{
+    DedupeStats stats;
+    stats.checked = _checked;
+    stats.duplicates = _duplicates;
+    stats.smallestShard = SIZE_MAX;
+    for (Shard& shard : _shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        stats.smallestShard = std::min(stats.smallestShard, shard.seen.size());
+        stats.largestShard = std::max(stats.largestShard, shard.seen.size());
+    }
+    return stats;
+}
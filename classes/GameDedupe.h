@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <unordered_set>
+#include "Pgn.h"
+
+// identifies a game by what was played, whatever its tags say: a rolling hash over the move
+// sequence and the Zobrist key of the final position, games from different start positions
+// that happen to share moves end on different positions
+struct GameFingerprint {
+    uint64_t moves = 0;
+    uint64_t finalPosition = 0;
+
+    bool operator==(const GameFingerprint& other) const { return moves == other.moves && finalPosition == other.finalPosition; }
+
+    // game must have been replayed, see replayPgnGame
+    static GameFingerprint of(const PgnGame& game);
+};
+
+struct DedupeStats {
+    uint64_t checked = 0;
+    uint64_t duplicates = 0;
+    size_t smallestShard = 0;       // fingerprints, to show how evenly the shards fill
+    size_t largestShard = 0;
+
+    double duplicateRate() const { return checked ? double(duplicates) / checked : 0.0; }
+};
+
+//
+// set of the fingerprints seen so far, shared by the import threads: it is split into shards by the
+// move hash, each with its own lock, so threads only wait when they hit the same shard at the same time
+// with several threads the copy that is kept is whichever reaches the set first, not always the first in the file
+//
+class DuplicateFilter
+{
+public:
+    DuplicateFilter();
+
+    // thread safe, true the first time a fingerprint is inserted
+    bool insert(const GameFingerprint& fingerprint);
+    DedupeStats stats();
+
+private:
+    struct FingerprintHash {
+        size_t operator()(const GameFingerprint& fingerprint) const { return size_t(fingerprint.moves ^ fingerprint.finalPosition); }
+    };
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_set<GameFingerprint, FingerprintHash> seen;
+    };
+    static constexpr int ShardCount = 256;
+
+    Shard _shards[ShardCount];
+    std::atomic<uint64_t> _checked;
+    std::atomic<uint64_t> _duplicates;
+};
@@ -1,53 +1,467 @@
 
 #include <algorithm>
 #include <iostream>
+#include <mutex>
+#include <sstream>
+#include "EvalParams.h"
 #include "GameState.h"
 #include "MagicBitboards.h"
 
 static int _bitboardLookup[128];
-static bool _initedMagic = false;
+static std::once_flag _initedMagic;
 static BitBoard _pawnAttacks[2][64]; // Precomputed pawn attacks for each square
+static uint64_t _zobristPieces[e_numBitboards][64];
+static uint64_t _zobristCastling[16];
+static uint64_t _zobristEnPassant[8];
+static uint64_t _zobristBlackToMove;
+// material plus piece square value of every piece on every square, white positive
+static int _pieceSquareScores[128][64];
+
+// splitmix64, fixed seed so hashes are the same from run to run
+static uint64_t nextZobristKey(uint64_t& seed) {
+    uint64_t z = (seed += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static void initTables() {
+    initMagicBitboards();
+    // remove branching when we make the bitboards
+    for(int i=0; i<128; i++) { _bitboardLookup[i] = 0; }
+
+    _bitboardLookup['P'] = WHITE_PAWNS;
+    _bitboardLookup['N'] = WHITE_KNIGHTS;
+    _bitboardLookup['B'] = WHITE_BISHOPS;
+    _bitboardLookup['R'] = WHITE_ROOKS;
+    _bitboardLookup['Q'] = WHITE_QUEENS;
+    _bitboardLookup['K'] = WHITE_KING;
+    _bitboardLookup['p'] = BLACK_PAWNS;
+    _bitboardLookup['n'] = BLACK_KNIGHTS;
+    _bitboardLookup['b'] = BLACK_BISHOPS;
+    _bitboardLookup['r'] = BLACK_ROOKS;
+    _bitboardLookup['q'] = BLACK_QUEENS;
+    _bitboardLookup['k'] = BLACK_KING;
+    _bitboardLookup['0'] = EMPTY_SQUARES;
+
+    for(int square = 0; square < 64; square++) {
+        _pawnAttacks[0][square].setData(GameState::generatePawnAttacksBitBoard(square, WHITE));
+        _pawnAttacks[1][square].setData(GameState::generatePawnAttacksBitBoard(square, BLACK));
+    }
+
+    uint64_t seed = 0x00C0FFEE2024ULL;
+    for (int piece = 0; piece < e_numBitboards; piece++) {
+        for (int square = 0; square < 64; square++) {
+            _zobristPieces[piece][square] = nextZobristKey(seed);
+        }
+    }
+    for (int i = 0; i < 16; i++) { _zobristCastling[i] = nextZobristKey(seed); }
+    for (int i = 0; i < 8; i++) { _zobristEnPassant[i] = nextZobristKey(seed); }
+    _zobristBlackToMove = nextZobristKey(seed);
+
+    std::memset(_pieceSquareScores, 0, sizeof(_pieceSquareScores));
+    for (int piece = Pawn; piece <= King; piece++) {
+        const char white = "0PNBRQK"[piece];
+        const char black = "0pnbrqk"[piece];
+        for (int square = 0; square < 64; square++) {
+            _pieceSquareScores[(unsigned char)white][square] = EvalMaterial[piece] + EvalPieceSquare[piece][square];
+            _pieceSquareScores[(unsigned char)black][square] = -(EvalMaterial[piece] + EvalPieceSquare[piece][square ^ 56]);
+        }
+    }
+
+    // stderr, so headless commands writing results to stdout stay clean
+    std::cerr << "initialized magic bitboards and bitboard lookup" << std::endl;
+}
 
 void GameState::init(const char* newState, char player) {
+    std::call_once(_initedMagic, initTables);
+
     std::memcpy(state, newState, 64);
     color = player;
     flags = 0;
-    _zobristHash[0] = 0;
-    _zobristHash[1] = 0;
+    halfmoveClock = 0;
+    _undoStack.clear();
+    _hashHistory.clear();
+    _bitboardsCurrent = false;
     _attackBitBoard.setData(0);
     // Clear all bitboards
     for (int i = 0; i < e_numBitboards; ++i) {
         _bitboards[i].setData(0);
     }
 
-    if (!_initedMagic) {
-        initMagicBitboards();
-        // remove branching when we make the bitboards
-        for(int i=0; i<128; i++) { _bitboardLookup[i] = 0; }
-
-        _bitboardLookup['P'] = WHITE_PAWNS;
-        _bitboardLookup['N'] = WHITE_KNIGHTS;
-        _bitboardLookup['B'] = WHITE_BISHOPS;
-        _bitboardLookup['R'] = WHITE_ROOKS;
-        _bitboardLookup['Q'] = WHITE_QUEENS;
-        _bitboardLookup['K'] = WHITE_KING;
-        _bitboardLookup['p'] = BLACK_PAWNS;
-        _bitboardLookup['n'] = BLACK_KNIGHTS;
-        _bitboardLookup['b'] = BLACK_BISHOPS;
-        _bitboardLookup['r'] = BLACK_ROOKS;
-        _bitboardLookup['q'] = BLACK_QUEENS;
-        _bitboardLookup['k'] = BLACK_KING;
-        _bitboardLookup['0'] = EMPTY_SQUARES;
-
-        for(int square = 0; square < 64; square++) {
-            _pawnAttacks[0][square].setData(generatePawnAttacksBitBoard(square, WHITE));
-            _pawnAttacks[1][square].setData(generatePawnAttacksBitBoard(square, BLACK));
+    // a plain board string has no castling field, so trust pieces that are still on their home squares
+    castling = 0;
+    if (state[4] == 'K' && state[7] == 'R') castling |= WhiteKingSide;
+    if (state[4] == 'K' && state[0] == 'R') castling |= WhiteQueenSide;
+    if (state[60] == 'k' && state[63] == 'r') castling |= BlackKingSide;
+    if (state[60] == 'k' && state[56] == 'r') castling |= BlackQueenSide;
+    enPassant = NoSquare;
+    hash = computeHash();
+}
+
+bool GameState::initFromFEN(const std::string& fen) {
+    std::istringstream fenStream(fen);
+    std::string board, side, rights, ep;
+    int halfmoves = 0;
+    fenStream >> board >> side >> rights >> ep >> halfmoves;
+    if (board.empty()) return false;
+
+    char squares[64];
+    std::memset(squares, '0', sizeof(squares));
+    int row = 7;
+    int col = 0;
+    for (char ch : board) {
+        if (ch == '/') {
+            row--;
+            col = 0;
+        } else if (isdigit(static_cast<unsigned char>(ch))) {
+            col += ch - '0';
+        } else {
+            if (row < 0 || col > 7 || !strchr("PNBRQKpnbrqk", ch)) return false;
+            squares[row * 8 + col] = ch;
+            col++;
+        }
+    }
+    if (row != 0) return false;
+    // move generation and the search look up both kings, a position without them can't be played
+    if (std::count(squares, squares + 64, 'K') != 1 || std::count(squares, squares + 64, 'k') != 1) return false;
+
+    init(squares, side == "b" ? BLACK : WHITE);
+    castling = 0;
+    for (char ch : rights) {
+        if (ch == 'K') castling |= WhiteKingSide;
+        if (ch == 'Q') castling |= WhiteQueenSide;
+        if (ch == 'k') castling |= BlackKingSide;
+        if (ch == 'q') castling |= BlackQueenSide;
+    }
+    enPassant = NoSquare;
+    if (ep.size() == 2 && ep[0] >= 'a' && ep[0] <= 'h' && ep[1] >= '1' && ep[1] <= '8') {
+        enPassant = (ep[1] - '1') * 8 + (ep[0] - 'a');
+    }
+    halfmoveClock = std::max(0, halfmoves);
+    hash = computeHash();
+    return true;
+}
+
+std::string GameState::toFEN() const {
+    std::string fen;
+    for (int row = 7; row >= 0; row--) {
+        int empty = 0;
+        for (int col = 0; col < 8; col++) {
+            char ch = state[row * 8 + col];
+            if (ch == '0') {
+                empty++;
+                continue;
+            }
+            if (empty) fen += char('0' + empty);
+            empty = 0;
+            fen += ch;
         }
+        if (empty) fen += char('0' + empty);
+        if (row) fen += '/';
+    }
+    fen += color == WHITE ? " w " : " b ";
+    if (castling & WhiteKingSide) fen += 'K';
+    if (castling & WhiteQueenSide) fen += 'Q';
+    if (castling & BlackKingSide) fen += 'k';
+    if (castling & BlackQueenSide) fen += 'q';
+    if (!castling) fen += '-';
+    if (enPassant == NoSquare) {
+        fen += " -";
+    } else {
+        fen += ' ';
+        fen += char('a' + enPassant % 8);
+        fen += char('1' + enPassant / 8);
+    }
+    return fen;
+}
+
+uint64_t GameState::computeHash() const {
+    uint64_t key = 0;
+    for (int square = 0; square < 64; square++) {
+        if (state[square] != '0') {
+            key ^= _zobristPieces[_bitboardLookup[(unsigned char)state[square]]][square];
+        }
+    }
+    key ^= _zobristCastling[castling & 15];
+    if (enPassant != NoSquare) key ^= _zobristEnPassant[enPassant % 8];
+    if (color == BLACK) key ^= _zobristBlackToMove;
+    return key;
+}
+
+uint64_t GameState::hashWithoutEnPassant() const {
+    return enPassant == NoSquare ? hash : hash ^ _zobristEnPassant[enPassant % 8];
+}
+
+uint64_t GameState::positionKey() const {
+    if (enPassant == NoSquare) return hash;
+    // the capturing pawns stand beside the pawn that just moved two squares
+    const int file = enPassant % 8;
+    const int behind = color == WHITE ? enPassant - 8 : enPassant + 8;
+    const char pawn = color == WHITE ? 'P' : 'p';
+    const bool capturable = (file > 0 && state[behind - 1] == pawn) || (file < 7 && state[behind + 1] == pawn);
+    return capturable ? hash : hashWithoutEnPassant();
+}
 
-        _initedMagic = true;
+void GameState::updateCastlingRights(int square) {
+    switch (square) {
+        case 0:  castling &= ~WhiteQueenSide; break;
+        case 4:  castling &= ~(WhiteKingSide | WhiteQueenSide); break;
+        case 7:  castling &= ~WhiteKingSide; break;
+        case 56: castling &= ~BlackQueenSide; break;
+        case 60: castling &= ~(BlackKingSide | BlackQueenSide); break;
+        case 63: castling &= ~BlackKingSide; break;
+        default: break;
+    }
+}
+
+void GameState::pushMove(const BitMove& move) {
+    const int from = move.from();
+    const int to = move.to();
+    _undoStack.push_back(UndoRecord{move, state[to], castling, enPassant, flags, halfmoveClock, hash});
+    _hashHistory.push_back(hash);
+    _bitboardsCurrent = false;
+    auto toggle = [&](int square, char piece) {
+        hash ^= _zobristPieces[_bitboardLookup[(unsigned char)piece]][square];
+    };
+    hash ^= _zobristCastling[castling & 15];
+    if (enPassant != NoSquare) hash ^= _zobristEnPassant[enPassant % 8];
+
+    unsigned char fromPiece = state[from];
+    const bool irreversible = state[to] != '0' || fromPiece == 'P' || fromPiece == 'p';
+    halfmoveClock = irreversible ? 0 : halfmoveClock + 1;
+    if (state[to] != '0') toggle(to, state[to]);
+    toggle(from, fromPiece);
+    state[from] = '0';
+    state[to] = fromPiece;
+    if (move.isCastling()) {
+        // king side castles land on the g file, queen side on the c file
+        const int rookFrom = to > from ? to + 1 : to - 2;
+        const int rookTo = to > from ? to - 1 : to + 1;
+        toggle(rookFrom, state[rookFrom]);
+        toggle(rookTo, state[rookFrom]);
+        state[rookTo] = state[rookFrom];
+        state[rookFrom] = '0';
+    } else if (move.isEnPassant()) {
+        // check for color to determine which direction to capture
+        int captured = (fromPiece == 'P') ? to - 8 : to + 8;
+        toggle(captured, state[captured]);
+        state[captured] = '0';
+    } else if (move.isPromotion()) {
+        state[to] = (color == WHITE ? "NBRQ" : "nbrq")[move.promotion() - Knight];
+    }
+    toggle(to, state[to]);
+
+    updateCastlingRights(from);
+    updateCastlingRights(to);
+    enPassant = NoSquare;
+    if ((fromPiece == 'P' || fromPiece == 'p') && (to - from == 16 || from - to == 16)) {
+        enPassant = (from + to) / 2;
+        hash ^= _zobristEnPassant[enPassant % 8];
+    }
+    hash ^= _zobristCastling[castling & 15];
+    hash ^= _zobristBlackToMove;
+
+    // flip the color bit as it now becomes the other player's turn
+    color = (color == WHITE) ? BLACK : WHITE;
+    flags = 0; // invalidate all the flags
+}
+
+void GameState::popMove() {
+    assert(!_undoStack.empty());
+    const UndoRecord& undo = _undoStack.back();
+    const int from = undo.move.from();
+    const int to = undo.move.to();
+    color = (color == WHITE) ? BLACK : WHITE;
+    _bitboardsCurrent = false;
+
+    state[from] = undo.move.isPromotion() ? (color == WHITE ? 'P' : 'p') : state[to];
+    state[to] = undo.captured;
+    if (undo.move.isCastling()) {
+        const int rookFrom = to > from ? to + 1 : to - 2;
+        const int rookTo = to > from ? to - 1 : to + 1;
+        state[rookFrom] = state[rookTo];
+        state[rookTo] = '0';
+    } else if (undo.move.isEnPassant()) {
+        state[color == WHITE ? to - 8 : to + 8] = color == WHITE ? 'p' : 'P';
+    }
+
+    castling = undo.castling;
+    enPassant = undo.enPassant;
+    flags = undo.flags;
+    halfmoveClock = undo.halfmoveClock;
+    hash = undo.hash;
+    _undoStack.pop_back();
+    _hashHistory.pop_back();
+}
+
+ChessPiece GameState::pieceAt(int square) const {
+    switch (toupper(state[square])) {
+        case 'P': return Pawn;
+        case 'N': return Knight;
+        case 'B': return Bishop;
+        case 'R': return Rook;
+        case 'Q': return Queen;
+        case 'K': return King;
+        default: return NoPiece;
+    }
+}
+
+int GameState::evaluate() const {
+    int value = 0;
+    for (int square = 0; square < 64; square++) {
+        value += _pieceSquareScores[(unsigned char)state[square]][square];
+    }
+    return color == WHITE ? value : -value;
+}
+
+bool GameState::hasInsufficientMaterial() const {
+    int minors = 0;
+    for (int square = 0; square < 64; square++) {
+        switch (state[square]) {
+            case '0': case 'K': case 'k': break;
+            case 'N': case 'n': case 'B': case 'b': minors++; break;
+            default: return false;
+        }
+    }
+    return minors <= 1;
+}
+
+// only positions since the last irreversible move can repeat, and only every other one has the same side to move
+bool GameState::isRepetition() const {
+    const int count = static_cast<int>(_hashHistory.size());
+    const int limit = std::min(halfmoveClock, count);
+    for (int back = 4; back <= limit; back += 2) {
+        if (_hashHistory[count - back] == hash) return true;
+    }
+    return false;
+}
+
+int GameState::repetitionCount() const {
+    const int count = static_cast<int>(_hashHistory.size());
+    const int limit = std::min(halfmoveClock, count);
+    int repetitions = 0;
+    for (int back = 4; back <= limit; back += 2) {
+        if (_hashHistory[count - back] == hash) repetitions++;
+    }
+    return repetitions;
+}
+
+std::string GameState::moveToUCI(const BitMove& move) {
+    std::string text;
+    text += char('a' + move.from() % 8);
+    text += char('1' + move.from() / 8);
+    text += char('a' + move.to() % 8);
+    text += char('1' + move.to() / 8);
+    if (move.isPromotion()) text += "nbrq"[move.promotion() - Knight];
+    return text;
+}
 
-        std::cout << "initialized magic bitboards and bitboard lookup" << std::endl;
+BitMove GameState::parseUCIMove(const std::string& text) {
+    for (const BitMove& move : generateAllMoves()) {
+        if (moveToUCI(move) == text) return move;
     }
+    return BitMove();
+}
+
+BitMove GameState::parseSANMove(std::string_view text, int* moveIndex) {
+    while (!text.empty() && std::strchr("+#!?", text.back())) text.remove_suffix(1);
+    if (text.size() < 2) return BitMove();
+    auto moves = generateAllMoves();
+
+    if (text == "O-O" || text == "0-0" || text == "O-O-O" || text == "0-0-0") {
+        const int file = text.size() == 3 ? 6 : 2;
+        for (size_t i = 0; i < moves.size(); i++) {
+            if (moves[i].isCastling() && moves[i].to() % 8 == file) {
+                if (moveIndex) *moveIndex = static_cast<int>(i);
+                return moves[i];
+            }
+        }
+        return BitMove();
+    }
+
+    ChessPiece piece = Pawn;
+    if (const char* letter = std::strchr("NBRQK", text.front())) {
+        piece = static_cast<ChessPiece>(Knight + (letter - "NBRQK"));
+        text.remove_prefix(1);
+    }
+    ChessPiece promotion = NoPiece;
+    if (const char* letter = std::strchr("NBRQ", text.back())) {
+        promotion = static_cast<ChessPiece>(Knight + (letter - "NBRQ"));
+        text.remove_suffix(1);
+        if (!text.empty() && text.back() == '=') text.remove_suffix(1);
+    }
+    if (text.size() < 2) return BitMove();
+    const char toFile = text[text.size() - 2];
+    const char toRank = text[text.size() - 1];
+    if (toFile < 'a' || toFile > 'h' || toRank < '1' || toRank > '8') return BitMove();
+    const int to = (toRank - '1') * 8 + (toFile - 'a');
+    text.remove_suffix(2);
+
+    int fromFile = -1;
+    int fromRank = -1;
+    for (char c : text) {
+        if (c >= 'a' && c <= 'h') {
+            fromFile = c - 'a';
+        } else if (c >= '1' && c <= '8') {
+            fromRank = c - '1';
+        } else if (c != 'x' && c != ':' && c != '-') {
+            return BitMove();
+        }
+    }
+
+    int found = -1;
+    int matches = 0;
+    for (size_t i = 0; i < moves.size(); i++) {
+        const BitMove& move = moves[i];
+        if (move.to() != to || pieceAt(move.from()) != piece) continue;
+        if (fromFile >= 0 && move.from() % 8 != fromFile) continue;
+        if (fromRank >= 0 && move.from() / 8 != fromRank) continue;
+        if (move.isPromotion() != (promotion != NoPiece)) continue;
+        if (promotion != NoPiece && move.promotion() != promotion) continue;
+        found = static_cast<int>(i);
+        matches++;
+    }
+    if (matches != 1) return BitMove();
+    if (moveIndex) *moveIndex = found;
+    return moves[found];
+}
+
+int GameState::writeSAN(const BitMove& move, const std::vector<BitMove>& legal, char* out) const {
+    int length = 0;
+    if (move.isCastling()) {
+        const char* text = move.to() % 8 == 6 ? "O-O" : "O-O-O";
+        while (*text) out[length++] = *text++;
+        return length;
+    }
+
+    const ChessPiece piece = pieceAt(move.from());
+    const bool capture = isCapture(move);
+    if (piece == Pawn) {
+        if (capture) out[length++] = char('a' + move.from() % 8);
+    } else {
+        out[length++] = "PNBRQK"[piece - Pawn];
+        // other pieces of the same kind that can reach the square decide how much of the from square is written
+        bool ambiguous = false;
+        bool sameFile = false;
+        bool sameRank = false;
+        for (const BitMove& other : legal) {
+            if (other.to() != move.to() || other.from() == move.from() || pieceAt(other.from()) != piece) continue;
+            ambiguous = true;
+            sameFile |= other.from() % 8 == move.from() % 8;
+            sameRank |= other.from() / 8 == move.from() / 8;
+        }
+        if (ambiguous && (!sameFile || sameRank)) out[length++] = char('a' + move.from() % 8);
+        if (ambiguous && sameFile) out[length++] = char('1' + move.from() / 8);
+    }
+    if (capture) out[length++] = 'x';
+    out[length++] = char('a' + move.to() % 8);
+    out[length++] = char('1' + move.to() / 8);
+    if (move.isPromotion()) {
+        out[length++] = '=';
+        out[length++] = "PNBRQK"[move.promotion() - Pawn];
+    }
+    return length;
 }
 
 void GameState::shutdown() {
@@ -59,7 +473,14 @@ void GameState::addPawnBitboardMovesToList(std::vector<BitMove>& moves, const Bi
         return;
     bitboard.forEachBit([&](int toSquare) {
         int fromSquare = toSquare - shift; // Correct calculation for fromSquare
-        moves.emplace_back(fromSquare, toSquare, Pawn);
+        if (toSquare < 8 || toSquare >= 56) {
+            // queen first so the most likely promotion is tried first
+            for (int piece = Queen; piece >= Knight; piece--) {
+                moves.emplace_back(fromSquare, toSquare, PromotionMove, static_cast<ChessPiece>(piece));
+            }
+        } else {
+            moves.emplace_back(fromSquare, toSquare);
+        }
     });
 }
 
@@ -92,6 +513,14 @@ void GameState::generatePawnMoveList(std::vector<BitMove>& moves, const BitBoard
     // Add pawn captures to the list
     addPawnBitboardMovesToList(moves, capturesLeft, captureLeftShift);
     addPawnBitboardMovesToList(moves, capturesRight, captureRightShift);
+
+    // En passant: any of our pawns that a pawn on the target square would attack can capture onto it
+    if (enPassant != NoSquare) {
+        BitBoard attackers = _pawnAttacks[color == WHITE ? 1 : 0][enPassant].getData() & pawns.getData();
+        attackers.forEachBit([&](int fromSquare) {
+            moves.emplace_back(fromSquare, enPassant, EnPassantMove);
+        });
+    }
 }
 
 // Generate actual move objects from a bitboard
@@ -100,7 +529,7 @@ void GameState::generateKnightMoves(std::vector<BitMove>& moves, BitBoard knight
         BitBoard moveBitboard = BitBoard(KnightAttacks[fromSquare] & occupancy);
         // Efficiently iterate through only the set bits
         moveBitboard.forEachBit([&](int toSquare) {
-           moves.emplace_back(fromSquare, toSquare, Knight);
+           moves.emplace_back(fromSquare, toSquare);
         });
     });
 }
@@ -111,7 +540,7 @@ void GameState::generateKingMoves(std::vector<BitMove>& moves, BitBoard piecesBo
         BitBoard moveBitboard = BitBoard(KingAttacks[fromSquare] & occupancy);
         // Efficiently iterate through only the set bits
         moveBitboard.forEachBit([&](int toSquare) {
-           moves.emplace_back(fromSquare, toSquare, King);
+           moves.emplace_back(fromSquare, toSquare);
         });
     });
 }
@@ -123,7 +552,7 @@ void GameState::generateBishopMoves(std::vector<BitMove>& moves, BitBoard pieces
         BitBoard moveBitboard = BitBoard(getBishopAttacks(fromSquare, occupancy) & ~friendlies);
         // Efficiently iterate through only the set bits
         moveBitboard.forEachBit([&](int toSquare) {
-           moves.emplace_back(fromSquare, toSquare, Bishop);
+           moves.emplace_back(fromSquare, toSquare);
         });
     });
 }
@@ -134,7 +563,7 @@ void GameState::generateRooksMoves(std::vector<BitMove>& moves, BitBoard piecesB
         BitBoard moveBitboard = BitBoard(getRookAttacks(fromSquare, occupancy) & ~friendlies);
         // Efficiently iterate through only the set bits
         moveBitboard.forEachBit([&](int toSquare) {
-           moves.emplace_back(fromSquare, toSquare, Rook);
+           moves.emplace_back(fromSquare, toSquare);
         });
     });
 }
@@ -145,11 +574,34 @@ void GameState::generateQueensMoves(std::vector<BitMove>& moves, BitBoard pieces
         BitBoard moveBitboard = BitBoard(getQueenAttacks(fromSquare, occupancy) & ~friendlies);
         // Efficiently iterate through only the set bits
         moveBitboard.forEachBit([&](int toSquare) {
-           moves.emplace_back(fromSquare, toSquare, Queen);
+           moves.emplace_back(fromSquare, toSquare);
         });
     });
 }
 
+void GameState::generateCastlingMoves(std::vector<BitMove>& moves)
+{
+    const int rights = castling & (color == WHITE ? (WhiteKingSide | WhiteQueenSide) : (BlackKingSide | BlackQueenSide));
+    if (!rights) return;
+
+    const int base = (color == WHITE) ? 0 : 56;
+    const char opponent = (color == WHITE) ? BLACK : WHITE;
+    const char king = (color == WHITE) ? 'K' : 'k';
+    const char rook = (color == WHITE) ? 'R' : 'r';
+    if (state[base + 4] != king || isSquareAttacked(base + 4, opponent, _bitboards)) return;
+
+    if ((rights & (WhiteKingSide | BlackKingSide)) && state[base + 7] == rook &&
+        state[base + 5] == '0' && state[base + 6] == '0' &&
+        !isSquareAttacked(base + 5, opponent, _bitboards) && !isSquareAttacked(base + 6, opponent, _bitboards)) {
+        moves.emplace_back(base + 4, base + 6, CastlingMove);
+    }
+    if ((rights & (WhiteQueenSide | BlackQueenSide)) && state[base] == rook &&
+        state[base + 1] == '0' && state[base + 2] == '0' && state[base + 3] == '0' &&
+        !isSquareAttacked(base + 3, opponent, _bitboards) && !isSquareAttacked(base + 2, opponent, _bitboards)) {
+        moves.emplace_back(base + 4, base + 2, CastlingMove);
+    }
+}
+
 template <ChessPiece PIECE_TYPE>
 inline BitBoard generatePieceAttackList(
     const BitBoard pieces, 
@@ -241,7 +693,7 @@ bool GameState::isSquareAttacked(int square, char attackerColor, const BitBoard
 
 	// Check Pawn Attacks
 	char targetColor = (attackerColor == WHITE) ? BLACK : WHITE; 
-	if ((generatePawnAttacksBitBoard(square, targetColor) & boards[pawnIdx].getData()) != 0) return true;
+	if ((_pawnAttacks[targetColor == WHITE ? 0 : 1][square].getData() & boards[pawnIdx].getData()) != 0) return true;
 
 	// Check Knight Attacks
 	if ((KnightAttacks[square] & boards[knightIdx].getData()) != 0) return true;
@@ -260,6 +712,69 @@ bool GameState::isSquareAttacked(int square, char attackerColor, const BitBoard
 	return false;
 }
 
+// pieces of both colors attacking square, sliders see through anything missing from occupancy
+uint64_t GameState::attackersTo(int square, uint64_t occupancy) const {
+    const uint64_t diagonal = _bitboards[WHITE_BISHOPS].getData() | _bitboards[BLACK_BISHOPS].getData() |
+                              _bitboards[WHITE_QUEENS].getData() | _bitboards[BLACK_QUEENS].getData();
+    const uint64_t straight = _bitboards[WHITE_ROOKS].getData() | _bitboards[BLACK_ROOKS].getData() |
+                              _bitboards[WHITE_QUEENS].getData() | _bitboards[BLACK_QUEENS].getData();
+    return (_pawnAttacks[1][square].getData() & _bitboards[WHITE_PAWNS].getData()) |
+           (_pawnAttacks[0][square].getData() & _bitboards[BLACK_PAWNS].getData()) |
+           (KnightAttacks[square] & (_bitboards[WHITE_KNIGHTS].getData() | _bitboards[BLACK_KNIGHTS].getData())) |
+           (KingAttacks[square] & (_bitboards[WHITE_KING].getData() | _bitboards[BLACK_KING].getData())) |
+           (getBishopAttacks(square, occupancy) & diagonal) |
+           (getRookAttacks(square, occupancy) & straight);
+}
+
+int GameState::see(const BitMove& move) {
+    // the king is worth more than everything else combined so it is never traded
+    static const int values[] = { 0, 100, 200, 230, 400, 900, 20000 };
+    if (!_bitboardsCurrent) buildBitboards();
+
+    const int to = move.to();
+    uint64_t occupancy = _bitboards[OCCUPANCY].getData() ^ (1ULL << move.from());
+    int gain[32];
+    gain[0] = move.isEnPassant() ? values[Pawn] : values[pieceAt(to)];
+    int onSquare = values[movedPiece(move)];
+    if (move.isPromotion()) {
+        gain[0] += values[move.promotion()] - values[Pawn];
+        onSquare = values[move.promotion()];
+    }
+    if (move.isEnPassant()) {
+        occupancy ^= 1ULL << (color == WHITE ? to - 8 : to + 8);
+    }
+
+    uint64_t attackers = attackersTo(to, occupancy) & occupancy;
+    int side = (color == WHITE) ? BLACK : WHITE;
+    int depth = 0;
+    while (depth < 31) {
+        // what side would score by taking the piece now on the square, only kept if it has an attacker
+        depth++;
+        gain[depth] = onSquare - gain[depth - 1];
+        if (std::max(-gain[depth - 1], gain[depth]) < 0) break;
+
+        // least valuable attacker of the side to recapture
+        const int first = side == WHITE ? WHITE_PAWNS : BLACK_PAWNS;
+        int piece = Pawn;
+        uint64_t candidates = 0;
+        for (; piece <= King; piece++) {
+            candidates = attackers & _bitboards[first + piece - Pawn].getData();
+            if (candidates) break;
+        }
+        if (!candidates) break;
+
+        onSquare = values[piece];
+        occupancy ^= candidates & (~candidates + 1);
+        // removing the attacker may uncover a slider behind it
+        attackers = attackersTo(to, occupancy) & occupancy;
+        side = (side == WHITE) ? BLACK : WHITE;
+    }
+    while (--depth > 0) {
+        gain[depth - 1] = -std::max(-gain[depth - 1], gain[depth]);
+    }
+    return gain[0];
+}
+
 void GameState::filterOutIllegalMoves(std::vector<BitMove>& moves) {
 	if (moves.empty()) return;
 
@@ -277,8 +792,8 @@ void GameState::filterOutIllegalMoves(std::vector<BitMove>& moves) {
 		// Apply the move to the temporary boards
 		// Note: We just need occupancy correct for check detection.
 		
-		const uint64_t fromMask = 1ULL << move.from;
-		const uint64_t toMask   = 1ULL << move.to;
+		const uint64_t fromMask = 1ULL << move.from();
+		const uint64_t toMask   = 1ULL << move.to();
 		
 		// Helper to determine which bitboard a piece belongs to
 		auto getPieceIdx = [&](ChessPiece p, char c) {
@@ -290,7 +805,8 @@ void GameState::filterOutIllegalMoves(std::vector<BitMove>& moves) {
 			return c == WHITE ? WHITE_KING : BLACK_KING; // King
 		};
 
-		int moverIdx = getPieceIdx(static_cast<ChessPiece>(move.piece), myColor);
+		const ChessPiece mover = movedPiece(move);
+		int moverIdx = getPieceIdx(mover, myColor);
 		
 		// Remove from 'from'
 		tempBoards[moverIdx] &= ~fromMask;
@@ -302,8 +818,8 @@ void GameState::filterOutIllegalMoves(std::vector<BitMove>& moves) {
 		int endOpp   = (opponentColor == WHITE) ? WHITE_KING : BLACK_KING;
 		
 		// Specialized handling for En Passant
-		if (move.flags & EnPassant) {
-			int capSq = (myColor == WHITE) ? (move.to - 8) : (move.to + 8);
+		if (move.isEnPassant()) {
+			int capSq = (myColor == WHITE) ? (move.to() - 8) : (move.to() + 8);
 			uint64_t capMask = 1ULL << capSq;
 			tempBoards[startOpp] &= ~capMask; // Opponent Pawns
 			tempBoards[OCCUPANCY] &= ~capMask;
@@ -316,8 +832,8 @@ void GameState::filterOutIllegalMoves(std::vector<BitMove>& moves) {
 		}
 
 		// Handle Promotion
-		if ((move.flags & IsPromotion)) {
-			moverIdx = getPieceIdx(Queen, myColor); // Assume Queen promotion for check safety (mostly covers it)
+		if (move.isPromotion()) {
+			moverIdx = getPieceIdx(move.promotion(), myColor);
 		}
 
 		// Add to 'to'
@@ -326,8 +842,8 @@ void GameState::filterOutIllegalMoves(std::vector<BitMove>& moves) {
 
 		// Handle King Move (Update King Index tracking)
 		int currentKingSquare = -1;
-		if (move.piece == King) {
-			currentKingSquare = move.to;
+		if (mover == King) {
+			currentKingSquare = move.to();
 		} else {
 			// If king didn't move, find him
 			currentKingSquare = tempBoards[myKingIdx].firstBit();
@@ -339,11 +855,8 @@ void GameState::filterOutIllegalMoves(std::vector<BitMove>& moves) {
 	}), moves.end());
 }
 
-std::vector<BitMove> GameState::generateAllMoves()
+void GameState::buildBitboards()
 {
-    std::vector<BitMove> moves;
-    moves.reserve(32);
-
     for (int i=0; i<e_numBitboards; i++) {
         _bitboards[i] = 0;
     }
@@ -360,8 +873,30 @@ std::vector<BitMove> GameState::generateAllMoves()
     _bitboards[BLACK_ALL_PIECES] = _bitboards[BLACK_PAWNS].getData() | _bitboards[BLACK_KNIGHTS].getData() |
     _bitboards[BLACK_BISHOPS].getData() | _bitboards[BLACK_ROOKS].getData() |
     _bitboards[BLACK_QUEENS].getData() | _bitboards[BLACK_KING].getData();
-    
+
     _bitboards[OCCUPANCY] = _bitboards[WHITE_ALL_PIECES].getData() | _bitboards[BLACK_ALL_PIECES].getData();
+    _bitboardsCurrent = true;
+}
+
+bool GameState::isInCheck()
+{
+    buildBitboards();
+    int kingSquare = _bitboards[color == WHITE ? WHITE_KING : BLACK_KING].firstBit();
+    return kingSquare >= 0 && isSquareAttacked(kingSquare, color == WHITE ? BLACK : WHITE, _bitboards);
+}
+
+std::vector<BitMove> GameState::generateAllMoves()
+{
+    std::vector<BitMove> moves;
+    moves.reserve(48);
+    generateAllMoves(moves);
+    return moves;
+}
+
+void GameState::generateAllMoves(std::vector<BitMove>& moves)
+{
+    moves.clear();
+    buildBitboards();
 
     int bitIndex = color == WHITE ? WHITE_PAWNS : BLACK_PAWNS;
     int oppBitIndex = color == WHITE ? BLACK_PAWNS : WHITE_PAWNS;
@@ -369,12 +904,10 @@ std::vector<BitMove> GameState::generateAllMoves()
     generateKnightMoves(moves, _bitboards[WHITE_KNIGHTS + bitIndex], ~_bitboards[WHITE_ALL_PIECES + bitIndex].getData());
     generatePawnMoveList(moves, _bitboards[WHITE_PAWNS  + bitIndex], ~_bitboards[OCCUPANCY].getData(), _bitboards[WHITE_ALL_PIECES + oppBitIndex].getData(), color);
     generateKingMoves(moves, _bitboards[WHITE_KING + bitIndex], ~_bitboards[WHITE_ALL_PIECES + bitIndex].getData());
+    generateCastlingMoves(moves);
     generateBishopMoves(moves, _bitboards[WHITE_BISHOPS + bitIndex], _bitboards[OCCUPANCY].getData(), _bitboards[WHITE_ALL_PIECES + bitIndex].getData());
     generateRooksMoves(moves, _bitboards[WHITE_ROOKS + bitIndex], _bitboards[OCCUPANCY].getData(), _bitboards[WHITE_ALL_PIECES + bitIndex].getData());
     generateQueensMoves(moves, _bitboards[WHITE_QUEENS + bitIndex], _bitboards[OCCUPANCY].getData(), _bitboards[WHITE_ALL_PIECES + bitIndex].getData());
 
     filterOutIllegalMoves(moves);
-
-    return moves;
 }
-
@@ -4,18 +4,24 @@
 #include <iostream>
 #include <cstring>
 #include <cstdint>
+#include <string>
+#include <string_view>
 #include <vector>
 #include "Bitboard.h"
 
 constexpr int WHITE = +1;
 constexpr int BLACK = -1;
-// Define a constant for the maximum depth of your AI.
-constexpr int MAX_DEPTH = 24;
 // Define constants for ranks and files
 constexpr uint64_t NotAFile(0xFEFEFEFEFEFEFEFEULL); // A file mask
 constexpr uint64_t NotHFile(0x7F7F7F7F7F7F7F7FULL); // H file mask
 constexpr uint64_t Rank3(0x0000000000FF0000ULL); // Rank 3 mask
 constexpr uint64_t Rank6(0x0000FF0000000000ULL); // Rank 6 mask
+constexpr uint64_t Rank1(0x00000000000000FFULL); // Rank 1 mask
+constexpr uint64_t Rank8(0xFF00000000000000ULL); // Rank 8 mask
+// square index used when there is no en passant target
+constexpr int NoSquare = -1;
+// the standard start position, the first four FEN fields
+constexpr const char* StartFEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq -";
 
 enum AllBitBoards
 {
@@ -38,104 +44,158 @@ enum AllBitBoards
     e_numBitboards
 };
 
-enum MoveFlags {
-    EnPassant = 0x01, // 0000 0001
-    IsCapture = 0x02, // 0000 0010
-    KingSideCastle = 0x04, // 0000 0100
-    QueenSideCastle = 0x08, // 0000 1000
-    IsPromotion = 0x10 // 0001 0000
+// special move kinds stored in the top two bits of a BitMove
+enum MoveType {
+    NormalMove = 0,
+    PromotionMove = 1,
+    EnPassantMove = 2,
+    CastlingMove = 3
 };
 
-#pragma pack(push, 1)
+enum CastlingRights {
+    WhiteKingSide = 0x01,
+    WhiteQueenSide = 0x02,
+    BlackKingSide = 0x04,
+    BlackQueenSide = 0x08
+};
+
+// 16 bit move: from in bits 0-5, to in bits 6-11, promotion piece (knight..queen) in 12-13, MoveType in 14-15
+// the moving piece and any capture are read from the board the move is played on
 struct BitMove {
-    unsigned char from;
-    unsigned char to;
-    unsigned char piece;
-    unsigned char flags;
-
-    BitMove(int from, int to, ChessPiece piece, int flags = 0)
-        : from(from), to(to), piece(piece), flags(flags) { }
-        
-    BitMove() : from(0), to(0), piece(NoPiece), flags(0) { }
-    
-    bool operator==(const BitMove& other) const {
-        return from == other.from && 
-               to == other.to && 
-               piece == other.piece &&
-               flags == other.flags;
-    }
+    uint16_t data;
+
+    BitMove(int from, int to, int type = NormalMove, ChessPiece promotion = Knight)
+        : data(static_cast<uint16_t>(from | (to << 6) | ((promotion - Knight) << 12) | (type << 14))) { }
+
+    BitMove() : data(0) { }
+
+    int from() const { return data & 63; }
+    int to() const { return (data >> 6) & 63; }
+    int type() const { return data >> 14; }
+    ChessPiece promotion() const { return static_cast<ChessPiece>(Knight + ((data >> 12) & 3)); }
+    bool isPromotion() const { return type() == PromotionMove; }
+    bool isEnPassant() const { return type() == EnPassantMove; }
+    bool isCastling() const { return type() == CastlingMove; }
+
+    bool operator==(const BitMove& other) const { return data == other.data; }
+    // a1a1 can never be a real move
+    bool isNull() const { return data == 0; }
 };
-#pragma pack(pop)
+static_assert(sizeof(BitMove) == 2, "BitMove must stay 16 bits");
 
 struct alignas(32) GameStateData {
     char state[64];                 // persisitent
     int flags;
     char color;                     // BLACK or WHITE
+    unsigned char castling;         // CastlingRights still available
+    signed char enPassant;          // square a pawn can capture onto, or NoSquare
+    int halfmoveClock;              // plies since the last capture or pawn move, not part of the hash
+    uint64_t hash;                  // zobrist key of everything above
 
     GameStateData() : flags(0)
-        , color(WHITE) {
+        , color(WHITE)
+        , castling(0)
+        , enPassant(NoSquare)
+        , halfmoveClock(0)
+        , hash(0) {
         std::memset(state, '0', sizeof(state));
     }
     GameStateData(const GameStateData&) = default;
     GameStateData& operator=(const GameStateData&) = default;
 };
 
+// what pushMove overwrote, everything else is recomputed from the move itself
+struct UndoRecord {
+    BitMove move;
+    char captured;                  // piece that stood on move.to, '0' for quiet moves and en passant
+    unsigned char castling;
+    signed char enPassant;
+    int flags;
+    int halfmoveClock;
+    uint64_t hash;
+};
+
 class GameState : public GameStateData {
 public:
-    GameStateData stateStack[MAX_DEPTH];
-    int stackPtr = 0;
+    // grows as deep as the search goes, each thread searches its own copy
+    std::vector<UndoRecord> _undoStack;
+    // keys of the positions before this one, game moves included, back to the last irreversible move
+    std::vector<uint64_t> _hashHistory;
 
-    uint64_t _zobristHash[2]; // when one hash value is made, the other is made as well because it's just a xor of the first by the color bit
     BitBoard _bitboards[e_numBitboards];
     BitBoard _attackBitBoard;
+    bool _bitboardsCurrent = false;   // _bitboards match state, cleared by every push and pop
 
-    GameState() : stackPtr(0) { }
+    GameState() { _undoStack.reserve(128); }
 
     void init(const char* newState, char player);
-
-    inline void pushMove(const BitMove& move) {
-        pushState();
-        unsigned char fromPiece = state[move.from];
-        state[move.from] = '0';
-        state[move.to] = fromPiece;
-        if (move.flags & KingSideCastle) {
-            state[move.to - 1] = state[move.to + 1];
-            state[move.to + 1] = '0';
-        } else if (move.flags & QueenSideCastle) {
-            state[move.to + 1] = state[move.to - 2];
-            state[move.to - 2] = '0';
-        } else if (move.flags & EnPassant) {
-            // check for color to determine which direction to capture
-            if (fromPiece == 'P') {
-                state[move.to - 8] = '0';
-            } else {
-                state[move.to + 8] = '0';
-            }
-        } else if (move.flags & IsPromotion) {
-            state[move.to] = color == WHITE ? 'Q' : 'q';
-        }
-        // flip the color bit as it now becomes the other player's turn
-        color = (color == WHITE) ? BLACK : WHITE;
-        flags = 0; // invalidate all the flags
-    }
-
-    inline void pushState() {
-        assert(stackPtr < MAX_DEPTH);
-        stateStack[stackPtr++] = static_cast<const GameStateData&>(*this);
-    }
-    inline void popState() {
-        assert(stackPtr > 0);
-        static_cast<GameStateData&>(*this) = stateStack[--stackPtr];
+    // accepts the first four FEN fields, the halfmove clock is read when present
+    bool initFromFEN(const std::string& fen);
+    std::string toFEN() const;
+
+    void pushMove(const BitMove& move);
+    // takes back the last pushMove
+    void popMove();
+    // plays a move at the root of a game, nothing is kept on the undo stack
+    // but the position is remembered for repetitions until a capture or pawn move makes that impossible
+    inline void playMove(const BitMove& move) {
+        pushMove(move);
+        _undoStack.clear();
+        if (halfmoveClock == 0) _hashHistory.clear();
     }
 
     std::vector<BitMove> generateAllMoves();
+    // same moves in the same order into a caller's list, so loops over many positions keep one allocation
+    void generateAllMoves(std::vector<BitMove>& moves);
+    bool isInCheck();
+    bool hasInsufficientMaterial() const;
+    // the current position already occurred with the same side to move
+    bool isRepetition() const;
+    // how many times the current position occurred before, 2 means this is the third time
+    int repetitionCount() const;
+    bool isFiftyMoveDraw() const { return halfmoveClock >= 100; }
+    uint64_t computeHash() const;
+    // hash without the en passant file, for tables keyed by where the pieces stand like the ECO lines
+    uint64_t hashWithoutEnPassant() const;
+    // hash with the en passant file only when a pawn stands ready to take en passant, for position lookups:
+    // a FEN written with "-" and move order transpositions then find the same key
+    uint64_t positionKey() const;
+
+    ChessPiece movedPiece(const BitMove& move) const { return pieceAt(move.from()); }
+    ChessPiece pieceAt(int square) const;
+    bool isCapture(const BitMove& move) const { return state[move.to()] != '0' || move.isEnPassant(); }
+    // captures and promotions, the moves quiescence search looks at
+    bool isTactical(const BitMove& move) const { return isCapture(move) || move.isPromotion(); }
+
+    // static exchange evaluation: material the side to move wins or loses on move.to()
+    // if both sides keep recapturing with their least valuable attacker
+    int see(const BitMove& move);
+
+    // material and piece square balance from the side to move's point of view, constants from EvalParams.h
+    int evaluate() const;
+
+    static uint64_t generatePawnAttacksBitBoard(int square, char color);
+    static std::string moveToUCI(const BitMove& move);
+    // returns a null move when the text does not match a legal move
+    BitMove parseUCIMove(const std::string& text);
+    // standard algebraic notation as PGN writes it, check marks and annotations are ignored
+    // returns a null move when the text is not exactly one legal move
+    // moveIndex receives the move's position in generateAllMoves() order, the game database's encoding
+    BitMove parseSANMove(std::string_view text, int* moveIndex = nullptr);
+    // writes move as SAN without the check mark into out, which needs room for 7 characters, and returns the length
+    // legal is generateAllMoves() of this position, used to add the file or rank when two pieces can reach the square
+    int writeSAN(const BitMove& move, const std::vector<BitMove>& legal, char* out) const;
+
     void shutdown();
 private:
+    void buildBitboards();
+    void updateCastlingRights(int square);
+
     const BitBoard generatePawnAttacks(const BitBoard pawns, char color);
-    uint64_t generatePawnAttacksBitBoard(int square, char color);
-    
+
     void generateKnightMoves(std::vector<BitMove>& moves, BitBoard knightBoard, uint64_t occupancy);
     void generateKingMoves(std::vector<BitMove>& moves, BitBoard kingBoard, uint64_t occupancy);
+    void generateCastlingMoves(std::vector<BitMove>& moves);
     void generateRooksMoves(std::vector<BitMove>& moves, BitBoard bishopBoard, uint64_t occupancy, uint64_t friendlies);
     void generateQueensMoves(std::vector<BitMove>& moves, BitBoard bishopBoard, uint64_t occupancy, uint64_t friendlies);
 
@@ -143,6 +203,7 @@ private:
     void generatePawnMoveList(std::vector<BitMove>& moves, const BitBoard pawns, const BitBoard emptySquares, const BitBoard enemyPieces, char color);
     void addPawnBitboardMovesToList(std::vector<BitMove>& moves, const BitBoard bitboard, const int shift);
     bool isSquareAttacked(int square, char attackerColor, const BitBoard (&boards)[e_numBitboards]);
+    uint64_t attackersTo(int square, uint64_t occupancy) const;
     void filterOutIllegalMoves(std::vector<BitMove>& moves);
 
 };
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+
+// how the mapped bytes are about to be read, a hint for the kernel's read ahead
+enum MappedAccess {
+    AccessNormal,
+    AccessSequential,
+    AccessRandom
+};
+
+//
+// a whole file mapped read only, the bytes stay valid until close()
+// data files are read through this rather than loaded so they can be far larger than memory
+//
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // fails on missing and empty files
+    bool open(const std::string& path);
+    void close();
+
+    bool isOpen() const { return _data != nullptr; }
+    const char* data() const { return _data; }
+    size_t size() const { return _size; }
+    std::string_view text() const { return { _data, _size }; }
+
+    void advise(MappedAccess access) const;
+
+private:
+    const char* _data;
+    size_t _size;
+#ifdef _WIN32
+    void* _fileHandle;
+    void* _mappingHandle;
+#endif
+};
+
+// moves to an absolute offset of a file being written, offsets may be past 2GB where plain fseek stops on Windows
+bool seekFile(FILE* file, uint64_t offset);
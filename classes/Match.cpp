@@ -0,0 +1,267 @@
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <thread>
+#include "Match.h"
+
+double MatchStats::score() const
+{
+    return games() ? (wins + 0.5 * draws) / games() : 0.5;
+}
+
+static double scoreToElo(double score)
+{
+    score = std::clamp(score, 1e-6, 1.0 - 1e-6);
+    return -400.0 * std::log10(1.0 / score - 1.0);
+}
+
+static double eloToScore(double elo)
+{
+    return 1.0 / (1.0 + std::pow(10.0, -elo / 400.0));
+}
+
+// per game variance of the score
+static double scoreVariance(const MatchStats& stats)
+{
+    const double s = stats.score();
+    const int n = stats.games();
+    if (!n) return 0.0;
+    return (stats.wins * (1.0 - s) * (1.0 - s) + stats.draws * (0.5 - s) * (0.5 - s) + stats.losses * s * s) / n;
+}
+
+double MatchStats::elo() const
+{
+    return scoreToElo(score());
+}
+
+double MatchStats::eloError() const
+{
+    if (!games()) return 0.0;
+    double margin = 1.96 * std::sqrt(scoreVariance(*this) / games());
+    return (scoreToElo(score() + margin) - scoreToElo(score() - margin)) / 2.0;
+}
+
+// normal approximation of the generalised SPRT log likelihood ratio
+double MatchStats::llr(double elo0, double elo1) const
+{
+    const double variance = scoreVariance(*this);
+    if (variance <= 0.0) return 0.0;
+    const double s0 = eloToScore(elo0);
+    const double s1 = eloToScore(elo1);
+    return games() * (s1 - s0) * (2.0 * score() - s0 - s1) / (2.0 * variance);
+}
+
+Match::Match(const MatchOptions& options, const EngineConfig& first, const EngineConfig& second)
+    : _options(options)
+    , _nextGame(0)
+    , _finished(false)
+    , _log(&std::cout)
+{
+    _engines[0] = first;
+    _engines[1] = second;
+    _options.threads = std::max(1, _options.threads);
+}
+
+bool Match::loadOpenings(const std::string& path, std::vector<std::string>& openings)
+{
+    std::ifstream file(path);
+    if (!file) return false;
+
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        std::istringstream fields(line);
+        std::string board, side, castling, ep;
+        fields >> board >> side >> castling >> ep;
+        if (ep.empty()) continue;
+        GameState check;
+        if (check.initFromFEN(board + " " + side + " " + castling + " " + ep)) {
+            openings.push_back(check.toFEN());
+        }
+    }
+    return !openings.empty();
+}
+
+void Match::openingFor(const std::vector<std::string>& book, uint64_t seed, uint64_t index, int randomPlies, GameState& position)
+{
+    if (!book.empty()) {
+        position.initFromFEN(book[index % book.size()]);
+        return;
+    }
+
+    std::mt19937_64 random(seed * 0x9E3779B97F4A7C15ULL + index);
+    for (;;) {
+        position.initFromFEN(StartFEN);
+        bool ok = true;
+        for (int ply = 0; ply < randomPlies && ok; ply++) {
+            auto moves = position.generateAllMoves();
+            ok = !moves.empty();
+            if (ok) position.playMove(moves[random() % moves.size()]);
+        }
+        if (ok && !position.generateAllMoves().empty()) return;
+    }
+}
+
+GameRecord Match::playGame(const std::string& openingFEN, Search& white, const EngineConfig& whiteConfig,
+                           Search& black, const EngineConfig& blackConfig)
+{
+    GameRecord record;
+    GameState position;
+    position.initFromFEN(openingFEN);
+    white.clear();
+    black.clear();
+
+    int drawPlies = 0;
+    int resignPlies = 0;
+    int resignSide = 0;
+    for (int ply = 0; ; ply++) {
+        record.plies = ply;
+        if (position.generateAllMoves().empty()) {
+            if (position.isInCheck()) {
+                record.result = position.color == WHITE ? -1 : 1;
+                record.reason = "checkmate";
+            } else {
+                record.reason = "stalemate";
+            }
+            return record;
+        }
+        if (position.hasInsufficientMaterial()) {
+            record.reason = "insufficient material";
+            return record;
+        }
+        if (position.repetitionCount() >= 2) {
+            record.reason = "threefold repetition";
+            return record;
+        }
+        if (position.isFiftyMoveDraw()) {
+            record.reason = "fifty move rule";
+            return record;
+        }
+        if (ply >= _options.maxPlies) {
+            record.reason = "max plies";
+            return record;
+        }
+
+        const bool whiteToMove = position.color == WHITE;
+        Search& engine = whiteToMove ? white : black;
+        const EngineConfig& config = whiteToMove ? whiteConfig : blackConfig;
+        SearchResult result = engine.think(position, config.limits);
+        const int whiteScore = whiteToMove ? result.score : -result.score;
+
+        // both engines have to agree for several moves before a game is cut short
+        if (std::abs(whiteScore) >= _options.resignScore) {
+            int side = whiteScore > 0 ? 1 : -1;
+            resignPlies = (side == resignSide) ? resignPlies + 1 : 1;
+            resignSide = side;
+        } else {
+            resignPlies = 0;
+        }
+        if (resignPlies >= _options.resignPlyCount) {
+            record.result = resignSide;
+            record.reason = "adjudicated win";
+            return record;
+        }
+
+        bool drawish = ply >= _options.drawMoveNumber * 2 && std::abs(whiteScore) <= _options.drawScore;
+        drawPlies = drawish ? drawPlies + 1 : 0;
+        if (drawPlies >= _options.drawPlyCount) {
+            record.reason = "adjudicated draw";
+            return record;
+        }
+
+        position.playMove(result.bestMove);
+    }
+}
+
+void Match::recordGame(int gameIndex, bool firstIsWhite, const GameRecord& record)
+{
+    std::lock_guard<std::mutex> lock(_statsMutex);
+    const int firstResult = firstIsWhite ? record.result : -record.result;
+    if (firstResult > 0) {
+        _stats.wins++;
+    } else if (firstResult < 0) {
+        _stats.losses++;
+    } else {
+        _stats.draws++;
+    }
+
+    std::ostream& log = *_log;
+    log << std::fixed << std::setprecision(1)
+        << "game " << gameIndex + 1 << " (" << (firstIsWhite ? _engines[0].name : _engines[1].name)
+        << " white) " << (record.result > 0 ? "1-0" : record.result < 0 ? "0-1" : "1/2-1/2")
+        << " " << record.reason << " after " << record.plies << " plies"
+        << " | +" << _stats.wins << " =" << _stats.draws << " -" << _stats.losses
+        << " elo " << _stats.elo() << " +/- " << _stats.eloError();
+
+    if (_options.sprt) {
+        const double llr = _stats.llr(_options.elo0, _options.elo1);
+        const double lower = std::log(_options.beta / (1.0 - _options.alpha));
+        const double upper = std::log((1.0 - _options.beta) / _options.alpha);
+        log << std::setprecision(2) << " llr " << llr << " [" << lower << ", " << upper << "]";
+        if (llr >= upper || llr <= lower) {
+            _finished = true;
+        }
+    }
+    log << std::endl;
+}
+
+void Match::worker()
+{
+    Search first(_engines[0].hashMegabytes);
+    Search second(_engines[1].hashMegabytes);
+    first.setParams(_engines[0].params);
+    second.setParams(_engines[1].params);
+
+    while (!_finished) {
+        const int gameIndex = _nextGame++;
+        if (gameIndex >= _options.games) break;
+
+        // each opening is played twice with colours reversed, without a book every pair gets its own random walk
+        const bool firstIsWhite = (gameIndex % 2) == 0;
+        GameState openingPosition;
+        openingFor(_openings, _options.seed, gameIndex / 2, _options.randomPlies, openingPosition);
+        const std::string opening = openingPosition.toFEN();
+        GameRecord record = firstIsWhite
+            ? playGame(opening, first, _engines[0], second, _engines[1])
+            : playGame(opening, second, _engines[1], first, _engines[0]);
+        recordGame(gameIndex, firstIsWhite, record);
+    }
+}
+
+MatchStats Match::run(std::ostream& log)
+{
+    _log = &log;
+    _stats = MatchStats();
+    _nextGame = 0;
+    _finished = false;
+
+    if (!_options.bookPath.empty() && !loadOpenings(_options.bookPath, _openings)) {
+        log << "could not read any openings from " << _options.bookPath << ", using random openings" << std::endl;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int i = 0; i < _options.threads; i++) {
+        workers.emplace_back(&Match::worker, this);
+    }
+    for (auto& thread : workers) {
+        thread.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    log << std::fixed << std::setprecision(1)
+        << _engines[0].name << " vs " << _engines[1].name << ": " << _stats.games() << " games in "
+        << seconds << "s, +" << _stats.wins << " =" << _stats.draws << " -" << _stats.losses
+        << ", elo " << _stats.elo() << " +/- " << _stats.eloError() << std::endl;
+    if (_options.sprt) {
+        const double llr = _stats.llr(_options.elo0, _options.elo1);
+        const double upper = std::log((1.0 - _options.beta) / _options.alpha);
+        const double lower = std::log(_options.beta / (1.0 - _options.alpha));
+        log << "SPRT elo0=" << _options.elo0 << " elo1=" << _options.elo1 << ": "
+            << (llr >= upper ? "H1 accepted" : llr <= lower ? "H0 accepted" : "inconclusive") << std::endl;
+    }
+    return _stats;
+}
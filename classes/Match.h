@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "Search.h"
+
+// one side of an engine-vs-engine match
+struct EngineConfig {
+    std::string name;
+    SearchLimits limits;
+    size_t hashMegabytes = 16;
+    SearchParams params;
+};
+
+struct MatchOptions {
+    int games = 1000;               // upper bound, the SPRT usually decides earlier
+    int threads = 1;                // concurrent games, one per worker thread
+    std::string bookPath;           // EPD/FEN file, one opening per line
+    int randomPlies = 8;            // random opening length when there is no book
+    uint64_t seed = 1;
+    int maxPlies = 400;             // games that get this long are scored as draws
+
+    // adjudication, scores are in centipawns from white's point of view
+    int drawMoveNumber = 40;        // no draw adjudication before this full move
+    int drawScore = 10;
+    int drawPlyCount = 16;          // consecutive plies inside +/- drawScore
+    int resignScore = 600;
+    int resignPlyCount = 8;         // consecutive plies beyond resignScore for the same side
+
+    // sequential probability ratio test on engine one vs engine two
+    bool sprt = true;
+    double elo0 = 0.0;
+    double elo1 = 5.0;
+    double alpha = 0.05;
+    double beta = 0.05;
+};
+
+struct GameRecord {
+    int result = 0;                 // +1 white won, -1 black won, 0 draw
+    std::string reason;
+    int plies = 0;
+};
+
+// wins/draws/losses from engine one's point of view
+struct MatchStats {
+    int wins = 0;
+    int draws = 0;
+    int losses = 0;
+
+    int games() const { return wins + draws + losses; }
+    double score() const;
+    double elo() const;
+    // half width of the 95% confidence interval
+    double eloError() const;
+    double llr(double elo0, double elo1) const;
+};
+
+class Match
+{
+public:
+    Match(const MatchOptions& options, const EngineConfig& first, const EngineConfig& second);
+
+    // plays until the game limit or an SPRT decision, progress goes to log
+    MatchStats run(std::ostream& log);
+
+    // reads the position part of each EPD/FEN line, blank lines and # comments are skipped
+    static bool loadOpenings(const std::string& path, std::vector<std::string>& openings);
+    // sets position to book[index] when there is a book, otherwise to a random walk of randomPlies from the start
+    // seeded by seed and index, so the same index always gets the same opening
+    static void openingFor(const std::vector<std::string>& book, uint64_t seed, uint64_t index, int randomPlies, GameState& position);
+
+private:
+    void worker();
+    GameRecord playGame(const std::string& openingFEN, Search& white, const EngineConfig& whiteConfig,
+                        Search& black, const EngineConfig& blackConfig);
+    void recordGame(int gameIndex, bool firstIsWhite, const GameRecord& record);
+
+    MatchOptions _options;
+    EngineConfig _engines[2];
+    std::vector<std::string> _openings;
+
+    std::atomic<int> _nextGame;
+    std::atomic<bool> _finished;
+    std::mutex _statsMutex;
+    MatchStats _stats;
+    std::ostream* _log;
+};
@@ -0,0 +1,436 @@
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <mutex>
+#include <thread>
+#include "MaterialIndex.h"
+
+// GCC and clang compile the AVX2 kernels for any x86-64 target and pick them at run time,
+// other compilers only when the whole build targets AVX2
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define MATERIAL_AVX2 1
+#define AVX2_TARGET __attribute__((target("avx2")))
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#define MATERIAL_AVX2 1
+#define AVX2_TARGET
+#endif
+
+static const char MaterialMagic[8] = "CBMATER";
+// records a scan thread takes from the shared counter at a time, a multiple of the 8 record blocks
+static const uint64_t ScanChunk = 1 << 16;
+
+// bit offset and width of each piece count inside one side's 12 signature bits
+static const int FieldShift[6] = { 0, 0, 4, 6, 8, 10 };
+static const int FieldBits[6] = { 0, 4, 2, 2, 2, 2 };
+
+uint32_t materialSignature(const GameState& position, int ply)
+{
+    int counts[2][7] = {};
+    for (int square = 0; square < 64; square++) {
+        const char piece = position.state[square];
+        if (piece == '0') continue;
+        counts[piece >= 'a'][position.pieceAt(square)]++;
+    }
+    uint32_t signature = uint32_t(std::min(ply, 255)) << 24;
+    for (int side = 0; side < 2; side++) {
+        for (int piece = Pawn; piece < King; piece++) {
+            const int limit = (1 << FieldBits[piece]) - 1;
+            signature |= uint32_t(std::min(counts[side][piece], limit)) << (side * 12 + FieldShift[piece]);
+        }
+    }
+    return signature;
+}
+
+static int pieceFromLetter(char letter)
+{
+    switch (std::toupper(static_cast<unsigned char>(letter))) {
+        case 'P': return Pawn;
+        case 'N': return Knight;
+        case 'B': return Bishop;
+        case 'R': return Rook;
+        case 'Q': return Queen;
+        case 'K': return King;
+        default: return NoPiece;
+    }
+}
+
+bool MaterialQuery::setMaterial(std::string_view spec)
+{
+    const size_t split = spec.find('v');
+    if (split == std::string_view::npos) return false;
+    signatureMask = 0;
+    signatureValue = 0;
+    for (int side = 0; side < 2; side++) {
+        const std::string_view text = side == 0 ? spec.substr(0, split) : spec.substr(split + 1);
+        int counts[7] = {};
+        bool any[7] = {};
+        for (size_t i = 0; i < text.size(); i++) {
+            const int piece = pieceFromLetter(text[i]);
+            if (piece == NoPiece) return false;
+            if (i + 1 < text.size() && text[i + 1] == '*') {
+                any[piece] = true;
+                i++;
+            } else {
+                counts[piece]++;
+            }
+        }
+        for (int piece = Pawn; piece < King; piece++) {
+            if (any[piece]) continue;
+            const int shift = side * 12 + FieldShift[piece];
+            const uint32_t field = (1u << FieldBits[piece]) - 1;
+            signatureMask |= field << shift;
+            signatureValue |= uint32_t(std::min<uint32_t>(counts[piece], field)) << shift;
+        }
+    }
+    return true;
+}
+
+bool MaterialQuery::setPattern(std::string_view spec)
+{
+    while (!spec.empty()) {
+        const size_t end = std::min(spec.find(','), spec.size());
+        const std::string_view item = spec.substr(0, end);
+        spec.remove_prefix(std::min(end + 1, spec.size()));
+        if (item.size() != 3) return false;
+        const int piece = pieceFromLetter(item[0]);
+        const int file = item[1] - 'a';
+        const int rank = item[2] - '1';
+        if (piece == NoPiece || file < 0 || file > 7 || rank < 0 || rank > 7) return false;
+        required[std::islower(static_cast<unsigned char>(item[0])) ? 1 : 0][piece - Pawn] |= 1ULL << (rank * 8 + file);
+    }
+    return true;
+}
+
+bool MaterialQuery::hasPattern() const
+{
+    for (const auto& side : required) {
+        for (uint64_t squares : side) {
+            if (squares) return true;
+        }
+    }
+    return false;
+}
+
+MaterialIndexBuilder::MaterialIndexBuilder(int threads)
+    : _threads(std::max(1, threads))
+{
+}
+
+static uint64_t align32(uint64_t offset)
+{
+    return (offset + 31) & ~uint64_t(31);
+}
+
+bool MaterialIndexBuilder::build(const GameDatabase& database, std::ostream& log)
+{
+    auto start = std::chrono::steady_clock::now();
+    const uint64_t games = database.size();
+
+    // every game takes its plies + 1 records, so every batch knows where it writes before replaying
+    std::vector<uint64_t> gameStarts(games + 1);
+    for (uint64_t id = 0; id < games; id++) {
+        gameStarts[id + 1] = gameStarts[id] + database.game(id).plies + 1;
+    }
+    MaterialFileHeader header = {};
+    std::memcpy(header.magic, MaterialMagic, sizeof(header.magic));
+    header.version = MaterialIndexVersion;
+    header.gameCount = games;
+    header.recordCount = gameStarts[games];
+    header.gameStarts = align32(sizeof(MaterialFileHeader));
+    header.signatures = align32(header.gameStarts + gameStarts.size() * sizeof(uint64_t));
+    uint64_t offset = align32(header.signatures + header.recordCount * sizeof(uint32_t));
+    for (int board = 0; board < MaterialBoardCount; board++) {
+        header.boards[board] = offset;
+        offset = align32(offset + header.recordCount * sizeof(uint64_t));
+    }
+
+    const std::string path = database.basePath() + ".material";
+    FILE* file = std::fopen(path.c_str(), "wb");
+    bool ok = file
+        && std::fwrite(&header, sizeof(header), 1, file) == 1
+        && seekFile(file, header.gameStarts)
+        && std::fwrite(gameStarts.data(), sizeof(uint64_t), gameStarts.size(), file) == gameStarts.size();
+    std::atomic<bool> failed(!ok);
+    std::mutex fileMutex;
+    auto writeAt = [&](uint64_t at, const void* data, size_t bytes) {
+        if (!seekFile(file, at) || std::fwrite(data, 1, bytes, file) != bytes) failed = true;
+    };
+
+    std::atomic<uint64_t> nextGame(0);
+    std::vector<std::thread> workers;
+    for (int i = 0; i < _threads && !failed; i++) {
+        workers.emplace_back([&]() {
+            GameState position;
+            std::vector<BitMove> legal;
+            std::vector<uint32_t> signatures;
+            std::vector<uint64_t> boards[MaterialBoardCount];
+            for (uint64_t first = nextGame.fetch_add(GameBatch); first < games && !failed; first = nextGame.fetch_add(GameBatch)) {
+                const uint64_t last = std::min(games, first + GameBatch);
+                signatures.clear();
+                for (auto& column : boards) {
+                    column.clear();
+                }
+                for (uint64_t id = first; id < last; id++) {
+                    const size_t gameStart = signatures.size();
+                    database.replay(id, position, legal, [&](int ply, const GameState& reached, const BitMove&) {
+                        uint64_t pieces[MaterialBoardCount] = {};
+                        for (int square = 0; square < 64; square++) {
+                            const char piece = reached.state[square];
+                            if (piece == '0') continue;
+                            pieces[reached.pieceAt(square) - Pawn] |= 1ULL << square;
+                            if (piece < 'a') pieces[BoardWhite] |= 1ULL << square;
+                        }
+                        signatures.push_back(materialSignature(reached, ply));
+                        for (int board = 0; board < MaterialBoardCount; board++) {
+                            boards[board].push_back(pieces[board]);
+                        }
+                        return true;
+                    });
+                    // a game that stops decoding repeats its last good position to keep its record count,
+                    // one that can't be started gets empty records
+                    const size_t records = gameStarts[id + 1] - gameStarts[id];
+                    const bool started = signatures.size() > gameStart;
+                    while (signatures.size() - gameStart < records) {
+                        const int ply = int(signatures.size() - gameStart);
+                        signatures.push_back(started ? materialSignature(position, ply) : 0);
+                        for (auto& column : boards) {
+                            column.push_back(started ? column.back() : 0);
+                        }
+                    }
+                }
+                const uint64_t record = gameStarts[first];
+                std::lock_guard<std::mutex> lock(fileMutex);
+                writeAt(header.signatures + record * sizeof(uint32_t), signatures.data(), signatures.size() * sizeof(uint32_t));
+                for (int board = 0; board < MaterialBoardCount; board++) {
+                    writeAt(header.boards[board] + record * sizeof(uint64_t), boards[board].data(), boards[board].size() * sizeof(uint64_t));
+                }
+            }
+        });
+    }
+    for (auto& thread : workers) {
+        thread.join();
+    }
+    if (file && std::fclose(file) != 0) failed = true;
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (!file || failed) {
+        log << "could not write " << path << std::endl;
+        return false;
+    }
+    log << std::fixed << std::setprecision(1) << "material index: " << header.recordCount << " positions from " << games
+        << " games, " << offset / 1e6 << " MB in " << seconds << "s" << std::endl;
+    return true;
+}
+
+MaterialIndex::MaterialIndex()
+    : _header(nullptr)
+    , _gameStarts(nullptr)
+    , _signatures(nullptr)
+    , _boards()
+{
+}
+
+bool MaterialIndex::open(const std::string& basePath)
+{
+    close();
+    if (!_file.open(basePath + ".material")) return false;
+    _header = reinterpret_cast<const MaterialFileHeader*>(_file.data());
+    const bool valid = _file.size() >= sizeof(MaterialFileHeader)
+        && std::memcmp(_header->magic, MaterialMagic, sizeof(MaterialMagic)) == 0
+        && _header->version == MaterialIndexVersion
+        && _header->boards[MaterialBoardCount - 1] + _header->recordCount * sizeof(uint64_t) <= _file.size();
+    if (!valid) {
+        close();
+        return false;
+    }
+    _gameStarts = reinterpret_cast<const uint64_t*>(_file.data() + _header->gameStarts);
+    _signatures = reinterpret_cast<const uint32_t*>(_file.data() + _header->signatures);
+    for (int board = 0; board < MaterialBoardCount; board++) {
+        _boards[board] = reinterpret_cast<const uint64_t*>(_file.data() + _header->boards[board]);
+    }
+    // scans run front to back over each column
+    _file.advise(AccessSequential);
+    return true;
+}
+
+void MaterialIndex::close()
+{
+    _file.close();
+    _header = nullptr;
+    _gameStarts = nullptr;
+    _signatures = nullptr;
+    std::fill(std::begin(_boards), std::end(_boards), nullptr);
+}
+
+bool MaterialIndex::hasAvx2()
+{
+#if defined(MATERIAL_AVX2) && defined(__AVX2__)
+    return true;
+#elif defined(MATERIAL_AVX2)
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+// the columns and requirements one scan reads
+struct ScanPlan {
+    const uint32_t* signatures;
+    const uint64_t* const* boards;
+    uint32_t mask;
+    uint32_t value;
+    uint32_t minPly;
+    uint32_t maxPly;
+    int patternCount;
+    int patternBoard[12];
+    bool patternWhite[12];
+    uint64_t patternSquares[12];
+    int patternColumns;             // distinct columns the pattern reads
+};
+
+static bool signaturePass(const ScanPlan& plan, uint64_t record)
+{
+    const uint32_t signature = plan.signatures[record];
+    const uint32_t ply = signature >> 24;
+    return (signature & plan.mask) == plan.value && ply >= plan.minPly && ply <= plan.maxPly;
+}
+
+static bool patternPass(const ScanPlan& plan, uint64_t record)
+{
+    for (int i = 0; i < plan.patternCount; i++) {
+        const uint64_t white = plan.boards[BoardWhite][record];
+        const uint64_t pieces = plan.boards[plan.patternBoard[i]][record] & (plan.patternWhite[i] ? white : ~white);
+        if ((pieces & plan.patternSquares[i]) != plan.patternSquares[i]) return false;
+    }
+    return true;
+}
+
+#ifdef MATERIAL_AVX2
+// one bit per record of the eight starting at record that pass the signature and ply tests
+AVX2_TARGET static uint32_t signatureBlockAvx2(const ScanPlan& plan, uint64_t record)
+{
+    const __m256i signatures = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(plan.signatures + record));
+    const __m256i material = _mm256_cmpeq_epi32(_mm256_and_si256(signatures, _mm256_set1_epi32(int(plan.mask))), _mm256_set1_epi32(int(plan.value)));
+    const __m256i ply = _mm256_srli_epi32(signatures, 24);
+    const __m256i above = _mm256_cmpeq_epi32(_mm256_max_epu32(ply, _mm256_set1_epi32(int(plan.minPly))), ply);
+    const __m256i below = _mm256_cmpeq_epi32(_mm256_min_epu32(ply, _mm256_set1_epi32(int(plan.maxPly))), ply);
+    const __m256i pass = _mm256_and_si256(material, _mm256_and_si256(above, below));
+    return uint32_t(_mm256_movemask_ps(_mm256_castsi256_ps(pass)));
+}
+
+// one bit per record of the four starting at record that have every pattern piece
+AVX2_TARGET static uint32_t patternQuadAvx2(const ScanPlan& plan, uint64_t record)
+{
+    const __m256i white = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(plan.boards[BoardWhite] + record));
+    __m256i pass = _mm256_set1_epi64x(-1);
+    for (int i = 0; i < plan.patternCount; i++) {
+        const __m256i board = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(plan.boards[plan.patternBoard[i]] + record));
+        const __m256i pieces = plan.patternWhite[i] ? _mm256_and_si256(board, white) : _mm256_andnot_si256(white, board);
+        const __m256i squares = _mm256_set1_epi64x(int64_t(plan.patternSquares[i]));
+        pass = _mm256_and_si256(pass, _mm256_cmpeq_epi64(_mm256_and_si256(pieces, squares), squares));
+    }
+    return uint32_t(_mm256_movemask_pd(_mm256_castsi256_pd(pass)));
+}
+#endif
+
+void MaterialIndex::scan(const MaterialQuery& query, int threads, std::vector<MaterialMatch>& matches, MaterialScanStats& stats, bool simd) const
+{
+    matches.clear();
+    stats = MaterialScanStats();
+    if (!_header) return;
+
+    ScanPlan plan = {};
+    plan.signatures = _signatures;
+    plan.boards = _boards;
+    plan.mask = query.signatureMask & 0x00FFFFFF;
+    plan.value = query.signatureValue & plan.mask;
+    plan.minPly = uint32_t(std::clamp(query.minPly, 0, 255));
+    plan.maxPly = uint32_t(std::clamp(query.maxPly, 0, 255));
+    bool columnUsed[MaterialBoardCount] = {};
+    for (int side = 0; side < 2; side++) {
+        for (int piece = 0; piece < 6; piece++) {
+            if (!query.required[side][piece]) continue;
+            plan.patternBoard[plan.patternCount] = piece;
+            plan.patternWhite[plan.patternCount] = side == 0;
+            plan.patternSquares[plan.patternCount] = query.required[side][piece];
+            plan.patternCount++;
+            columnUsed[piece] = columnUsed[BoardWhite] = true;
+        }
+    }
+    plan.patternColumns = int(std::count(std::begin(columnUsed), std::end(columnUsed), true));
+    stats.simd = simd && hasAvx2();
+    stats.records = _header->recordCount;
+
+    auto start = std::chrono::steady_clock::now();
+    std::atomic<uint64_t> nextRecord(0);
+    std::mutex mergeMutex;
+    std::vector<std::thread> workers;
+    for (int i = 0; i < std::max(1, threads); i++) {
+        workers.emplace_back([&]() {
+            std::vector<MaterialMatch> found;
+            uint64_t matched = 0;
+            uint64_t patternRecords = 0;
+            for (uint64_t first = nextRecord.fetch_add(ScanChunk); first < stats.records; first = nextRecord.fetch_add(ScanChunk)) {
+                const uint64_t last = std::min(stats.records, first + ScanChunk);
+                uint64_t game = std::upper_bound(_gameStarts, _gameStarts + _header->gameCount + 1, first) - _gameStarts - 1;
+                auto accept = [&](uint64_t record) {
+                    while (_gameStarts[game + 1] <= record) {
+                        game++;
+                    }
+                    matched++;
+                    if (found.empty() || found.back().game != game) {
+                        found.push_back({ uint32_t(game), uint16_t(record - _gameStarts[game]) });
+                    }
+                };
+                uint64_t record = first;
+#ifdef MATERIAL_AVX2
+                if (stats.simd) {
+                    for (; record + 8 <= last; record += 8) {
+                        uint32_t pass = signatureBlockAvx2(plan, record);
+                        if (!pass) continue;
+                        if (plan.patternCount) {
+                            pass &= patternQuadAvx2(plan, record) | (patternQuadAvx2(plan, record + 4) << 4);
+                            patternRecords += 8;
+                        }
+                        for (; pass; pass &= pass - 1) {
+                            accept(record + std::countr_zero(pass));
+                        }
+                    }
+                }
+#endif
+                for (; record < last; record++) {
+                    if (!signaturePass(plan, record)) continue;
+                    if (plan.patternCount) {
+                        patternRecords++;
+                        if (!patternPass(plan, record)) continue;
+                    }
+                    accept(record);
+                }
+            }
+            std::lock_guard<std::mutex> lock(mergeMutex);
+            matches.insert(matches.end(), found.begin(), found.end());
+            stats.matches += matched;
+            stats.bytes += patternRecords * sizeof(uint64_t) * plan.patternColumns;
+        });
+    }
+    for (auto& thread : workers) {
+        thread.join();
+    }
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    stats.bytes += stats.records * sizeof(uint32_t);
+
+    // a game split over two chunks may appear twice, keep its earliest ply
+    std::sort(matches.begin(), matches.end(), [](const MaterialMatch& a, const MaterialMatch& b) {
+        return a.game != b.game ? a.game < b.game : a.ply < b.ply;
+    });
+    matches.erase(std::unique(matches.begin(), matches.end(), [](const MaterialMatch& a, const MaterialMatch& b) {
+        return a.game == b.game;
+    }), matches.end());
+}
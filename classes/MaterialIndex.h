@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "GameDatabase.h"
+#include "MappedFile.h"
+
+//
+// base.material: one record per position of every game (ply 0 to the last move), stored column by column
+//   a MaterialFileHeader, gameCount + 1 uint64 record starts, the uint32 signature column, then one uint64
+//   column per MaterialBoard, every column 32 byte aligned so the scans can use whole vector loads
+// a signature holds each side's piece counts (pawns 4 bits, the others 2 bits and saturating at 3),
+// white in bits 0-11, black in bits 12-23, and the ply saturating at 255 in bits 24-31
+//
+
+constexpr uint32_t MaterialIndexVersion = 1;
+
+enum MaterialBoard {
+    BoardPawns,                     // both colours, BoardWhite tells them apart
+    BoardKnights,
+    BoardBishops,
+    BoardRooks,
+    BoardQueens,
+    BoardKings,
+    BoardWhite,
+    MaterialBoardCount
+};
+
+struct MaterialFileHeader {
+    char magic[8];                  // "CBMATER"
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t gameCount;
+    uint64_t recordCount;
+    uint64_t gameStarts;            // file offsets of the columns
+    uint64_t signatures;
+    uint64_t boards[MaterialBoardCount];
+};
+
+// the signature of a position, see base.material
+uint32_t materialSignature(const GameState& position, int ply);
+
+//
+// a position filter: masked signature equality, a ply range and squares that must hold given pieces
+//
+struct MaterialQuery {
+    uint32_t signatureMask = 0;
+    uint32_t signatureValue = 0;
+    int minPly = 0;
+    int maxPly = 255;               // plies past 255 are stored as 255
+    uint64_t required[2][6] = {};   // [white, black][pawn .. king] squares
+
+    // material as "KRP*vKR": piece letters per side with repeats for counts, '*' after a letter allows any
+    // number of that piece, pieces not named must be absent; false on a malformed spec
+    bool setMaterial(std::string_view spec);
+    // pieces on squares as "Pe5,nd6": upper case white, lower case black
+    bool setPattern(std::string_view spec);
+    bool hasPattern() const;
+};
+
+struct MaterialMatch {
+    uint32_t game;
+    uint16_t ply;                   // first matching position of the game
+};
+
+struct MaterialScanStats {
+    uint64_t records = 0;
+    uint64_t matches = 0;           // positions, the match list has one entry per game
+    uint64_t bytes = 0;             // column bytes read
+    double seconds = 0.0;
+    bool simd = false;
+
+    double gigabytesPerSecond() const { return seconds > 0.0 ? bytes / seconds / 1e9 : 0.0; }
+};
+
+//
+// writes base.material for an open database, the threads replay batches of games and write
+// their slice of every column in place since each game's record range is known up front
+//
+class MaterialIndexBuilder
+{
+public:
+    MaterialIndexBuilder(int threads);
+
+    bool build(const GameDatabase& database, std::ostream& log);
+
+private:
+    int _threads;
+};
+
+//
+// scans base.material through a memory map: the signature column is compared eight records at a time
+// with AVX2 where the CPU has it, and the board columns are only read for blocks that pass
+//
+class MaterialIndex
+{
+public:
+    MaterialIndex();
+
+    bool open(const std::string& basePath);
+    void close();
+
+    uint64_t gameCount() const { return _header ? _header->gameCount : 0; }
+    uint64_t recordCount() const { return _header ? _header->recordCount : 0; }
+
+    // matches sorted by game; simd false forces the scalar loop
+    void scan(const MaterialQuery& query, int threads, std::vector<MaterialMatch>& matches, MaterialScanStats& stats, bool simd = true) const;
+
+    static bool hasAvx2();
+
+private:
+    MappedFile _file;
+    const MaterialFileHeader* _header;
+    const uint64_t* _gameStarts;
+    const uint32_t* _signatures;
+    const uint64_t* _boards[MaterialBoardCount];
+};
@@ -0,0 +1,184 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <thread>
+#include "OpeningExplorer.h"
+
+static const char ExplorerMagic[8] = "CBEXPLR";
+
+ExplorerBuilder::ExplorerBuilder(const ExplorerOptions& options)
+    : _options(options)
+    , _games(0)
+{
+    _options.threads = std::max(1, _options.threads);
+    _options.maxPly = std::max(0, _options.maxPly);
+}
+
+void ExplorerBuilder::tally(uint64_t key, const BitMove& move, const GameHeader& header)
+{
+    const bool rated = header.whiteElo && header.blackElo;
+    Shard& shard = _shards[key >> 58];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    std::vector<Tally>& tallies = shard.positions[key];
+    auto tally = std::find_if(tallies.begin(), tallies.end(), [&](const Tally& t) { return t.move == move; });
+    if (tally == tallies.end()) {
+        tallies.emplace_back();
+        tally = tallies.end() - 1;
+        tally->move = move;
+    }
+    tally->games++;
+    tally->whiteWins += header.result == 1;
+    tally->draws += header.result == 0;
+    tally->blackWins += header.result == -1;
+    tally->lastPlayed = std::max(tally->lastPlayed, header.date);
+    tally->ratedGames += rated;
+    tally->ratingSum += rated ? (uint32_t(header.whiteElo) + header.blackElo) / 2 : 0;
+}
+
+void ExplorerBuilder::add(const GameState& start, std::span<const BitMove> moves, const GameHeader& header)
+{
+    GameState position = start;
+    const size_t plies = std::min(moves.size(), size_t(_options.maxPly));
+    for (size_t ply = 0; ply < plies; ply++) {
+        tally(position.positionKey(), moves[ply], header);
+        position.playMove(moves[ply]);
+    }
+    _games++;
+}
+
+void ExplorerBuilder::addDatabase(const GameDatabase& database)
+{
+    std::atomic<uint64_t> nextGame(0);
+    std::vector<std::thread> workers;
+    for (int i = 0; i < _options.threads; i++) {
+        workers.emplace_back([&]() {
+            GameState position;
+            std::vector<BitMove> legal;
+            for (uint64_t first = nextGame.fetch_add(GameBatch); first < database.size(); first = nextGame.fetch_add(GameBatch)) {
+                const uint64_t last = std::min(database.size(), first + GameBatch);
+                for (uint64_t id = first; id < last; id++) {
+                    // the tallies only need the numeric columns
+                    GameHeader header;
+                    header.date = database.date(id);
+                    header.whiteElo = database.whiteElo(id);
+                    header.blackElo = database.blackElo(id);
+                    header.result = database.result(id);
+                    // only the plies the table keeps are decoded
+                    database.replay(id, position, legal, [&](int ply, const GameState& reached, const BitMove& move) {
+                        if (ply >= _options.maxPly || move.isNull()) return false;
+                        tally(reached.positionKey(), move, header);
+                        return true;
+                    });
+                    _games++;
+                }
+            }
+        });
+    }
+    for (auto& thread : workers) {
+        thread.join();
+    }
+}
+
+bool ExplorerBuilder::write(const std::string& basePath, std::ostream& log)
+{
+    auto start = std::chrono::steady_clock::now();
+    ExplorerFileHeader header = {};
+    std::memcpy(header.magic, ExplorerMagic, sizeof(header.magic));
+    header.version = ExplorerVersion;
+    header.maxPly = _options.maxPly;
+    header.gameCount = _games;
+    for (const Shard& shard : _shards) {
+        header.positionCount += shard.positions.size();
+        for (const auto& [key, tallies] : shard.positions) {
+            header.moveCount += tallies.size();
+        }
+    }
+    header.slotCount = 16;
+    while (header.slotCount < header.positionCount * 2) {
+        header.slotCount *= 2;
+    }
+    header.slotsOffset = sizeof(ExplorerFileHeader);
+    header.movesOffset = header.slotsOffset + header.slotCount * sizeof(ExplorerSlot);
+
+    std::vector<ExplorerSlot> slots(header.slotCount);
+    std::vector<ExplorerMove> moves;
+    moves.reserve(header.moveCount);
+    const uint64_t mask = header.slotCount - 1;
+    for (Shard& shard : _shards) {
+        for (auto& [key, tallies] : shard.positions) {
+            std::sort(tallies.begin(), tallies.end(), [](const Tally& a, const Tally& b) { return a.games > b.games; });
+            uint64_t slot = key & mask;
+            while (slots[slot].moveCount) {
+                slot = (slot + 1) & mask;
+            }
+            slots[slot] = { key, uint32_t(moves.size()), uint32_t(tallies.size()) };
+            for (const Tally& tally : tallies) {
+                const uint16_t average = tally.ratedGames ? uint16_t(tally.ratingSum / tally.ratedGames) : 0;
+                moves.push_back({ tally.move, average, tally.games, tally.whiteWins, tally.draws, tally.blackWins, tally.lastPlayed });
+            }
+        }
+    }
+
+    const std::string path = basePath + ".explorer";
+    FILE* file = std::fopen(path.c_str(), "wb");
+    bool ok = file
+        && std::fwrite(&header, sizeof(header), 1, file) == 1
+        && std::fwrite(slots.data(), sizeof(ExplorerSlot), slots.size(), file) == slots.size()
+        && std::fwrite(moves.data(), sizeof(ExplorerMove), moves.size(), file) == moves.size();
+    if (file && std::fclose(file) != 0) ok = false;
+    if (!ok) {
+        log << "could not write " << path << std::endl;
+        return false;
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    log << std::fixed << std::setprecision(1) << "explorer: " << header.positionCount << " positions and " << header.moveCount
+        << " moves from " << header.gameCount << " games up to ply " << header.maxPly << ", written in " << seconds << "s" << std::endl;
+    return true;
+}
+
+OpeningExplorer::OpeningExplorer()
+    : _header(nullptr)
+    , _slots(nullptr)
+    , _moves(nullptr)
+{
+}
+
+bool OpeningExplorer::open(const std::string& basePath)
+{
+    close();
+    if (!_file.open(basePath + ".explorer")) return false;
+    _header = reinterpret_cast<const ExplorerFileHeader*>(_file.data());
+    const bool valid = _file.size() >= sizeof(ExplorerFileHeader)
+        && std::memcmp(_header->magic, ExplorerMagic, sizeof(ExplorerMagic)) == 0
+        && _header->version == ExplorerVersion
+        && _header->slotCount && (_header->slotCount & (_header->slotCount - 1)) == 0
+        && _header->movesOffset + _header->moveCount * sizeof(ExplorerMove) <= _file.size();
+    if (!valid) {
+        close();
+        return false;
+    }
+    _slots = reinterpret_cast<const ExplorerSlot*>(_file.data() + _header->slotsOffset);
+    _moves = reinterpret_cast<const ExplorerMove*>(_file.data() + _header->movesOffset);
+    _file.advise(AccessRandom);
+    return true;
+}
+
+void OpeningExplorer::close()
+{
+    _file.close();
+    _header = nullptr;
+    _slots = nullptr;
+    _moves = nullptr;
+}
+
+std::span<const ExplorerMove> OpeningExplorer::moves(uint64_t key) const
+{
+    if (!_header) return {};
+    const uint64_t mask = _header->slotCount - 1;
+    for (uint64_t slot = key & mask; _slots[slot].moveCount; slot = (slot + 1) & mask) {
+        if (_slots[slot].key == key) return { _moves + _slots[slot].firstMove, _slots[slot].moveCount };
+    }
+    return {};
+}
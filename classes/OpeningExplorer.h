@@ -0,0 +1,121 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "GameDatabase.h"
+#include "MappedFile.h"
+
+//
+// base.explorer: the moves played from every position in the first plies of the games, with their statistics
+//   an ExplorerFileHeader, an open addressing table of ExplorerSlot keyed by GameState::positionKey(), then the ExplorerMove
+//   entries, each position's moves contiguous and most played first
+// a lookup hashes into the slot table and probes linearly until it finds the key or an empty slot
+//
+
+constexpr uint32_t ExplorerVersion = 2;
+
+struct ExplorerFileHeader {
+    char magic[8];                  // "CBEXPLR"
+    uint32_t version;
+    uint32_t maxPly;                // positions after this many plies are not in the table
+    uint64_t gameCount;
+    uint64_t positionCount;
+    uint64_t moveCount;
+    uint64_t slotCount;             // a power of two, at least twice positionCount
+    uint64_t slotsOffset;
+    uint64_t movesOffset;
+};
+
+struct ExplorerSlot {
+    uint64_t key;
+    uint32_t firstMove;
+    uint32_t moveCount;             // 0 for an empty slot
+};
+
+struct ExplorerMove {
+    BitMove move;
+    uint16_t averageRating;         // of both players over the games where both are rated, 0 when none are
+    uint32_t games;
+    uint32_t whiteWins;             // games with an unknown result count only towards games
+    uint32_t draws;
+    uint32_t blackWins;
+    uint32_t lastPlayed;            // latest yyyymmdd date, 0 when no game had one
+};
+static_assert(sizeof(ExplorerMove) == 24, "ExplorerMove must stay 24 bytes");
+
+struct ExplorerOptions {
+    int threads = 1;
+    int maxPly = 40;
+};
+
+//
+// collects move statistics from games added on any number of threads, the positions are spread over
+// mutex guarded shards by hash so threads rarely wait on each other
+//
+class ExplorerBuilder
+{
+public:
+    ExplorerBuilder(const ExplorerOptions& options);
+
+    // thread safe, start is the position before the first move
+    void add(const GameState& start, std::span<const BitMove> moves, const GameHeader& header);
+    // adds every game of the database using the option's threads
+    void addDatabase(const GameDatabase& database);
+    bool write(const std::string& basePath, std::ostream& log);
+
+    uint64_t gameCount() const { return _games; }
+
+private:
+    struct Tally {
+        BitMove move;
+        uint32_t games = 0;
+        uint32_t whiteWins = 0;
+        uint32_t draws = 0;
+        uint32_t blackWins = 0;
+        uint32_t lastPlayed = 0;
+        uint32_t ratedGames = 0;
+        uint64_t ratingSum = 0;
+    };
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_map<uint64_t, std::vector<Tally>> positions;
+    };
+    static constexpr int ShardCount = 64;
+
+    void tally(uint64_t key, const BitMove& move, const GameHeader& header);
+
+    ExplorerOptions _options;
+    Shard _shards[ShardCount];
+    std::atomic<uint64_t> _games;
+};
+
+//
+// O(1) lookups in base.explorer through a memory map, safe to share between threads
+//
+class OpeningExplorer
+{
+public:
+    OpeningExplorer();
+
+    bool open(const std::string& basePath);
+    void close();
+    bool isOpen() const { return _header != nullptr; }
+
+    uint64_t positionCount() const { return _header ? _header->positionCount : 0; }
+    int maxPly() const { return _header ? _header->maxPly : 0; }
+
+    // the moves played from the position, most played first; empty when it is not in the table
+    std::span<const ExplorerMove> moves(uint64_t key) const;
+
+private:
+    MappedFile _file;
+    const ExplorerFileHeader* _header;
+    const ExplorerSlot* _slots;
+    const ExplorerMove* _moves;
+};
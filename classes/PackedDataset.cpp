@@ -0,0 +1,40 @@
+#include <algorithm>
+#include <numeric>
+#include "PackedDataset.h"
+
+PackedDataset::PackedDataset()
+    : _records(nullptr)
+    , _count(0)
+{
+}
+
+bool PackedDataset::open(const std::string& path)
+{
+    close();
+    if (!_file.open(path)) return false;
+    // a partly written trailing record is ignored
+    _records = reinterpret_cast<const PackedPosition*>(_file.data());
+    _count = _file.size() / sizeof(PackedPosition);
+    if (_count == 0) close();
+    return _count != 0;
+}
+
+void PackedDataset::close()
+{
+    _file.close();
+    _records = nullptr;
+    _count = 0;
+}
+
+std::vector<uint32_t> PackedDataset::blockOrder(uint64_t seed) const
+{
+    std::vector<uint32_t> order(blockCount());
+    std::iota(order.begin(), order.end(), 0);
+    if (seed) {
+        std::mt19937_64 random(seed);
+        std::shuffle(order.begin(), order.end(), random);
+    }
+    // in order reads can use aggressive read ahead, shuffled blocks still get the default within a block
+    _file.advise(seed ? AccessNormal : AccessSequential);
+    return order;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <span>
+#include <string>
+#include <vector>
+#include "MappedFile.h"
+#include "PackedPosition.h"
+
+// records per shuffle block, 128KB of file so a block is read with a handful of page faults
+constexpr size_t DatasetBlockRecords = 4096;
+
+//
+// read only view of a file of PackedPosition records, mapped rather than loaded
+// so it can be far larger than memory. Threads share one dataset and each walks its own shard.
+//
+class PackedDataset
+{
+public:
+    PackedDataset();
+    PackedDataset(const PackedDataset&) = delete;
+    PackedDataset& operator=(const PackedDataset&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+
+    size_t size() const { return _count; }
+    size_t blockCount() const { return (_count + DatasetBlockRecords - 1) / DatasetBlockRecords; }
+    std::span<const PackedPosition> records() const { return { _records, _count }; }
+
+    // block visiting order shared by every shard, identity when seed is 0
+    std::vector<uint32_t> blockOrder(uint64_t seed) const;
+
+    // calls visit(record) for every record of shard out of shardCount: blocks order[shard], order[shard + shardCount], ...
+    // with a non zero seed the records inside each block are visited in a shuffled order too
+    template <typename Visit>
+    void forEachInShard(const std::vector<uint32_t>& order, int shard, int shardCount, uint64_t seed, Visit visit) const
+    {
+        std::vector<uint16_t> inner(DatasetBlockRecords);
+        for (size_t i = shard; i < order.size(); i += shardCount) {
+            const size_t first = size_t(order[i]) * DatasetBlockRecords;
+            const size_t count = std::min(DatasetBlockRecords, _count - first);
+            for (size_t j = 0; j < count; j++) inner[j] = static_cast<uint16_t>(j);
+            if (seed) {
+                std::mt19937_64 random(seed ^ (order[i] * 0x9E3779B97F4A7C15ULL));
+                std::shuffle(inner.begin(), inner.begin() + count, random);
+            }
+            for (size_t j = 0; j < count; j++) {
+                visit(_records[first + inner[j]]);
+            }
+        }
+    }
+
+private:
+    MappedFile _file;
+    const PackedPosition* _records;
+    size_t _count;
+};
@@ -0,0 +1,58 @@
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include "PackedPosition.h"
+
+static const char PieceCodes[] = "0PNBRQK00pnbrqk0";
+
+static uint8_t pieceCode(char piece)
+{
+    const char* found = std::strchr(PieceCodes + 1, piece);
+    return found ? static_cast<uint8_t>(found - PieceCodes) : 0;
+}
+
+void PackedPosition::pack(const GameState& position)
+{
+    std::memset(this, 0, sizeof(*this));
+    int count = 0;
+    for (int square = 0; square < 64; square++) {
+        // a legal position never has more than 32 pieces
+        if (position.state[square] == '0' || count == 32) continue;
+        occupancy |= 1ULL << square;
+        pieces[count / 2] |= pieceCode(position.state[square]) << ((count & 1) * 4);
+        count++;
+    }
+    sideAndCastling = (position.color == BLACK ? 1 : 0) | ((position.castling & 15) << 1);
+    enPassant = position.enPassant;
+    halfmoveClock = static_cast<uint8_t>(std::min(position.halfmoveClock, 255));
+}
+
+bool PackedPosition::unpack(GameState& position) const
+{
+    const int pieceCount = std::popcount(occupancy);
+    if (pieceCount > 32 || enPassant < NoSquare || enPassant > 63) return false;
+    for (int count = pieceCount; count < 32; count++) {
+        if ((pieces[count / 2] >> ((count & 1) * 4)) & 15) return false;
+    }
+
+    char squares[64];
+    std::memset(squares, '0', sizeof(squares));
+    int count = 0;
+    int kings[2] = {};
+    bool known = true;
+    BitBoard(occupancy).forEachBit([&](int square) {
+        const char piece = PieceCodes[(pieces[count / 2] >> ((count & 1) * 4)) & 15];
+        known = known && piece != '0';
+        if (piece == 'K' || piece == 'k') kings[piece == 'k']++;
+        squares[square] = piece;
+        count++;
+    });
+    if (!known || kings[0] != 1 || kings[1] != 1) return false;
+
+    position.init(squares, (sideAndCastling & 1) ? BLACK : WHITE);
+    position.castling = (sideAndCastling >> 1) & 15;
+    position.enPassant = enPassant;
+    position.halfmoveClock = halfmoveClock;
+    position.hash = position.computeHash();
+    return true;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+#include "GameState.h"
+
+//
+// 32 byte position record used by the batch tools and training data files
+// occupied squares are a bitboard, the pieces on them follow as 4 bit codes from a1 upwards
+//
+struct PackedPosition {
+    uint64_t occupancy;
+    uint8_t pieces[16];             // colour in bit 3 (set for black), ChessPiece in bits 0-2
+    uint8_t sideAndCastling;        // bit 0 set when black is to move, CastlingRights in bits 1-4
+    int8_t enPassant;               // NoSquare when there is none
+    uint8_t halfmoveClock;
+    int8_t result;                  // game result from white's point of view: +1, 0 or -1
+    int16_t score;                  // search score from the side to move's point of view
+    uint16_t ply;                   // plies played in the game before this position
+
+    void pack(const GameState& position);
+    // leaves position with an empty history, exactly as initFromFEN would
+    // false for a record no legal position packs to: more than 32 pieces, unknown piece codes, set padding
+    // nibbles, a bad en passant square or not exactly one king per side; position is then left as it was
+    bool unpack(GameState& position) const;
+};
+static_assert(sizeof(PackedPosition) == 32, "PackedPosition must stay 32 bytes");
@@ -0,0 +1,263 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include "MappedFile.h"
+#include "Pgn.h"
+
+static bool isSpace(char c)
+{
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+// characters that end a movetext token
+static bool isDelimiter(char c)
+{
+    return isSpace(c) || c == '{' || c == '}' || c == '(' || c == ')' || c == ';' || c == '[' || c == ']';
+}
+
+std::string_view PgnGame::tag(std::string_view name) const
+{
+    for (const PgnTag& tag : tags) {
+        if (tag.name == name) return tag.value;
+    }
+    return {};
+}
+
+void PgnGame::clear()
+{
+    tags.clear();
+    san.clear();
+    comments.clear();
+    moves.clear();
+    moveIndexes.clear();
+    result = 0;
+    finished = false;
+    valid = false;
+    finalHash = 0;
+    offset = 0;
+}
+
+PgnParser::PgnParser(std::string_view text, bool keepComments)
+    : _text(text)
+    , _pos(0)
+    , _keepComments(keepComments)
+{
+}
+
+void PgnParser::skipSpace()
+{
+    while (_pos < _text.size() && isSpace(_text[_pos])) _pos++;
+}
+
+void PgnParser::skipLine()
+{
+    const size_t end = _text.find('\n', _pos);
+    _pos = end == std::string_view::npos ? _text.size() : end + 1;
+}
+
+bool PgnParser::next(PgnGame& game)
+{
+    game.clear();
+    skipSpace();
+    // % in the first column escapes the whole line
+    while (_pos < _text.size() && _text[_pos] == '%') {
+        skipLine();
+        skipSpace();
+    }
+    if (_pos >= _text.size()) return false;
+
+    game.offset = _pos;
+    while (_pos < _text.size() && _text[_pos] == '[') {
+        if (!readTag(game)) skipLine();
+        skipSpace();
+    }
+    readMovetext(game);
+    return true;
+}
+
+// [Name "value"], false when the line is not a well formed tag pair
+bool PgnParser::readTag(PgnGame& game)
+{
+    size_t pos = _pos + 1;
+    while (pos < _text.size() && _text[pos] == ' ') pos++;
+    const size_t nameStart = pos;
+    while (pos < _text.size() && !isSpace(_text[pos]) && _text[pos] != '"' && _text[pos] != ']') pos++;
+    const size_t nameEnd = pos;
+    while (pos < _text.size() && _text[pos] == ' ') pos++;
+    if (nameEnd == nameStart || pos >= _text.size() || _text[pos] != '"') return false;
+
+    const size_t valueStart = ++pos;
+    while (pos < _text.size() && _text[pos] != '"' && _text[pos] != '\n') {
+        pos += _text[pos] == '\\' ? 2 : 1;
+    }
+    if (pos >= _text.size() || _text[pos] != '"') return false;
+    const size_t valueEnd = pos;
+
+    const size_t close = _text.find(']', pos);
+    const size_t lineEnd = _text.find('\n', pos);
+    if (close == std::string_view::npos || close > lineEnd) return false;
+
+    game.tags.push_back({ _text.substr(nameStart, nameEnd - nameStart), _text.substr(valueStart, valueEnd - valueStart) });
+    _pos = close + 1;
+    return true;
+}
+
+void PgnParser::readMovetext(PgnGame& game)
+{
+    int depth = 0;
+    while (_pos < _text.size()) {
+        const char c = _text[_pos];
+        if (isSpace(c)) {
+            _pos++;
+            continue;
+        }
+        if (c == '{') {
+            size_t end = _text.find('}', _pos);
+            if (end == std::string_view::npos) end = _text.size();
+            if (_keepComments && depth == 0) game.comments.push_back({ int(game.san.size()), _text.substr(_pos + 1, end - _pos - 1) });
+            _pos = std::min(end + 1, _text.size());
+            continue;
+        }
+        if (c == ';') {
+            const size_t start = _pos + 1;
+            skipLine();
+            if (_keepComments && depth == 0) game.comments.push_back({ int(game.san.size()), _text.substr(start, _pos - start) });
+            continue;
+        }
+        if (c == '(') {
+            depth++;
+            _pos++;
+            continue;
+        }
+        if (c == ')') {
+            depth = std::max(0, depth - 1);
+            _pos++;
+            continue;
+        }
+        // the next game's tags, this one ended without a result
+        if (c == '[') return;
+        if (c == '%' && (_pos == 0 || _text[_pos - 1] == '\n')) {
+            skipLine();
+            continue;
+        }
+
+        const size_t start = _pos;
+        while (_pos < _text.size() && !isDelimiter(_text[_pos])) _pos++;
+        if (_pos == start) {
+            _pos++;
+            continue;
+        }
+        std::string_view token = _text.substr(start, _pos - start);
+        if (depth > 0 || token[0] == '$') continue;
+
+        if (token == "1-0" || token == "0-1" || token == "1/2-1/2" || token == "*") {
+            game.finished = token != "*";
+            game.result = token == "1-0" ? 1 : token == "0-1" ? -1 : 0;
+            return;
+        }
+        // move numbers, "12." and "12..." alone or run into the move
+        if (token[0] >= '0' && token[0] <= '9' && token.rfind("0-0", 0) != 0) {
+            size_t skip = 0;
+            while (skip < token.size() && ((token[skip] >= '0' && token[skip] <= '9') || token[skip] == '.')) skip++;
+            token.remove_prefix(skip);
+            if (token.empty()) continue;
+        }
+        game.san.push_back(token);
+    }
+}
+
+bool replayPgnGame(PgnGame& game, GameState& position)
+{
+    game.moves.clear();
+    game.moveIndexes.clear();
+    game.valid = false;
+    const std::string_view fen = game.tag("FEN");
+    if (!position.initFromFEN(fen.empty() ? std::string(StartFEN) : std::string(fen))) return false;
+
+    for (std::string_view san : game.san) {
+        int index = 0;
+        const BitMove move = position.parseSANMove(san, &index);
+        if (move.isNull()) return false;
+        position.playMove(move);
+        game.moves.push_back(move);
+        game.moveIndexes.push_back(static_cast<uint8_t>(index));
+    }
+    game.finalHash = position.hash;
+    game.valid = true;
+    return true;
+}
+
+PgnImporter::PgnImporter(const PgnImportOptions& options)
+    : _options(options)
+{
+    _options.threads = std::max(1, _options.threads);
+    _options.chunkBytes = std::max<size_t>(1, _options.chunkBytes);
+}
+
+std::vector<size_t> PgnImporter::splitChunks(std::string_view text, size_t chunkBytes)
+{
+    std::vector<size_t> starts = { 0 };
+    size_t pos = chunkBytes;
+    while (pos < text.size()) {
+        const size_t found = text.find("\n[Event ", pos);
+        if (found == std::string_view::npos) break;
+        starts.push_back(found + 1);
+        pos = found + 1 + chunkBytes;
+    }
+    return starts;
+}
+
+bool PgnImporter::run(const std::string& path, const PgnSink& sink)
+{
+    _stats = PgnImportStats();
+    MappedFile file;
+    if (!file.open(path)) return false;
+    file.advise(AccessSequential);
+
+    const std::string_view text = file.text();
+    const std::vector<size_t> starts = splitChunks(text, _options.chunkBytes);
+    std::atomic<size_t> nextChunk(0);
+    std::atomic<uint64_t> games(0), invalidGames(0), moves(0);
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int i = 0; i < _options.threads; i++) {
+        workers.emplace_back([&]() {
+            GameState position;
+            std::vector<PgnGame> parsed;
+            uint64_t gameCount = 0, invalidCount = 0, moveCount = 0;
+            for (size_t chunk = nextChunk++; chunk < starts.size(); chunk = nextChunk++) {
+                const size_t begin = starts[chunk];
+                const size_t end = chunk + 1 < starts.size() ? starts[chunk + 1] : text.size();
+                PgnParser parser(text.substr(begin, end - begin), _options.keepComments);
+                size_t count = 0;
+                for (;;) {
+                    if (count == parsed.size()) parsed.emplace_back();
+                    PgnGame& game = parsed[count];
+                    if (!parser.next(game)) break;
+                    game.offset += begin;
+                    if (!replayPgnGame(game, position)) invalidCount++;
+                    moveCount += game.moves.size();
+                    count++;
+                }
+                gameCount += count;
+                if (sink) sink(chunk, std::span<PgnGame>(parsed.data(), count));
+            }
+            games += gameCount;
+            invalidGames += invalidCount;
+            moves += moveCount;
+        });
+    }
+    for (auto& thread : workers) {
+        thread.join();
+    }
+
+    _stats.games = games;
+    _stats.invalidGames = invalidGames;
+    _stats.moves = moves;
+    _stats.bytes = text.size();
+    _stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return true;
+}
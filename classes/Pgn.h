@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "GameState.h"
+
+struct PgnTag {
+    std::string_view name;
+    std::string_view value;         // without the quotes, escapes are left as written
+};
+
+struct PgnComment {
+    int ply;                        // number of moves played before the comment
+    std::string_view text;
+};
+
+// one game as written in the file, every view points into the parsed text
+struct PgnGame {
+    std::vector<PgnTag> tags;
+    std::vector<std::string_view> san;
+    std::vector<PgnComment> comments;   // only kept when the parser is asked to
+    int result = 0;                     // +1, 0 or -1 from white's point of view
+    bool finished = false;              // false for "*" or a game cut off without a result
+    size_t offset = 0;                  // byte offset of the game in the text
+
+    // filled by replayPgnGame
+    std::vector<BitMove> moves;
+    std::vector<uint8_t> moveIndexes;   // each move's position in the legal move list, see GameDatabase
+    bool valid = false;                 // every SAN move was legal
+    uint64_t finalHash = 0;             // Zobrist key after the last move of a valid game
+
+    std::string_view tag(std::string_view name) const;
+    // keeps the capacity, games are reused for the whole import
+    void clear();
+};
+
+//
+// zero copy reader over PGN text: tag pairs and movetext, variations and NAGs are skipped,
+// comments are skipped or kept as views
+//
+class PgnParser
+{
+public:
+    PgnParser(std::string_view text, bool keepComments = false);
+
+    // false once the text holds no more games
+    bool next(PgnGame& game);
+
+private:
+    void skipSpace();
+    void skipLine();
+    bool readTag(PgnGame& game);
+    void readMovetext(PgnGame& game);
+
+    std::string_view _text;
+    size_t _pos;
+    bool _keepComments;
+};
+
+// plays game.san from the FEN tag or the standard start into position, game.moves gets every
+// move that was legal and game.valid whether that was all of them
+bool replayPgnGame(PgnGame& game, GameState& position);
+
+struct PgnImportOptions {
+    int threads = 1;
+    bool keepComments = false;
+    size_t chunkBytes = 4 << 20;    // chunks end on game boundaries, several per thread keep the threads busy
+};
+
+struct PgnImportStats {
+    uint64_t games = 0;
+    uint64_t invalidGames = 0;
+    uint64_t moves = 0;
+    uint64_t bytes = 0;
+    double seconds = 0.0;
+
+    double gamesPerSecond() const { return seconds > 0.0 ? games / seconds : 0.0; }
+};
+
+// called on the worker threads, possibly at the same time, with the games of one chunk in file order
+// chunk numbers follow the file so a sink can restore the order; the games are only valid during the call
+using PgnSink = std::function<void(size_t chunk, std::span<PgnGame> games)>;
+
+//
+// parses and validates a PGN file in parallel: the mapped file is cut into chunks at "[Event " lines
+// and every worker parses and replays whole chunks with its own GameState
+//
+class PgnImporter
+{
+public:
+    PgnImporter(const PgnImportOptions& options);
+
+    // false when the file cannot be mapped
+    bool run(const std::string& path, const PgnSink& sink);
+    const PgnImportStats& stats() const { return _stats; }
+
+    // chunk start offsets, the last chunk runs to the end of text
+    static std::vector<size_t> splitChunks(std::string_view text, size_t chunkBytes);
+
+private:
+    PgnImportOptions _options;
+    PgnImportStats _stats;
+};
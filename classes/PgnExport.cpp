@@ -0,0 +1,214 @@
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <thread>
+#include "Eco.h"
+#include "PgnExport.h"
+
+// export format keeps movetext lines under 80 characters
+static const size_t LineWidth = 79;
+
+static void appendNumber(std::string& out, uint64_t value)
+{
+    char digits[24];
+    const auto end = std::to_chars(digits, digits + sizeof(digits), value).ptr;
+    out.append(digits, end);
+}
+
+// two digits, or question marks for an unknown date part
+static void appendDatePart(std::string& out, uint32_t value, int width)
+{
+    if (value == 0) {
+        out.append(width, '?');
+        return;
+    }
+    char digits[8];
+    for (int i = width - 1; i >= 0; i--, value /= 10) {
+        digits[i] = char('0' + value % 10);
+    }
+    out.append(digits, width);
+}
+
+static void appendTag(std::string& out, const char* name, std::string_view value)
+{
+    out += '[';
+    out += name;
+    out += " \"";
+    for (char c : value) {
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    out += "\"]\n";
+}
+
+PgnExporter::PgnExporter(const PgnExportOptions& options)
+    : _options(options)
+{
+}
+
+bool PgnExporter::appendGame(const GameDatabase& database, uint64_t id, GameState& position,
+                             std::vector<BitMove>& legal, std::vector<BitMove>& nextLegal, std::string& out)
+{
+    const size_t gameStart = out.size();
+    if (!database.startPosition(id, position)) return false;
+    const GameView game = database.game(id);
+    const int result = database.result(id);
+    const char* resultText = result == 1 ? "1-0" : result == -1 ? "0-1" : result == 0 ? "1/2-1/2" : "*";
+
+    appendTag(out, "Event", database.event(id));
+    appendTag(out, "Site", database.site(id));
+    const uint32_t date = database.date(id);
+    out += "[Date \"";
+    appendDatePart(out, date / 10000, 4);
+    out += '.';
+    appendDatePart(out, date / 100 % 100, 2);
+    out += '.';
+    appendDatePart(out, date % 100, 2);
+    out += "\"]\n[Round \"?\"]\n";
+    appendTag(out, "White", database.white(id));
+    appendTag(out, "Black", database.black(id));
+    appendTag(out, "Result", resultText);
+    if (database.whiteElo(id)) {
+        out += "[WhiteElo \"";
+        appendNumber(out, database.whiteElo(id));
+        out += "\"]\n";
+    }
+    if (database.blackElo(id)) {
+        out += "[BlackElo \"";
+        appendNumber(out, database.blackElo(id));
+        out += "\"]\n";
+    }
+    if (database.eco(id)) appendTag(out, "ECO", ecoToString(database.eco(id)));
+    int moveNumber = 1;
+    if (!game.fen.empty()) {
+        appendTag(out, "SetUp", "1");
+        appendTag(out, "FEN", game.fen);
+        // the full move number is the FEN's last field when it has all six
+        const size_t space = game.fen.find_last_of(' ');
+        if (std::count(game.fen.begin(), game.fen.end(), ' ') == 5) {
+            std::from_chars(game.fen.data() + space + 1, game.fen.data() + game.fen.size(), moveNumber);
+        }
+    }
+    out += '\n';
+
+    // tokens go straight into out, a line is broken before a token that would run past LineWidth
+    size_t lineStart = out.size();
+    auto appendToken = [&](const char* text, size_t length) {
+        if (out.size() > lineStart) {
+            if (out.size() - lineStart + 1 + length > LineWidth) {
+                out += '\n';
+                lineStart = out.size();
+            } else {
+                out += ' ';
+            }
+        }
+        out.append(text, length);
+    };
+
+    position.generateAllMoves(legal);
+    for (int ply = 0; ply < game.plies; ply++) {
+        if (game.moves[ply] >= legal.size()) {
+            out.resize(gameStart);
+            return false;
+        }
+        const BitMove move = legal[game.moves[ply]];
+        char token[32];
+        int length = 0;
+        if (position.color == WHITE || ply == 0) {
+            length = int(std::to_chars(token, token + 16, moveNumber).ptr - token);
+            const char* dots = position.color == WHITE ? "." : "...";
+            while (*dots) token[length++] = *dots++;
+            token[length++] = ' ';
+        }
+        length += position.writeSAN(move, legal, token + length);
+        if (position.color == BLACK) moveNumber++;
+
+        // the next position's moves are needed for its SAN anyway, so they also tell check from mate
+        position.playMove(move);
+        position.generateAllMoves(nextLegal);
+        if (position.isInCheck()) token[length++] = nextLegal.empty() ? '#' : '+';
+        std::swap(legal, nextLegal);
+        // the number stays on the line of its move
+        appendToken(token, length);
+    }
+    appendToken(resultText, std::char_traits<char>::length(resultText));
+    out += "\n\n";
+    return true;
+}
+
+bool PgnExporter::run(const GameDatabase& database, std::span<const uint64_t> ids, const std::string& path)
+{
+    _stats = PgnExportStats();
+    auto start = std::chrono::steady_clock::now();
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) return false;
+    std::vector<char> fileBuffer(std::max<size_t>(_options.bufferBytes, BUFSIZ));
+    std::setvbuf(file, fileBuffer.data(), _IOFBF, fileBuffer.size());
+
+    // blocks finish in any order and are written in sequence, later ones wait in pending
+    std::mutex writeMutex;
+    size_t nextWrite = 0;
+    std::map<size_t, std::string> pending;
+    bool failed = false;
+    auto write = [&](const std::string& text) {
+        if (!failed && std::fwrite(text.data(), 1, text.size(), file) != text.size()) failed = true;
+        _stats.bytes += text.size();
+    };
+
+    const uint64_t blocks = (ids.size() + GameBatch - 1) / GameBatch;
+    std::atomic<uint64_t> nextBlock(0);
+    std::vector<std::thread> workers;
+    for (int i = 0; i < std::max(1, _options.threads); i++) {
+        workers.emplace_back([&]() {
+            GameState position;
+            std::vector<BitMove> legal;
+            std::vector<BitMove> nextLegal;
+            legal.reserve(256);
+            nextLegal.reserve(256);
+            uint64_t games = 0;
+            uint64_t failedGames = 0;
+            uint64_t plies = 0;
+            for (uint64_t block = nextBlock++; block < blocks; block = nextBlock++) {
+                std::string text;
+                text.reserve(GameBatch * 1024);
+                const uint64_t last = std::min<uint64_t>(ids.size(), (block + 1) * GameBatch);
+                for (uint64_t index = block * GameBatch; index < last; index++) {
+                    const uint64_t id = ids[index];
+                    if (id < database.size() && appendGame(database, id, position, legal, nextLegal, text)) {
+                        games++;
+                        plies += database.game(id).plies;
+                    } else {
+                        failedGames++;
+                    }
+                }
+
+                std::lock_guard<std::mutex> lock(writeMutex);
+                if (block != nextWrite) {
+                    pending.emplace(block, std::move(text));
+                    continue;
+                }
+                write(text);
+                nextWrite++;
+                for (auto next = pending.find(nextWrite); next != pending.end(); next = pending.find(nextWrite)) {
+                    write(next->second);
+                    pending.erase(next);
+                    nextWrite++;
+                }
+            }
+            std::lock_guard<std::mutex> lock(writeMutex);
+            _stats.games += games;
+            _stats.failedGames += failedGames;
+            _stats.plies += plies;
+        });
+    }
+    for (auto& thread : workers) {
+        thread.join();
+    }
+    if (std::fclose(file) != 0) failed = true;
+    _stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return !failed;
+}
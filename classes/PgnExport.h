@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+#include "GameDatabase.h"
+
+struct PgnExportOptions {
+    int threads = 1;
+    size_t bufferBytes = 4 << 20;   // stdio buffer of the output file
+};
+
+struct PgnExportStats {
+    uint64_t games = 0;
+    uint64_t failedGames = 0;       // stored moves that stopped being legal, left out of the file
+    uint64_t plies = 0;
+    uint64_t bytes = 0;
+    double seconds = 0.0;
+
+    double gamesPerSecond() const { return seconds > 0.0 ? games / seconds : 0.0; }
+};
+
+//
+// writes games of a database back to PGN: every game is replayed with GameState and its moves written as SAN,
+// the threads format blocks of games into their own buffers and the blocks are written in the order asked for
+//
+class PgnExporter
+{
+public:
+    PgnExporter(const PgnExportOptions& options);
+
+    // false when the file cannot be written
+    bool run(const GameDatabase& database, std::span<const uint64_t> ids, const std::string& path);
+    const PgnExportStats& stats() const { return _stats; }
+
+    // appends one game with its tags to out, position and the move lists are the caller's scratch space
+    // false when a stored move is not legal, out is then left as it was
+    static bool appendGame(const GameDatabase& database, uint64_t id, GameState& position,
+                           std::vector<BitMove>& legal, std::vector<BitMove>& nextLegal, std::string& out);
+
+private:
+    PgnExportOptions _options;
+    PgnExportStats _stats;
+};
@@ -0,0 +1,300 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include "PositionIndex.h"
+
+static const char PositionMagic[8] = "CBPOSIX";
+
+struct PositionRecord {
+    uint64_t key;
+    uint32_t game;
+    uint32_t ply;
+
+    bool operator<(const PositionRecord& other) const
+    {
+        if (key != other.key) return key < other.key;
+        if (game != other.game) return game < other.game;
+        return ply < other.ply;
+    }
+    bool operator>(const PositionRecord& other) const { return other < *this; }
+};
+
+static void writeVarint(std::vector<uint8_t>& out, uint64_t value)
+{
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+static const uint8_t* readVarint(const uint8_t* in, uint64_t& value)
+{
+    value = 0;
+    for (int shift = 0; ; shift += 7) {
+        const uint8_t byte = *in++;
+        value |= uint64_t(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return in;
+    }
+}
+
+// buffered sequential reader over one sorted run file
+class RunReader
+{
+public:
+    RunReader(const std::string& path) : _file(std::fopen(path.c_str(), "rb")), _buffer(1 << 16), _pos(0), _size(0) { }
+    ~RunReader() { if (_file) std::fclose(_file); }
+
+    bool next(PositionRecord& record)
+    {
+        if (_pos == _size) {
+            _size = _file ? std::fread(_buffer.data(), sizeof(PositionRecord), _buffer.size(), _file) : 0;
+            _pos = 0;
+            if (_size == 0) return false;
+        }
+        record = _buffer[_pos++];
+        return true;
+    }
+
+private:
+    FILE* _file;
+    std::vector<PositionRecord> _buffer;
+    size_t _pos;
+    size_t _size;
+};
+
+PositionIndexBuilder::PositionIndexBuilder(const PositionIndexOptions& options)
+    : _options(options)
+{
+    _options.threads = std::max(1, _options.threads);
+}
+
+bool PositionIndexBuilder::build(const GameDatabase& database, std::ostream& log)
+{
+    const std::string base = database.basePath();
+    const size_t bufferRecords = std::max<size_t>(1 << 16, _options.memoryMegabytes * 1024 * 1024 / sizeof(PositionRecord) / _options.threads);
+    auto start = std::chrono::steady_clock::now();
+
+    // sorted runs
+    std::atomic<uint64_t> nextGame(0);
+    std::atomic<bool> failed(false);
+    std::mutex runMutex;
+    std::vector<std::string> runs;
+    uint64_t totalRecords = 0;
+    auto writeRun = [&](std::vector<PositionRecord>& buffer) {
+        if (buffer.empty()) return;
+        std::sort(buffer.begin(), buffer.end());
+        std::lock_guard<std::mutex> lock(runMutex);
+        const std::string path = base + ".positions.run" + std::to_string(runs.size()) + ".tmp";
+        FILE* file = std::fopen(path.c_str(), "wb");
+        if (!file || std::fwrite(buffer.data(), sizeof(PositionRecord), buffer.size(), file) != buffer.size()) failed = true;
+        if (file) std::fclose(file);
+        runs.push_back(path);
+        totalRecords += buffer.size();
+        buffer.clear();
+    };
+
+    std::vector<std::thread> workers;
+    for (int i = 0; i < _options.threads; i++) {
+        workers.emplace_back([&]() {
+            std::vector<PositionRecord> buffer;
+            buffer.reserve(bufferRecords);
+            GameState position;
+            std::vector<BitMove> legal;
+            for (uint64_t first = nextGame.fetch_add(GameBatch); first < database.size() && !failed; first = nextGame.fetch_add(GameBatch)) {
+                const uint64_t last = std::min(database.size(), first + GameBatch);
+                for (uint64_t id = first; id < last; id++) {
+                    const GameView game = database.game(id);
+                    // room for the whole game so a run never splits one
+                    if (buffer.size() + game.plies + 1 > bufferRecords) writeRun(buffer);
+                    database.replay(id, position, legal, [&](int ply, const GameState& reached, const BitMove&) {
+                        buffer.push_back({ reached.positionKey(), uint32_t(id), uint32_t(ply) });
+                        return true;
+                    });
+                }
+            }
+            writeRun(buffer);
+        });
+    }
+    for (auto& thread : workers) {
+        thread.join();
+    }
+    const double sortSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // k way merge into the index
+    const std::string path = base + ".positions";
+    const std::string keysPath = base + ".positions.keys.tmp";
+    FILE* out = failed ? nullptr : std::fopen(path.c_str(), "wb");
+    FILE* keys = out ? std::fopen(keysPath.c_str(), "w+b") : nullptr;
+    PositionIndexHeader header = {};
+    if (keys) {
+        std::memcpy(header.magic, PositionMagic, sizeof(header.magic));
+        header.version = PositionIndexVersion;
+        header.gameCount = database.size();
+        header.postingsOffset = sizeof(PositionIndexHeader);
+        bool ok = std::fwrite(&header, sizeof(header), 1, out) == 1;
+
+        std::vector<std::unique_ptr<RunReader>> readers;
+        using Head = std::pair<PositionRecord, size_t>;
+        auto later = [](const Head& a, const Head& b) { return a.first > b.first; };
+        std::priority_queue<Head, std::vector<Head>, decltype(later)> heads(later);
+        for (size_t i = 0; i < runs.size(); i++) {
+            readers.push_back(std::make_unique<RunReader>(runs[i]));
+            PositionRecord record;
+            if (readers.back()->next(record)) heads.push({ record, i });
+        }
+
+        // one key's postings are collected first, the count goes in front of them
+        std::vector<uint8_t> postings;
+        std::vector<uint8_t> list;
+        postings.reserve(1 << 20);
+        uint64_t written = 0;
+        PositionKeyEntry entry = {};
+        uint64_t count = 0;
+        uint32_t previousGame = 0;
+        auto finishKey = [&]() {
+            if (count == 0) return;
+            entry.offset = written + postings.size();
+            writeVarint(postings, count);
+            postings.insert(postings.end(), list.begin(), list.end());
+            ok = ok && std::fwrite(&entry, sizeof(entry), 1, keys) == 1;
+            header.keyCount++;
+            if (postings.size() >= (1 << 20)) {
+                ok = ok && std::fwrite(postings.data(), 1, postings.size(), out) == postings.size();
+                written += postings.size();
+                postings.clear();
+            }
+        };
+        while (!heads.empty()) {
+            const auto [record, run] = heads.top();
+            heads.pop();
+            PositionRecord following;
+            if (readers[run]->next(following)) heads.push({ following, run });
+
+            if (count == 0 || record.key != entry.key) {
+                finishKey();
+                entry.key = record.key;
+                list.clear();
+                count = 0;
+                previousGame = 0;
+            }
+            writeVarint(list, record.game - previousGame);
+            writeVarint(list, record.ply);
+            previousGame = record.game;
+            count++;
+            header.postingCount++;
+        }
+        finishKey();
+        ok = ok && (postings.empty() || std::fwrite(postings.data(), 1, postings.size(), out) == postings.size());
+        written += postings.size();
+
+        // key table after the postings, 8 byte aligned
+        header.keysOffset = (header.postingsOffset + written + 7) & ~uint64_t(7);
+        const char zeros[8] = {};
+        const size_t padding = header.keysOffset - header.postingsOffset - written;
+        ok = ok && (padding == 0 || std::fwrite(zeros, 1, padding, out) == padding);
+        std::rewind(keys);
+        std::vector<char> copy(1 << 20);
+        for (size_t bytes; (bytes = std::fread(copy.data(), 1, copy.size(), keys)) > 0; ) {
+            ok = ok && std::fwrite(copy.data(), 1, bytes, out) == bytes;
+        }
+        ok = ok && std::fseek(out, 0, SEEK_SET) == 0 && std::fwrite(&header, sizeof(header), 1, out) == 1;
+        if (!ok) failed = true;
+    } else {
+        failed = true;
+    }
+    if (keys) std::fclose(keys);
+    if (out && std::fclose(out) != 0) failed = true;
+    std::remove(keysPath.c_str());
+    for (const std::string& run : runs) {
+        std::remove(run.c_str());
+    }
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (failed) {
+        log << "could not write " << path << std::endl;
+        return false;
+    }
+    log << std::fixed << std::setprecision(1) << "indexed " << header.postingCount << " positions (" << header.keyCount
+        << " distinct) from " << database.size() << " games in " << seconds << "s, " << runs.size() << " sorted runs in "
+        << sortSeconds << "s, " << (seconds > 0.0 ? totalRecords / seconds : 0.0) << " positions/s" << std::endl;
+    return true;
+}
+
+PositionIndex::PositionIndex()
+    : _header(nullptr)
+    , _keys(nullptr)
+    , _postings(nullptr)
+{
+}
+
+bool PositionIndex::open(const std::string& basePath)
+{
+    close();
+    if (!_file.open(basePath + ".positions")) return false;
+    _header = reinterpret_cast<const PositionIndexHeader*>(_file.data());
+    const bool valid = _file.size() >= sizeof(PositionIndexHeader)
+        && std::memcmp(_header->magic, PositionMagic, sizeof(PositionMagic)) == 0
+        && _header->version == PositionIndexVersion
+        && _header->keysOffset + _header->keyCount * sizeof(PositionKeyEntry) <= _file.size();
+    if (!valid) {
+        close();
+        return false;
+    }
+    _keys = reinterpret_cast<const PositionKeyEntry*>(_file.data() + _header->keysOffset);
+    _postings = reinterpret_cast<const uint8_t*>(_file.data() + _header->postingsOffset);
+    // lookups touch a few key pages and one run of postings, read ahead would only waste I/O
+    _file.advise(AccessRandom);
+    return true;
+}
+
+void PositionIndex::close()
+{
+    _file.close();
+    _header = nullptr;
+    _keys = nullptr;
+    _postings = nullptr;
+}
+
+const PositionKeyEntry* PositionIndex::lookup(uint64_t key) const
+{
+    if (!_header) return nullptr;
+    const PositionKeyEntry* end = _keys + _header->keyCount;
+    const PositionKeyEntry* found = std::lower_bound(_keys, end, key, [](const PositionKeyEntry& entry, uint64_t value) {
+        return entry.key < value;
+    });
+    return found != end && found->key == key ? found : nullptr;
+}
+
+uint32_t PositionIndex::count(uint64_t key) const
+{
+    const PositionKeyEntry* entry = lookup(key);
+    if (!entry) return 0;
+    uint64_t total;
+    readVarint(_postings + entry->offset, total);
+    return uint32_t(total);
+}
+
+uint32_t PositionIndex::find(uint64_t key, std::vector<PositionHit>& hits, size_t limit) const
+{
+    const PositionKeyEntry* entry = lookup(key);
+    if (!entry) return 0;
+    uint64_t total;
+    const uint8_t* in = readVarint(_postings + entry->offset, total);
+    uint64_t game = 0;
+    for (uint64_t i = 0; i < total && i < limit; i++) {
+        uint64_t delta, ply;
+        in = readVarint(in, delta);
+        in = readVarint(in, ply);
+        game += delta;
+        hits.push_back({ uint32_t(game), uint16_t(ply) });
+    }
+    return uint32_t(total);
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "GameDatabase.h"
+#include "MappedFile.h"
+
+//
+// base.positions: every position of every game in a GameDatabase keyed by GameState::positionKey()
+//   a PositionIndexHeader, the postings, then one PositionKeyEntry per distinct position sorted by key
+// a key's postings are varint(count) then its (game, ply) pairs in game order, each as varint(game - previous game), varint(ply)
+//
+
+constexpr uint32_t PositionIndexVersion = 2;
+
+struct PositionIndexHeader {
+    char magic[8];                  // "CBPOSIX"
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t gameCount;             // of the database the index was built from
+    uint64_t keyCount;
+    uint64_t postingCount;
+    uint64_t postingsOffset;
+    uint64_t keysOffset;
+};
+
+struct PositionKeyEntry {
+    uint64_t key;
+    uint64_t offset;                // of the posting list, from postingsOffset
+};
+
+struct PositionHit {
+    uint32_t game;
+    uint16_t ply;                   // moves played before the position, 0 is the start
+};
+
+struct PositionIndexOptions {
+    int threads = 1;
+    size_t memoryMegabytes = 512;   // shared by the threads' sort buffers, each full buffer becomes a sorted run
+};
+
+//
+// builds base.positions for an open database: the threads replay games and collect (hash, game, ply)
+// records, sort them in memory sized runs on disk, and one merge pass writes the compressed index
+//
+class PositionIndexBuilder
+{
+public:
+    PositionIndexBuilder(const PositionIndexOptions& options);
+
+    bool build(const GameDatabase& database, std::ostream& log);
+
+private:
+    PositionIndexOptions _options;
+};
+
+//
+// queries base.positions through a memory map, safe to share between threads
+//
+class PositionIndex
+{
+public:
+    PositionIndex();
+
+    bool open(const std::string& basePath);
+    void close();
+
+    uint64_t keyCount() const { return _header ? _header->keyCount : 0; }
+    uint64_t postingCount() const { return _header ? _header->postingCount : 0; }
+
+    // number of times the position occurs, without decoding anything
+    uint32_t count(uint64_t key) const;
+    // appends up to limit occurrences in game order, returns the total number of occurrences
+    uint32_t find(uint64_t key, std::vector<PositionHit>& hits, size_t limit = SIZE_MAX) const;
+
+private:
+    const PositionKeyEntry* lookup(uint64_t key) const;
+
+    MappedFile _file;
+    const PositionIndexHeader* _header;
+    const PositionKeyEntry* _keys;
+    const uint8_t* _postings;
+};
@@ -0,0 +1,509 @@
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include "Eco.h"
+#include "QueryServer.h"
+
+#ifndef _WIN32
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+static const char* OpNames[] = { "position", "explorer", "game", "stats", "invalid" };
+// longest request line a client may send
+static const size_t MaxRequestBytes = 64 * 1024;
+// a client that stops reading its replies holds a worker for at most this long
+static const int SendTimeoutSeconds = 5;
+
+void LatencyHistogram::record(uint64_t micros)
+{
+    counts[std::min<int>(std::bit_width(micros), Buckets - 1)]++;
+    total++;
+    uint64_t seen = maxMicros;
+    while (micros > seen && !maxMicros.compare_exchange_weak(seen, micros)) { }
+}
+
+uint64_t LatencyHistogram::percentile(double fraction) const
+{
+    const uint64_t wanted = uint64_t(fraction * total + 0.5);
+    uint64_t seen = 0;
+    for (int bucket = 0; bucket < Buckets; bucket++) {
+        seen += counts[bucket];
+        if (seen >= wanted && seen > 0) return std::min(bucket ? uint64_t(1) << bucket : 0, maxMicros.load());
+    }
+    return maxMicros;
+}
+
+// a flat JSON object of string, number and boolean members, values are kept as their text
+static bool parseRequest(std::string_view text, std::map<std::string, std::string>& fields)
+{
+    size_t pos = 0;
+    auto skipSpace = [&]() {
+        while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\r' || text[pos] == '\n')) pos++;
+    };
+    auto readString = [&](std::string& out) {
+        if (pos >= text.size() || text[pos] != '"') return false;
+        for (pos++; pos < text.size() && text[pos] != '"'; pos++) {
+            if (text[pos] == '\\' && ++pos < text.size()) {
+                const char escaped = text[pos];
+                out += escaped == 'n' ? '\n' : escaped == 't' ? '\t' : escaped;
+            } else {
+                out += text[pos];
+            }
+        }
+        return pos++ < text.size();
+    };
+
+    skipSpace();
+    if (pos >= text.size() || text[pos++] != '{') return false;
+    skipSpace();
+    if (pos < text.size() && text[pos] == '}') return true;
+    while (pos < text.size()) {
+        std::string name;
+        std::string value;
+        skipSpace();
+        if (!readString(name)) return false;
+        skipSpace();
+        if (pos >= text.size() || text[pos++] != ':') return false;
+        skipSpace();
+        if (pos < text.size() && text[pos] == '"') {
+            if (!readString(value)) return false;
+        } else {
+            while (pos < text.size() && text[pos] != ',' && text[pos] != '}' && text[pos] != ' ') value += text[pos++];
+            if (value.empty()) return false;
+        }
+        fields[name] = value;
+        skipSpace();
+        if (pos < text.size() && text[pos] == ',') {
+            pos++;
+            continue;
+        }
+        return pos < text.size() && text[pos] == '}';
+    }
+    return false;
+}
+
+static void writeString(std::ostringstream& json, std::string_view text)
+{
+    json << '"';
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            json << '\\' << c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            json << ' ';
+        } else {
+            json << c;
+        }
+    }
+    json << '"';
+}
+
+static std::string errorReply(std::string_view message)
+{
+    std::ostringstream json;
+    json << "{\"ok\":false,\"error\":";
+    writeString(json, message);
+    json << "}";
+    return json.str();
+}
+
+// a whole non negative number, anything else is rejected instead of read as 0
+static bool numberField(const std::map<std::string, std::string>& fields, const char* name, uint64_t& value)
+{
+    auto field = fields.find(name);
+    if (field == fields.end()) return false;
+    const std::string& text = field->second;
+    const auto parsed = std::from_chars(text.data(), text.data() + text.size(), value);
+    return parsed.ec == std::errc() && parsed.ptr == text.data() + text.size();
+}
+
+static bool positionFromFields(const std::map<std::string, std::string>& fields, GameState& position)
+{
+    auto fen = fields.find("fen");
+    return position.initFromFEN(fen == fields.end() ? std::string(StartFEN) : fen->second);
+}
+
+QueryServer::QueryServer(const QueryServerOptions& options)
+    : _options(options)
+    , _hasIndex(false)
+    , _openConnections(0)
+    , _wakePipe{ -1, -1 }
+{
+    _options.threads = std::max(1, _options.threads);
+    _options.maxConnections = std::max(1, _options.maxConnections);
+}
+
+bool QueryServer::open(const std::string& basePath, std::ostream& log)
+{
+    if (!_database.open(basePath)) {
+        log << "could not open database " << basePath << std::endl;
+        return false;
+    }
+    _hasIndex = _index.open(basePath);
+    _explorer.open(basePath);
+    log << "serving " << _database.size() << " games" << (_hasIndex ? ", the position index" : "")
+        << (_explorer.isOpen() ? ", the opening explorer" : "") << std::endl;
+    return true;
+}
+
+std::string QueryServer::handle(std::string_view request)
+{
+    auto start = std::chrono::steady_clock::now();
+    std::map<std::string, std::string> fields;
+    QueryOp op = OpInvalid;
+    std::string reply;
+    if (!parseRequest(request, fields)) {
+        reply = errorReply("request is not a JSON object");
+    } else {
+        const std::string& name = fields["op"];
+        if (name == "position") {
+            op = OpPosition;
+            reply = positionQuery(fields);
+        } else if (name == "explorer") {
+            op = OpExplorer;
+            reply = explorerQuery(fields);
+        } else if (name == "game") {
+            op = OpGame;
+            reply = gameQuery(fields);
+        } else if (name == "stats") {
+            op = OpStats;
+            reply = statsQuery();
+        } else {
+            reply = errorReply("unknown op");
+        }
+    }
+    _latency[op].record(uint64_t(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count()));
+    return reply;
+}
+
+std::string QueryServer::positionQuery(const std::map<std::string, std::string>& fields)
+{
+    if (!_hasIndex) return errorReply("the database has no position index");
+    GameState position;
+    if (!positionFromFields(fields, position)) return errorReply("could not parse the fen");
+    uint64_t limit = 20;
+    if (fields.count("limit") && !numberField(fields, "limit", limit)) return errorReply("limit is not a number");
+    std::vector<PositionHit> hits;
+    const uint32_t total = _index.find(position.positionKey(), hits, limit);
+
+    std::ostringstream json;
+    json << "{\"ok\":true,\"count\":" << total << ",\"hits\":[";
+    for (size_t i = 0; i < hits.size(); i++) {
+        json << (i ? "," : "") << "{\"game\":" << hits[i].game << ",\"ply\":" << hits[i].ply << ",\"white\":";
+        writeString(json, _database.white(hits[i].game));
+        json << ",\"black\":";
+        writeString(json, _database.black(hits[i].game));
+        json << "}";
+    }
+    json << "]}";
+    return json.str();
+}
+
+std::string QueryServer::explorerQuery(const std::map<std::string, std::string>& fields)
+{
+    if (!_explorer.isOpen()) return errorReply("the database has no opening explorer");
+    GameState position;
+    if (!positionFromFields(fields, position)) return errorReply("could not parse the fen");
+    const std::span<const ExplorerMove> moves = _explorer.moves(position.positionKey());
+
+    std::ostringstream json;
+    json << "{\"ok\":true,\"moves\":[";
+    for (size_t i = 0; i < moves.size(); i++) {
+        const ExplorerMove& move = moves[i];
+        json << (i ? "," : "") << "{\"move\":\"" << GameState::moveToUCI(move.move) << "\",\"games\":" << move.games
+             << ",\"white\":" << move.whiteWins << ",\"draws\":" << move.draws << ",\"black\":" << move.blackWins
+             << ",\"rating\":" << move.averageRating << ",\"lastPlayed\":" << move.lastPlayed << "}";
+    }
+    json << "]}";
+    return json.str();
+}
+
+std::string QueryServer::gameQuery(const std::map<std::string, std::string>& fields)
+{
+    uint64_t game = 0;
+    if (!numberField(fields, "id", game)) return errorReply("id is not a game number");
+    if (game >= _database.size()) return errorReply("no such game");
+    GameState position;
+    std::vector<BitMove> moves;
+    const bool decoded = _database.decode(game, position, moves);
+    const GameHeader header = _database.header(game);
+
+    std::ostringstream json;
+    json << "{\"ok\":true,\"id\":" << game << ",\"white\":";
+    writeString(json, header.white);
+    json << ",\"black\":";
+    writeString(json, header.black);
+    json << ",\"event\":";
+    writeString(json, header.event);
+    json << ",\"site\":";
+    writeString(json, header.site);
+    json << ",\"date\":" << header.date << ",\"whiteElo\":" << header.whiteElo << ",\"blackElo\":" << header.blackElo
+         << ",\"result\":\"" << (header.result == 1 ? "1-0" : header.result == -1 ? "0-1" : header.result == 0 ? "1/2-1/2" : "*")
+         << "\",\"eco\":\"" << ecoToString(header.eco) << "\",\"complete\":" << (decoded ? "true" : "false")
+         << ",\"moves\":[";
+    for (size_t i = 0; i < moves.size(); i++) {
+        json << (i ? ",\"" : "\"") << GameState::moveToUCI(moves[i]) << "\"";
+    }
+    json << "]}";
+    return json.str();
+}
+
+std::string QueryServer::statsQuery()
+{
+    std::ostringstream json;
+    json << "{\"ok\":true,\"latencyMicros\":{";
+    for (int op = 0; op < OpCount; op++) {
+        const LatencyHistogram& latency = _latency[op];
+        json << (op ? "," : "") << "\"" << OpNames[op] << "\":{\"count\":" << latency.total
+             << ",\"p50\":" << latency.percentile(0.5) << ",\"p90\":" << latency.percentile(0.9)
+             << ",\"p99\":" << latency.percentile(0.99) << ",\"max\":" << latency.maxMicros << ",\"buckets\":[";
+        // trailing empty buckets are left out, bucket b counts requests under 2^b microseconds
+        int used = LatencyHistogram::Buckets;
+        while (used > 0 && latency.counts[used - 1] == 0) {
+            used--;
+        }
+        for (int bucket = 0; bucket < used; bucket++) {
+            json << (bucket ? "," : "") << latency.counts[bucket];
+        }
+        json << "]}";
+    }
+    json << "}}";
+    return json.str();
+}
+
+#ifndef _WIN32
+
+bool QueryServer::run(std::ostream& log)
+{
+    const int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (listener < 0 || _options.socketPath.size() >= sizeof(address.sun_path)) {
+        log << "could not create a socket at " << _options.socketPath << std::endl;
+        if (listener >= 0) ::close(listener);
+        return false;
+    }
+    std::strncpy(address.sun_path, _options.socketPath.c_str(), sizeof(address.sun_path) - 1);
+    // only a socket file left by a server that did not shut down cleanly is removed, a path that is not a socket
+    // or a socket some server still accepts on is left alone
+    struct stat existing;
+    if (lstat(_options.socketPath.c_str(), &existing) == 0) {
+        const int probe = S_ISSOCK(existing.st_mode) ? socket(AF_UNIX, SOCK_STREAM, 0) : -1;
+        const bool live = probe >= 0 && connect(probe, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0;
+        const bool stale = probe >= 0 && !live && errno == ECONNREFUSED;
+        if (probe >= 0) ::close(probe);
+        if (!stale || unlink(_options.socketPath.c_str()) != 0) {
+            log << _options.socketPath << (live ? " is in use by another server"
+                : S_ISSOCK(existing.st_mode) ? " could not be replaced" : " exists and is not a socket") << std::endl;
+            ::close(listener);
+            return false;
+        }
+    }
+    if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, 64) != 0) {
+        log << "could not listen on " << _options.socketPath << std::endl;
+        ::close(listener);
+        return false;
+    }
+    // a client that disconnects mid reply must not end the server
+    signal(SIGPIPE, SIG_IGN);
+
+    if (pipe(_wakePipe) != 0) {
+        log << "could not create a pipe" << std::endl;
+        ::close(listener);
+        return false;
+    }
+    fcntl(_wakePipe[0], F_SETFL, O_NONBLOCK);
+
+    std::vector<std::thread> workers;
+    for (int i = 0; i < _options.threads; i++) {
+        workers.emplace_back([this]() {
+            for (;;) {
+                std::unique_lock<std::mutex> lock(_queueMutex);
+                _queueReady.wait(lock, [this]() { return !_ready.empty(); });
+                Connection connection = std::move(_ready.front());
+                _ready.pop_front();
+                lock.unlock();
+                if (connection.socket < 0) return;
+                const bool open = serve(connection);
+                lock.lock();
+                if (open) {
+                    _returned.push_back(std::move(connection));
+                } else {
+                    ::close(connection.socket);
+                    _openConnections--;
+                }
+                lock.unlock();
+                const char wake = 0;
+                if (write(_wakePipe[1], &wake, 1) < 0) { }
+            }
+        });
+    }
+    log << "listening on " << _options.socketPath << " with " << _options.threads << " workers" << std::endl;
+
+    // only idle connections are polled, one a worker is serving comes back through _returned
+    std::vector<Connection> idle;
+    std::vector<pollfd> polled;
+    for (;;) {
+        bool full;
+        {
+            std::lock_guard<std::mutex> lock(_queueMutex);
+            for (Connection& connection : _returned) {
+                idle.push_back(std::move(connection));
+            }
+            _returned.clear();
+            full = _openConnections >= _options.maxConnections;
+        }
+        // at the connection limit new clients wait in the listen backlog until one closes
+        polled.assign({ { listener, short(full ? 0 : POLLIN), 0 }, { _wakePipe[0], POLLIN, 0 } });
+        for (const Connection& connection : idle) {
+            polled.push_back({ connection.socket, POLLIN, 0 });
+        }
+        if (poll(polled.data(), polled.size(), -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (polled[1].revents) {
+            char drained[64];
+            while (read(_wakePipe[0], drained, sizeof(drained)) > 0) { }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(_queueMutex);
+            size_t kept = 0;
+            for (size_t i = 0; i < idle.size(); i++) {
+                if (polled[i + 2].revents) {
+                    _ready.push_back(std::move(idle[i]));
+                    _queueReady.notify_one();
+                } else {
+                    if (kept != i) idle[kept] = std::move(idle[i]);
+                    kept++;
+                }
+            }
+            idle.resize(kept);
+        }
+
+        if (polled[0].revents & (POLLERR | POLLNVAL)) break;
+        if (polled[0].revents & POLLIN) {
+            const int client = accept(listener, nullptr, nullptr);
+            if (client < 0) {
+                if (errno == EINTR || errno == ECONNABORTED) continue;
+                break;
+            }
+            const timeval timeout = { SendTimeoutSeconds, 0 };
+            setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+            idle.push_back({ client, std::string() });
+            std::lock_guard<std::mutex> lock(_queueMutex);
+            _openConnections++;
+        }
+    }
+
+    // a negative socket tells a worker to stop, connections still open are closed after the workers are done
+    {
+        std::lock_guard<std::mutex> lock(_queueMutex);
+        for (size_t i = 0; i < workers.size(); i++) {
+            _ready.push_back({ -1, std::string() });
+        }
+        _queueReady.notify_all();
+    }
+    for (auto& thread : workers) {
+        thread.join();
+    }
+    for (const Connection& connection : idle) {
+        ::close(connection.socket);
+    }
+    for (const Connection& connection : _returned) {
+        ::close(connection.socket);
+    }
+    _returned.clear();
+    _openConnections = 0;
+    ::close(_wakePipe[0]);
+    ::close(_wakePipe[1]);
+    ::close(listener);
+    unlink(_options.socketPath.c_str());
+    return true;
+}
+
+static bool sendAll(int socket, const std::string& data)
+{
+    for (size_t sent = 0; sent < data.size(); ) {
+        const ssize_t written = send(socket, data.data() + sent, data.size() - sent, 0);
+        if (written <= 0) return false;
+        sent += size_t(written);
+    }
+    return true;
+}
+
+bool QueryServer::serve(Connection& connection)
+{
+    char buffer[4096];
+    for (;;) {
+        const ssize_t received = recv(connection.socket, buffer, sizeof(buffer), MSG_DONTWAIT);
+        if (received == 0) return false;
+        if (received < 0) {
+            if (errno == EINTR) continue;
+            // everything sent so far is answered, the connection goes back to being polled
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        connection.pending.append(buffer, size_t(received));
+        size_t end;
+        while ((end = connection.pending.find('\n')) != std::string::npos) {
+            const std::string_view line(connection.pending.data(), end);
+            if (!line.empty() && !sendAll(connection.socket, handle(line) + "\n")) return false;
+            connection.pending.erase(0, end + 1);
+        }
+        if (connection.pending.size() > MaxRequestBytes) {
+            sendAll(connection.socket, errorReply("request line too long") + "\n");
+            return false;
+        }
+    }
+}
+
+std::string queryServer(const std::string& socketPath, const std::string& request)
+{
+    const int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+    std::string reply;
+    if (server >= 0 && connect(server, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0 && sendAll(server, request + "\n")) {
+        char buffer[4096];
+        ssize_t received;
+        while (reply.find('\n') == std::string::npos && (received = recv(server, buffer, sizeof(buffer), 0)) > 0) {
+            reply.append(buffer, size_t(received));
+        }
+        reply = reply.substr(0, reply.find('\n'));
+    }
+    if (server >= 0) ::close(server);
+    return reply;
+}
+
+#else
+
+bool QueryServer::run(std::ostream& log)
+{
+    log << "the query server needs Unix domain sockets, which this build does not support" << std::endl;
+    return false;
+}
+
+bool QueryServer::serve(Connection& connection)
+{
+    return false;
+}
+
+std::string queryServer(const std::string& socketPath, const std::string& request)
+{
+    return std::string();
+}
+
+#endif
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "GameDatabase.h"
+#include "OpeningExplorer.h"
+#include "PositionIndex.h"
+
+//
+// line delimited JSON over a Unix domain socket, one request object per line and one reply per request:
+//   {"op":"position","fen":"...","limit":20}   games reaching the position, needs base.positions
+//   {"op":"explorer","fen":"..."}              moves played from the position, needs base.explorer
+//   {"op":"game","id":12345}                   headers and UCI moves of a game
+//   {"op":"stats"}                             request counts and latency percentiles per op
+// every reply has "ok", failed requests carry "error" instead of the result
+//
+
+struct QueryServerOptions {
+    std::string socketPath = "chessdb.sock";
+    int threads = 4;                // workers answering requests
+    int maxConnections = 256;       // open at once, more clients wait in the listen backlog
+};
+
+// latencies in power of two microsecond buckets, updated without locks by any thread
+struct LatencyHistogram {
+    static constexpr int Buckets = 32;
+    std::array<std::atomic<uint64_t>, Buckets> counts = {};
+    std::atomic<uint64_t> total{0};
+    std::atomic<uint64_t> maxMicros{0};
+
+    void record(uint64_t micros);
+    // upper bound of the bucket holding the given fraction of the requests
+    uint64_t percentile(double fraction) const;
+};
+
+//
+// serves one database to many clients: the files are mapped once and shared by a fixed pool of workers,
+// the accepting thread polls every idle connection and hands the ones with input to the pool, so an idle
+// client never holds a worker
+//
+class QueryServer
+{
+public:
+    QueryServer(const QueryServerOptions& options);
+
+    // the game database is required, the position index and explorer are used when present
+    bool open(const std::string& basePath, std::ostream& log);
+    // blocks serving clients, false when the socket cannot be set up
+    bool run(std::ostream& log);
+
+    // one request line to one reply line, public so it can be used without a socket
+    std::string handle(std::string_view request);
+
+private:
+    // a client socket and the start of a request line that has not fully arrived
+    struct Connection {
+        int socket;
+        std::string pending;
+    };
+    // answers the complete lines the client has sent so far, false once the connection should be closed
+    bool serve(Connection& connection);
+    std::string positionQuery(const std::map<std::string, std::string>& fields);
+    std::string explorerQuery(const std::map<std::string, std::string>& fields);
+    std::string gameQuery(const std::map<std::string, std::string>& fields);
+    std::string statsQuery();
+
+    QueryServerOptions _options;
+    GameDatabase _database;
+    PositionIndex _index;
+    OpeningExplorer _explorer;
+    bool _hasIndex;
+
+    std::mutex _queueMutex;
+    std::condition_variable _queueReady;
+    std::deque<Connection> _ready;          // connections with input, a negative socket stops a worker
+    std::vector<Connection> _returned;      // served and still open, to be polled again
+    int _openConnections;
+    int _wakePipe[2];                       // written by the workers so the poll loop picks up _returned
+
+    enum QueryOp { OpPosition, OpExplorer, OpGame, OpStats, OpInvalid, OpCount };
+    LatencyHistogram _latency[OpCount];
+};
+
+// connects to a server, sends one request line and returns the reply, empty when the server cannot be reached
+std::string queryServer(const std::string& socketPath, const std::string& request);
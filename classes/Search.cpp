@@ -0,0 +1,375 @@
+#include <algorithm>
+#include <cstring>
+#include "Search.h"
+
+Search::Search(size_t hashMegabytes)
+{
+    // round down to a power of two so the index is a mask
+    size_t entries = std::max<size_t>(1, hashMegabytes) * 1024 * 1024 / sizeof(TTEntry);
+    size_t size = 1;
+    while (size * 2 <= entries) {
+        size *= 2;
+    }
+    _table.resize(size);
+    _tableMask = size - 1;
+    _stop = false;
+    _pondering = false;
+    _limitsActive = true;
+    _completedDepth = 0;
+    _canStop = false;
+    _nodes = 0;
+    clear();
+}
+
+void Search::clear()
+{
+    std::fill(_table.begin(), _table.end(), TTEntry{});
+    for (auto& killers : _killers) {
+        killers[0] = BitMove();
+        killers[1] = BitMove();
+    }
+    std::memset(_history, 0, sizeof(_history));
+}
+
+TTEntry* Search::probe(uint64_t key)
+{
+    TTEntry* entry = &_table[key & _tableMask];
+    return entry->key == key && entry->bound != TTNone ? entry : nullptr;
+}
+
+void Search::store(uint64_t key, const BitMove& move, int score, int depth, int bound, int ply)
+{
+    // mate scores are stored relative to this node, not the root
+    if (score > MATE_BOUND) score += ply;
+    if (score < -MATE_BOUND) score -= ply;
+
+    TTEntry& entry = _table[key & _tableMask];
+    entry.key = key;
+    entry.move = move;
+    entry.score = static_cast<int16_t>(score);
+    entry.depth = static_cast<int8_t>(depth);
+    entry.bound = static_cast<uint8_t>(bound);
+}
+
+void Search::checkLimits()
+{
+    if (!_canStop || (_nodes & 1023) != 0) return;
+    if (!_limitsActive) {
+        if (_pondering || _limits.infinite) return;
+        _limitsActive = true;
+        _startTime = std::chrono::steady_clock::now();
+    }
+    // a ponder hit can arrive after the search is already deeper than it was asked to go
+    if (_completedDepth >= _limits.depth) {
+        _stop = true;
+    }
+    if (_limits.nodes && _nodes >= _limits.nodes) {
+        _stop = true;
+    }
+    if (_limits.moveTimeMs) {
+        auto elapsed = std::chrono::steady_clock::now() - _startTime;
+        if (std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count() >= _limits.moveTimeMs) {
+            _stop = true;
+        }
+    }
+}
+
+// most valuable victim, least valuable attacker
+static int captureOrder(const GameState& position, const BitMove& move)
+{
+    int victim = move.isEnPassant() ? Pawn : position.pieceAt(move.to());
+    if (move.isPromotion()) victim += move.promotion();
+    return victim * 8 - position.movedPiece(move);
+}
+
+// below every quiet move, history scores never go negative
+constexpr int LosingCaptureScore = -100000;
+// history saturates under the second killer, so no quiet move is ordered ahead of a killer or a good capture
+constexpr int HistoryMax = 60000;
+
+void Search::scoreMoves(GameState& position, const std::vector<BitMove>& moves, std::vector<int>& scores, const BitMove& ttMove, int ply)
+{
+    scores.resize(moves.size());
+    for (size_t i = 0; i < moves.size(); i++) {
+        const BitMove& move = moves[i];
+        if (move == ttMove) {
+            scores[i] = 1000000;
+        } else if (position.isTactical(move)) {
+            // captures that lose material on the exchange go after the quiet moves
+            scores[i] = (position.see(move) >= 0 ? 100000 : LosingCaptureScore) + captureOrder(position, move);
+        } else if (move == _killers[ply][0]) {
+            scores[i] = 90000;
+        } else if (move == _killers[ply][1]) {
+            scores[i] = 80000;
+        } else {
+            scores[i] = _history[move.from()][move.to()];
+        }
+    }
+}
+
+// selection sort one step at a time, most nodes cut off after a move or two
+void Search::pickNextMove(std::vector<BitMove>& moves, std::vector<int>& scores, size_t index)
+{
+    size_t best = index;
+    for (size_t i = index + 1; i < moves.size(); i++) {
+        if (scores[i] > scores[best]) best = i;
+    }
+    if (best != index) {
+        std::swap(moves[index], moves[best]);
+        std::swap(scores[index], scores[best]);
+    }
+}
+
+int Search::quiesce(GameState& position, int alpha, int beta, int ply)
+{
+    _nodes++;
+    _stats.qnodes++;
+    _stats.selDepth = std::max(_stats.selDepth, ply);
+    checkLimits();
+    if (_stop) return 0;
+
+    int standPat = position.evaluate();
+    if (ply >= MAX_PLY - 1 || standPat >= beta) {
+        return standPat;
+    }
+    alpha = std::max(alpha, standPat);
+
+    auto moves = position.generateAllMoves();
+    moves.erase(std::remove_if(moves.begin(), moves.end(), [&](const BitMove& move) {
+        return !position.isTactical(move);
+    }), moves.end());
+
+    std::vector<int> scores;
+    scoreMoves(position, moves, scores, BitMove(), ply);
+    for (size_t i = 0; i < moves.size(); i++) {
+        pickNextMove(moves, scores, i);
+        const BitMove& move = moves[i];
+        // everything left loses material, standing pat is already at least as good
+        if (scores[i] < 0) break;
+
+        position.pushMove(move);
+        int score = -quiesce(position, -beta, -alpha, ply + 1);
+        position.popMove();
+
+        if (_stop) return 0;
+        if (score >= beta) return score;
+        alpha = std::max(alpha, score);
+    }
+    return alpha;
+}
+
+int Search::negamax(GameState& position, int depth, int alpha, int beta, int ply)
+{
+    _pvLength[ply] = ply;
+    if (depth <= 0) {
+        return quiesce(position, alpha, beta, ply);
+    }
+
+    _nodes++;
+    _stats.nodes++;
+    _stats.selDepth = std::max(_stats.selDepth, ply);
+    checkLimits();
+    if (_stop) return 0;
+    if (ply >= MAX_PLY - 1) return position.evaluate();
+    // a repeated position is scored as a draw the first time it comes back, the cycle gains nothing
+    if (ply > 0 && (position.isRepetition() || position.isFiftyMoveDraw() || position.hasInsufficientMaterial())) return 0;
+
+    BitMove ttMove;
+    _stats.ttProbes++;
+    if (TTEntry* entry = probe(position.hash)) {
+        _stats.ttHits++;
+        ttMove = entry->move;
+        int score = entry->score;
+        if (score > MATE_BOUND) score -= ply;
+        if (score < -MATE_BOUND) score += ply;
+        if (ply > 0 && entry->depth >= depth &&
+            (entry->bound == TTExact ||
+             (entry->bound == TTLower && score >= beta) ||
+             (entry->bound == TTUpper && score <= alpha))) {
+            _stats.ttCutoffs++;
+            return score;
+        }
+    }
+
+    auto moves = position.generateAllMoves();
+    if (moves.empty()) {
+        return position.isInCheck() ? -MATE_SCORE + ply : 0;
+    }
+
+    std::vector<int> scores;
+    scoreMoves(position, moves, scores, ttMove, ply);
+
+    const int originalAlpha = alpha;
+    int bestScore = -INFINITE_SCORE;
+    BitMove bestMove;
+    for (size_t i = 0; i < moves.size(); i++) {
+        pickNextMove(moves, scores, i);
+        const BitMove& move = moves[i];
+        if (ply == 0 && std::find(_excludedRootMoves.begin(), _excludedRootMoves.end(), move) != _excludedRootMoves.end()) {
+            continue;
+        }
+        const bool isTactical = position.isTactical(move);
+        // a capture that loses the exchange gets a reduced null window look first
+        const bool reduce = scores[i] < 0 && i > 0 && depth >= _params.losingCaptureMinDepth && !position.isInCheck();
+
+        position.pushMove(move);
+        int score;
+        if (reduce) {
+            score = -negamax(position, depth - 1 - _params.losingCaptureReduction, -alpha - 1, -alpha, ply + 1);
+            if (score > alpha && !_stop) {
+                score = -negamax(position, depth - 1, -beta, -alpha, ply + 1);
+            }
+        } else {
+            score = -negamax(position, depth - 1, -beta, -alpha, ply + 1);
+        }
+        position.popMove();
+
+        if (_stop) return 0;
+        if (score <= bestScore) continue;
+
+        bestScore = score;
+        bestMove = move;
+        if (score <= alpha) continue;
+
+        alpha = score;
+        _pv[ply][ply] = move;
+        for (int next = ply + 1; next < _pvLength[ply + 1]; next++) {
+            _pv[ply][next] = _pv[ply + 1][next];
+        }
+        _pvLength[ply] = _pvLength[ply + 1];
+
+        if (alpha >= beta) {
+            _stats.failHighs++;
+            if (i == 0) _stats.failHighsFirst++;
+            if (!isTactical) {
+                if (!(move == _killers[ply][0])) {
+                    _killers[ply][1] = _killers[ply][0];
+                    _killers[ply][0] = move;
+                }
+                int& history = _history[move.from()][move.to()];
+                history = std::min(history + depth * depth, HistoryMax);
+            }
+            break;
+        }
+    }
+
+    // a root searched without some of its moves says nothing reliable about the position
+    if (ply > 0 || _excludedRootMoves.empty()) {
+        int bound = bestScore >= beta ? TTLower : (bestScore > originalAlpha ? TTExact : TTUpper);
+        store(position.hash, bestMove, bestScore, depth, bound, ply);
+    }
+    return bestScore;
+}
+
+// starts with a narrow window around the previous iteration's score and widens the side that fails
+int Search::searchRoot(GameState& root, int depth, const PVLine* previous)
+{
+    if (!_limits.aspiration || !previous || depth < _params.aspirationMinDepth || std::abs(previous->score) > MATE_BOUND) {
+        return negamax(root, depth, -INFINITE_SCORE, INFINITE_SCORE, 0);
+    }
+
+    int delta = std::max(1, _params.aspirationWindow);
+    int alpha = std::max(previous->score - delta, -INFINITE_SCORE);
+    int beta = std::min(previous->score + delta, INFINITE_SCORE);
+    for (;;) {
+        int score = negamax(root, depth, alpha, beta, 0);
+        if (_stop) return score;
+        delta *= 2;
+        if (score <= alpha) {
+            _stats.aspirationFailLows++;
+            // a mate score can be anywhere beyond the bound, so stop guessing
+            alpha = score <= -MATE_BOUND ? -INFINITE_SCORE : std::max(score - delta, -INFINITE_SCORE);
+        } else if (score >= beta) {
+            _stats.aspirationFailHighs++;
+            beta = score >= MATE_BOUND ? INFINITE_SCORE : std::min(score + delta, INFINITE_SCORE);
+        } else {
+            return score;
+        }
+    }
+}
+
+SearchResult Search::think(const GameState& position, const SearchLimits& limits)
+{
+    SearchResult result;
+    _limits = limits;
+    _startTime = std::chrono::steady_clock::now();
+    _nodes = 0;
+    _stats.reset();
+    _stop = false;
+    // always finish the first iteration so there is a move to play
+    _canStop = false;
+    _limitsActive = !_pondering && !limits.infinite;
+    _completedDepth = 0;
+    // searches that follow without a clear() age the history, so old cutoffs fade instead of piling up
+    for (auto& row : _history) {
+        for (int& history : row) {
+            history /= 2;
+        }
+    }
+
+    GameState root = position;
+
+    auto rootMoves = root.generateAllMoves();
+    if (rootMoves.empty()) {
+        result.score = root.isInCheck() ? -MATE_SCORE : 0;
+        return result;
+    }
+    result.bestMove = rootMoves.front();
+
+    _limits.depth = std::clamp(limits.depth, 1, MAX_PLY - 1);
+    const size_t lineCount = std::clamp<size_t>(limits.multiPV, 1, rootMoves.size());
+    for (int depth = 1; depth < MAX_PLY; depth++) {
+        const uint64_t nodesBefore = _nodes;
+        // every pass searches the root without the moves found by the passes before it,
+        // the transposition table carries over so later passes are cheaper than the first
+        std::vector<PVLine> lines;
+        _excludedRootMoves.clear();
+        while (lines.size() < lineCount) {
+            PVLine line;
+            line.depth = depth;
+            const PVLine* previous = lines.size() < result.lines.size() ? &result.lines[lines.size()] : nullptr;
+            line.score = searchRoot(root, depth, previous);
+            if (_stop) break;
+            line.pv.assign(&_pv[0][0], &_pv[0][0] + _pvLength[0]);
+            if (line.pv.empty()) break;
+            _excludedRootMoves.push_back(line.pv.front());
+            lines.push_back(line);
+        }
+        _excludedRootMoves.clear();
+        if (_stop || lines.empty()) break;
+        std::stable_sort(lines.begin(), lines.end(), [](const PVLine& a, const PVLine& b) { return a.score > b.score; });
+        const int score = lines.front().score;
+
+        IterationStats iteration;
+        iteration.depth = depth;
+        iteration.score = score;
+        iteration.nodes = _nodes - nodesBefore;
+        iteration.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - _startTime).count();
+        _stats.iterations.push_back(iteration);
+
+        result.depth = depth;
+        result.score = score;
+        result.pv = lines.front().pv;
+        result.bestMove = result.pv.front();
+        result.lines = std::move(lines);
+        _completedDepth = depth;
+        _canStop = true;
+        if (_onIteration) {
+            result.nodes = _nodes;
+            result.seconds = iteration.seconds;
+            _onIteration(result);
+        }
+        // no point searching deeper once a forced mate is found, unless pondering or analysing keeps it going
+        const bool limited = !_pondering && !limits.infinite;
+        if (limited && std::abs(score) > MATE_BOUND) break;
+        if (limited && depth >= _limits.depth) break;
+        // the next iteration would take several times as long as this one, don't start what can't finish
+        if (_limitsActive && _limits.moveTimeMs && iteration.seconds * 1000.0 >= _limits.moveTimeMs * _params.iterationTimePercent / 100.0) break;
+    }
+
+    result.nodes = _nodes;
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - _startTime).count();
+    _stats.seconds = result.seconds;
+    result.stats = _stats;
+    return result;
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "GameState.h"
+#include "SearchStats.h"
+
+// scores are kept well inside 16 bits so they fit in a transposition table entry
+// and can always be negated safely
+constexpr int INFINITE_SCORE = 32000;
+constexpr int MATE_SCORE = 31000;
+// per ply tables are sized for this, far deeper than any real search reaches
+constexpr int MAX_PLY = 128;
+constexpr int MATE_BOUND = MATE_SCORE - 2 * MAX_PLY; // anything above this is a forced mate
+
+struct SearchLimits {
+    int depth = 5;              // the Chess AI has always looked 5 plies ahead
+    uint64_t nodes = 0;         // 0 means no node limit
+    int moveTimeMs = 0;         // 0 means no time limit
+    bool infinite = false;      // ignore every limit and run until stop()
+    int multiPV = 1;            // number of best root moves to report, each costs a full root search
+    bool aspiration = true;     // narrow root windows around the previous iteration's score
+};
+
+// constants of the search heuristics, named in the SearchOptions registry so they can be set and tuned
+struct SearchParams {
+    int aspirationWindow = 25;      // half width of the first aspiration window in centipawns, doubled after every failure
+    int aspirationMinDepth = 4;
+    int losingCaptureMinDepth = 3;  // losing captures closer to the horizon are searched at full depth
+    int losingCaptureReduction = 1; // plies taken off a losing capture's first, null window look
+    int iterationTimePercent = 100; // with a move time, no new iteration starts after this share of it
+};
+
+// one of the best root moves with the line that follows it
+struct PVLine {
+    int score = 0;
+    int depth = 0;
+    std::vector<BitMove> pv;
+};
+
+struct SearchResult {
+    BitMove bestMove;           // null when the side to move has no legal moves
+    int score = 0;              // from the side to move's point of view
+    int depth = 0;              // last fully completed iteration
+    uint64_t nodes = 0;
+    double seconds = 0.0;
+    std::vector<BitMove> pv;
+    std::vector<PVLine> lines;  // best first, pv and score above are lines[0]
+    SearchStats stats;
+};
+
+enum TTBound : uint8_t {
+    TTNone,
+    TTExact,
+    TTLower,
+    TTUpper
+};
+
+struct TTEntry {
+    uint64_t key;
+    BitMove move;
+    int16_t score;
+    int8_t depth;
+    uint8_t bound;
+};
+
+//
+// iterative deepening alpha-beta search over a GameState
+// one Search per thread, it owns its transposition table and move ordering tables
+//
+class Search
+{
+public:
+    Search(size_t hashMegabytes = 16);
+
+    SearchResult think(const GameState& position, const SearchLimits& limits);
+    // safe to call from another thread, the search returns its last completed iteration
+    void stop() { _stop = true; }
+
+    // while pondering the limits are ignored, set it before think() starts on the ponder thread
+    void setPondering(bool pondering) { _pondering = pondering; }
+    // the expected move was played: the limits apply from now on, counting the work already done
+    void ponderHit() { _pondering = false; }
+    bool isPondering() const { return _pondering; }
+
+    // called on the searching thread after every completed iteration
+    void setIterationCallback(std::function<void(const SearchResult&)> callback) { _onIteration = std::move(callback); }
+    void setParams(const SearchParams& params) { _params = params; }
+    const SearchParams& params() const { return _params; }
+    // forget everything learned from previous searches
+    void clear();
+
+private:
+    int searchRoot(GameState& root, int depth, const PVLine* previous);
+    int negamax(GameState& position, int depth, int alpha, int beta, int ply);
+    int quiesce(GameState& position, int alpha, int beta, int ply);
+
+    void scoreMoves(GameState& position, const std::vector<BitMove>& moves, std::vector<int>& scores, const BitMove& ttMove, int ply);
+    void pickNextMove(std::vector<BitMove>& moves, std::vector<int>& scores, size_t index);
+    void checkLimits();
+
+    TTEntry* probe(uint64_t key);
+    void store(uint64_t key, const BitMove& move, int score, int depth, int bound, int ply);
+
+    std::vector<TTEntry> _table;
+    uint64_t _tableMask;
+
+    BitMove _killers[MAX_PLY][2];
+    int _history[64][64];
+    BitMove _pv[MAX_PLY + 1][MAX_PLY + 1];
+    int _pvLength[MAX_PLY + 1];
+
+    std::atomic<bool> _stop;
+    std::atomic<bool> _pondering;
+    bool _limitsActive;         // false until pondering ends, the clock starts when it does
+    int _completedDepth;
+    bool _canStop;
+    uint64_t _nodes;
+    SearchStats _stats;
+    SearchLimits _limits;
+    SearchParams _params;
+    std::chrono::steady_clock::time_point _startTime;
+    std::function<void(const SearchResult&)> _onIteration;
+    // root moves already reported by earlier multi pv passes of this iteration
+    std::vector<BitMove> _excludedRootMoves;
+};
@@ -0,0 +1,53 @@
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
+#include "SearchOptions.h"
+
+const std::vector<SearchOption>& searchOptions()
+{
+    static const std::vector<SearchOption> options = {
+        { "AspirationWindow", &SearchParams::aspirationWindow, 5, 200, 5.0 },
+        { "AspirationMinDepth", &SearchParams::aspirationMinDepth, 1, 10, 0.5 },
+        { "LosingCaptureMinDepth", &SearchParams::losingCaptureMinDepth, 2, 8, 0.5 },
+        { "LosingCaptureReduction", &SearchParams::losingCaptureReduction, 0, 3, 0.5 },
+        { "IterationTimePercent", &SearchParams::iterationTimePercent, 20, 100, 5.0, true },
+    };
+    return options;
+}
+
+const SearchOption* findSearchOption(const std::string& name)
+{
+    for (const SearchOption& option : searchOptions()) {
+        if (name == option.name) return &option;
+    }
+    return nullptr;
+}
+
+bool parseSearchParams(const std::string& text, SearchParams& params)
+{
+    std::istringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (item.empty()) continue;
+        const size_t equals = item.find('=');
+        if (equals == std::string::npos) return false;
+        const SearchOption* option = findSearchOption(item.substr(0, equals));
+        if (!option) return false;
+        const std::string value = item.substr(equals + 1);
+        char* end = nullptr;
+        const long number = std::strtol(value.c_str(), &end, 10);
+        if (value.empty() || *end != '\0') return false;
+        params.*option->field = static_cast<int>(std::clamp<long>(number, option->minimum, option->maximum));
+    }
+    return true;
+}
+
+std::string formatSearchParams(const SearchParams& params)
+{
+    std::string text;
+    for (const SearchOption& option : searchOptions()) {
+        if (!text.empty()) text += ",";
+        text += std::string(option.name) + "=" + std::to_string(params.*option.field);
+    }
+    return text;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "Search.h"
+
+// a named, bounded SearchParams field
+struct SearchOption {
+    const char* name;
+    int SearchParams::* field;
+    int minimum;
+    int maximum;
+    double step;                    // SPSA perturbation at the end of a tuning run
+    bool needsMoveTime = false;     // only read when the search has a move time
+};
+
+// every tunable search constant, in a fixed order
+const std::vector<SearchOption>& searchOptions();
+const SearchOption* findSearchOption(const std::string& name);
+
+// "name=value,name=value", values are clamped to the option's range, false on an unknown name or bad value
+bool parseSearchParams(const std::string& text, SearchParams& params);
+std::string formatSearchParams(const SearchParams& params);
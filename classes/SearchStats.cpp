@@ -0,0 +1,38 @@
+#include <cmath>
+#include <sstream>
+#include "SearchStats.h"
+
+double SearchStats::effectiveBranchingFactor() const
+{
+    if (iterations.size() < 2) return 0.0;
+    const IterationStats& first = iterations.front();
+    const IterationStats& last = iterations.back();
+    if (!first.nodes || last.depth <= first.depth) return 0.0;
+    return std::pow(double(last.nodes) / double(first.nodes), 1.0 / (last.depth - first.depth));
+}
+
+std::string SearchStats::toJSON() const
+{
+    std::ostringstream json;
+    json << "{\"nodes\":" << nodes
+         << ",\"qnodes\":" << qnodes
+         << ",\"nps\":" << (uint64_t)nps()
+         << ",\"seconds\":" << seconds
+         << ",\"selDepth\":" << selDepth
+         << ",\"tt\":{\"probes\":" << ttProbes << ",\"hits\":" << ttHits << ",\"cutoffs\":" << ttCutoffs << "}"
+         << ",\"failHighs\":" << failHighs
+         << ",\"aspiration\":{\"failLows\":" << aspirationFailLows << ",\"failHighs\":" << aspirationFailHighs << "}"
+         << ",\"firstMoveCutoffRate\":" << firstMoveCutoffRate()
+         << ",\"ebf\":" << effectiveBranchingFactor()
+         << ",\"iterations\":[";
+    for (size_t i = 0; i < iterations.size(); i++) {
+        const IterationStats& iteration = iterations[i];
+        json << (i ? "," : "")
+             << "{\"depth\":" << iteration.depth
+             << ",\"score\":" << iteration.score
+             << ",\"nodes\":" << iteration.nodes
+             << ",\"seconds\":" << iteration.seconds << "}";
+    }
+    json << "]}";
+    return json.str();
+}
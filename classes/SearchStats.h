@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// one entry per completed iterative deepening iteration
+struct IterationStats {
+    int depth = 0;
+    int score = 0;
+    uint64_t nodes = 0;             // nodes spent on this iteration alone
+    double seconds = 0.0;           // time since the search started
+};
+
+//
+// counters collected by a Search while it runs
+// plain integers bumped by the owning thread, cheap enough to leave on all the time
+//
+struct SearchStats {
+    uint64_t nodes = 0;             // interior nodes of the main search
+    uint64_t qnodes = 0;            // quiescence nodes
+    uint64_t ttProbes = 0;
+    uint64_t ttHits = 0;
+    uint64_t ttCutoffs = 0;
+    uint64_t failHighs = 0;
+    uint64_t failHighsFirst = 0;    // fail highs caused by the first move searched
+    uint64_t aspirationFailLows = 0;    // root searches repeated because the window was too high
+    uint64_t aspirationFailHighs = 0;   // root searches repeated because the window was too low
+    int selDepth = 0;               // deepest ply reached, quiescence included
+    double seconds = 0.0;
+    std::vector<IterationStats> iterations;
+
+    void reset() { *this = SearchStats(); }
+
+    uint64_t totalNodes() const { return nodes + qnodes; }
+    double nps() const { return seconds > 0.0 ? totalNodes() / seconds : 0.0; }
+    double ttHitRate() const { return ttProbes ? double(ttHits) / ttProbes : 0.0; }
+    double firstMoveCutoffRate() const { return failHighs ? double(failHighsFirst) / failHighs : 0.0; }
+    uint64_t aspirationResearches() const { return aspirationFailLows + aspirationFailHighs; }
+    // geometric mean growth of the per iteration node counts
+    double effectiveBranchingFactor() const;
+
+    std::string toJSON() const;
+};
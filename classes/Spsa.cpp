@@ -0,0 +1,109 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include "Spsa.h"
+
+// standard SPSA gain sequence exponents
+static const double Alpha = 0.602;
+static const double Gamma = 0.101;
+
+Spsa::Spsa(const SpsaOptions& options)
+    : _options(options)
+{
+    _options.threads = std::max(1, _options.threads);
+    _options.iterations = std::max(1, _options.iterations);
+    if (_options.gamesPerIteration <= 0) _options.gamesPerIteration = 2 * _options.threads;
+    _options.gamesPerIteration += _options.gamesPerIteration & 1;
+
+    for (const SearchOption& option : searchOptions()) {
+        // without a move time the engines never read it, its gradient would be pure noise
+        if (option.needsMoveTime && _options.limits.moveTimeMs == 0) continue;
+        if (_options.names.empty() || std::find(_options.names.begin(), _options.names.end(), option.name) != _options.names.end()) {
+            _tuned.push_back(&option);
+        }
+    }
+}
+
+SearchParams Spsa::run(std::ostream& log)
+{
+    const int iterations = _options.iterations;
+    const double stability = 0.1 * iterations;
+
+    // theta is kept as doubles, the engines play with it rounded
+    std::vector<double> theta;
+    for (const SearchOption* option : _tuned) {
+        theta.push_back(_options.start.*option->field);
+    }
+
+    std::ofstream trajectory;
+    if (!_options.logPath.empty()) {
+        trajectory.open(_options.logPath);
+        trajectory << "iteration,wins,draws,losses";
+        for (const SearchOption* option : _tuned) trajectory << "," << option->name;
+        trajectory << "\n";
+    }
+
+    std::mt19937_64 random(_options.seed);
+    std::ostream quiet(nullptr);
+    auto start = std::chrono::steady_clock::now();
+    int gamesPlayed = 0;
+    for (int k = 1; k <= iterations; k++) {
+        SearchParams plus = _options.start;
+        SearchParams minus = _options.start;
+        std::vector<double> steps(_tuned.size());
+        std::vector<int> flips(_tuned.size());
+        for (size_t i = 0; i < _tuned.size(); i++) {
+            const SearchOption& option = *_tuned[i];
+            // c_k = c / k^gamma with c chosen so the last step equals option.step
+            steps[i] = option.step * std::pow(double(iterations) / k, Gamma);
+            flips[i] = (random() & 1) ? 1 : -1;
+            plus.*option.field = std::clamp((int)std::lround(theta[i] + steps[i] * flips[i]), option.minimum, option.maximum);
+            minus.*option.field = std::clamp((int)std::lround(theta[i] - steps[i] * flips[i]), option.minimum, option.maximum);
+        }
+
+        MatchOptions matchOptions;
+        matchOptions.games = _options.gamesPerIteration;
+        matchOptions.threads = _options.threads;
+        matchOptions.bookPath = _options.bookPath;
+        matchOptions.randomPlies = _options.randomPlies;
+        matchOptions.seed = _options.seed * 1000003ULL + k;
+        matchOptions.maxPlies = _options.maxPlies;
+        matchOptions.sprt = false;
+
+        EngineConfig first{ "plus", _options.limits, _options.hashMegabytes, plus };
+        EngineConfig second{ "minus", _options.limits, _options.hashMegabytes, minus };
+        Match match(matchOptions, first, second);
+        const MatchStats stats = match.run(quiet);
+        gamesPlayed += stats.games();
+        const int result = stats.wins - stats.losses;
+
+        // a_k = a / (A + k)^alpha, scaled so the last learning rate r = a_k / c_k^2 equals learningRate
+        for (size_t i = 0; i < _tuned.size(); i++) {
+            const SearchOption& option = *_tuned[i];
+            const double a = _options.learningRate * option.step * option.step * std::pow(stability + iterations, Alpha);
+            const double rate = a / std::pow(stability + k, Alpha) / (steps[i] * steps[i]);
+            theta[i] = std::clamp(theta[i] + rate * steps[i] * result * flips[i], double(option.minimum), double(option.maximum));
+        }
+
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        log << std::fixed << std::setprecision(2) << "iteration " << k << " +" << stats.wins << " =" << stats.draws
+            << " -" << stats.losses << " |";
+        for (size_t i = 0; i < _tuned.size(); i++) log << " " << _tuned[i]->name << " " << theta[i];
+        log << " | " << std::setprecision(1) << (seconds > 0.0 ? gamesPlayed / seconds : 0.0) << " games/s" << std::endl;
+        if (trajectory) {
+            trajectory << k << "," << stats.wins << "," << stats.draws << "," << stats.losses;
+            for (double value : theta) trajectory << "," << value;
+            trajectory << std::endl;
+        }
+    }
+
+    SearchParams tuned = _options.start;
+    for (size_t i = 0; i < _tuned.size(); i++) {
+        tuned.*_tuned[i]->field = (int)std::lround(theta[i]);
+    }
+    log << "tuned --params " << formatSearchParams(tuned) << std::endl;
+    return tuned;
+}
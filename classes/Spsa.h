@@ -0,0 +1,41 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "Match.h"
+#include "SearchOptions.h"
+
+struct SpsaOptions {
+    std::vector<std::string> names;     // SearchOptions to tune, every registered one when empty
+    SearchParams start;                 // values the run starts from
+    int iterations = 200;
+    int gamesPerIteration = 0;          // 0 plays one game pair per thread, always rounded up to whole pairs
+    int threads = 1;
+    SearchLimits limits;                // per move, both sides
+    size_t hashMegabytes = 4;
+    std::string bookPath;
+    int randomPlies = 8;
+    uint64_t seed = 1;
+    int maxPlies = 300;
+    double learningRate = 0.002;        // r at the end of the run, as in fishtest's SPSA
+    std::string logPath;                // CSV trajectory, one row per iteration
+};
+
+//
+// simultaneous perturbation stochastic approximation over search parameters
+// every iteration flips all tuned values up or down by the current step, plays a mini match
+// of theta + c against theta - c on all threads and moves theta towards the side that scored better
+//
+class Spsa
+{
+public:
+    Spsa(const SpsaOptions& options);
+
+    // returns the tuned parameters, progress goes to log
+    SearchParams run(std::ostream& log);
+
+private:
+    SpsaOptions _options;
+    std::vector<const SearchOption*> _tuned;
+};
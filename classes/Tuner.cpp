@@ -0,0 +1,329 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <thread>
+#include "EvalParams.h"
+#include "PackedDataset.h"
+#include "Tuner.h"
+
+static const char* PieceNames[7] = { "none", "pawn", "knight", "bishop", "rook", "queen", "king" };
+// captures deeper than this are not worth resolving, the leaf is used as it stands
+static const int QuietMaxPly = 16;
+static const int QuietInfinity = 1000000;
+
+static int materialIndex(int piece) { return piece; }
+static int pieceSquareIndex(int piece, int square) { return 7 + piece * 64 + square; }
+
+static double nowSeconds()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// quiescence search with the evaluation the engine was built with, pv receives the capture sequence
+static int resolveQuiet(GameState& position, int alpha, int beta, int ply, std::vector<BitMove>& pv)
+{
+    pv.clear();
+    int standPat = position.evaluate();
+    if (ply >= QuietMaxPly || standPat >= beta) return standPat;
+    alpha = std::max(alpha, standPat);
+
+    auto moves = position.generateAllMoves();
+    std::vector<std::pair<int, BitMove>> ordered;
+    for (const BitMove& move : moves) {
+        if (!position.isTactical(move)) continue;
+        int gain = position.see(move);
+        if (gain >= 0) ordered.emplace_back(gain, move);
+    }
+    std::sort(ordered.begin(), ordered.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+
+    std::vector<BitMove> line;
+    for (const auto& [gain, move] : ordered) {
+        position.pushMove(move);
+        int score = -resolveQuiet(position, -beta, -alpha, ply + 1, line);
+        position.popMove();
+        if (score > alpha) {
+            alpha = score;
+            pv.assign(1, move);
+            pv.insert(pv.end(), line.begin(), line.end());
+            if (score >= beta) break;
+        }
+    }
+    return alpha;
+}
+
+Tuner::Tuner(const TunerOptions& options)
+    : _options(options)
+    , _params(7 + 7 * 64, 0.0)
+    , _tunable(7 + 7 * 64, false)
+{
+    _options.threads = std::max(1, _options.threads);
+    for (int piece = Pawn; piece <= King; piece++) {
+        _params[materialIndex(piece)] = EvalMaterial[piece];
+        // the king is always on the board, its material value cancels out
+        _tunable[materialIndex(piece)] = piece != King;
+        for (int square = 0; square < 64; square++) {
+            _params[pieceSquareIndex(piece, square)] = EvalPieceSquare[piece][square];
+            _tunable[pieceSquareIndex(piece, square)] = piece != Pawn || (square >= 8 && square < 56);
+        }
+    }
+}
+
+template <typename Work>
+void Tuner::parallel(Work work)
+{
+    const size_t slice = (_positions.size() + _options.threads - 1) / _options.threads;
+    std::vector<std::thread> workers;
+    for (int thread = 0; thread < _options.threads; thread++) {
+        const size_t begin = std::min(_positions.size(), thread * slice);
+        const size_t end = std::min(_positions.size(), begin + slice);
+        workers.emplace_back(work, begin, end, thread);
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+bool Tuner::loadPositions(std::ostream& log)
+{
+    PackedDataset dataset;
+    if (!dataset.open(_options.inputPath)) {
+        log << "could not map " << _options.inputPath << std::endl;
+        return false;
+    }
+
+    const uint64_t limit = _options.maxPositions ? _options.maxPositions : dataset.size();
+    const std::vector<uint32_t> order = dataset.blockOrder(0);
+    std::vector<std::vector<PackedPosition>> leaves(_options.threads);
+    std::atomic<uint64_t> taken(0);
+    const double start = nowSeconds();
+
+    std::vector<std::thread> workers;
+    for (int shard = 0; shard < _options.threads; shard++) {
+        workers.emplace_back([&, shard]() {
+            GameState position;
+            std::vector<BitMove> pv;
+            dataset.forEachInShard(order, shard, _options.threads, 0, [&](const PackedPosition& record) {
+                if (taken.load(std::memory_order_relaxed) >= limit) return;
+                if (!record.unpack(position) || position.isInCheck()) return;
+                if (taken++ >= limit) return;
+
+                resolveQuiet(position, -QuietInfinity, QuietInfinity, 0, pv);
+                for (const BitMove& move : pv) {
+                    position.pushMove(move);
+                }
+                PackedPosition leaf;
+                leaf.pack(position);
+                leaf.result = record.result;
+                leaves[shard].push_back(leaf);
+            });
+        });
+    }
+    for (auto& thread : workers) {
+        thread.join();
+    }
+
+    _positions.clear();
+    for (auto& shard : leaves) {
+        _positions.insert(_positions.end(), shard.begin(), shard.end());
+        std::vector<PackedPosition>().swap(shard);
+    }
+    const double seconds = nowSeconds() - start;
+    log << "resolved " << _positions.size() << " quiet positions in " << std::fixed << std::setprecision(1) << seconds
+        << "s (" << (uint64_t)(seconds > 0.0 ? _positions.size() / seconds : 0.0) << " positions/s)" << std::endl;
+    return !_positions.empty();
+}
+
+// white's point of view, the same sum GameState::evaluate makes with the constants in _params
+double Tuner::evaluate(const PackedPosition& leaf) const
+{
+    double value = 0.0;
+    int count = 0;
+    BitBoard(leaf.occupancy).forEachBit([&](int square) {
+        const int code = (leaf.pieces[count / 2] >> ((count & 1) * 4)) & 15;
+        count++;
+        const int piece = code & 7;
+        if (code & 8) {
+            value -= _params[materialIndex(piece)] + _params[pieceSquareIndex(piece, square ^ 56)];
+        } else {
+            value += _params[materialIndex(piece)] + _params[pieceSquareIndex(piece, square)];
+        }
+    });
+    return value;
+}
+
+double Tuner::error(double scale)
+{
+    const double k = scale * std::log(10.0) / 400.0;
+    std::vector<double> sums(_options.threads, 0.0);
+    parallel([&](size_t begin, size_t end, int thread) {
+        double sum = 0.0;
+        for (size_t i = begin; i < end; i++) {
+            const double target = (_positions[i].result + 1) * 0.5;
+            const double predicted = 1.0 / (1.0 + std::exp(-k * evaluate(_positions[i])));
+            sum += (target - predicted) * (target - predicted);
+        }
+        sums[thread] = sum;
+    });
+    double total = 0.0;
+    for (double sum : sums) total += sum;
+    return total / _positions.size();
+}
+
+double Tuner::gradient(double scale, std::vector<double>& gradient)
+{
+    const double k = scale * std::log(10.0) / 400.0;
+    std::vector<std::vector<double>> partials(_options.threads, std::vector<double>(_params.size(), 0.0));
+    std::vector<double> sums(_options.threads, 0.0);
+    parallel([&](size_t begin, size_t end, int thread) {
+        std::vector<double>& partial = partials[thread];
+        double sum = 0.0;
+        for (size_t i = begin; i < end; i++) {
+            const PackedPosition& leaf = _positions[i];
+            const double target = (leaf.result + 1) * 0.5;
+            const double predicted = 1.0 / (1.0 + std::exp(-k * evaluate(leaf)));
+            sum += (target - predicted) * (target - predicted);
+
+            // every parameter enters the evaluation with a coefficient of +1 or -1 per piece
+            const double slope = (predicted - target) * predicted * (1.0 - predicted) * k;
+            int count = 0;
+            BitBoard(leaf.occupancy).forEachBit([&](int square) {
+                const int code = (leaf.pieces[count / 2] >> ((count & 1) * 4)) & 15;
+                count++;
+                const int piece = code & 7;
+                if (code & 8) {
+                    partial[materialIndex(piece)] -= slope;
+                    partial[pieceSquareIndex(piece, square ^ 56)] -= slope;
+                } else {
+                    partial[materialIndex(piece)] += slope;
+                    partial[pieceSquareIndex(piece, square)] += slope;
+                }
+            });
+        }
+        sums[thread] = sum;
+    });
+
+    gradient.assign(_params.size(), 0.0);
+    double total = 0.0;
+    for (int thread = 0; thread < _options.threads; thread++) {
+        total += sums[thread];
+        for (size_t i = 0; i < _params.size(); i++) {
+            gradient[i] += partials[thread][i] * 2.0 / _positions.size();
+        }
+    }
+    return total / _positions.size();
+}
+
+// golden section search, the error is unimodal in the scale
+double Tuner::fitScale()
+{
+    const double ratio = (std::sqrt(5.0) - 1.0) / 2.0;
+    double low = 0.05, high = 5.0;
+    double a = high - ratio * (high - low), b = low + ratio * (high - low);
+    double errorA = error(a), errorB = error(b);
+    for (int i = 0; i < 40; i++) {
+        if (errorA < errorB) {
+            high = b;
+            b = a;
+            errorB = errorA;
+            a = high - ratio * (high - low);
+            errorA = error(a);
+        } else {
+            low = a;
+            a = b;
+            errorA = errorB;
+            b = low + ratio * (high - low);
+            errorB = error(b);
+        }
+    }
+    return (low + high) / 2.0;
+}
+
+bool Tuner::run(std::ostream& log)
+{
+    if (!loadPositions(log)) return false;
+
+    double scale = _options.scale;
+    if (scale <= 0.0) {
+        scale = fitScale();
+    }
+    log << std::fixed << std::setprecision(6) << "scale " << scale << " initial error " << error(scale) << std::endl;
+
+    // Adam, full batch
+    const double beta1 = 0.9, beta2 = 0.999;
+    std::vector<double> gradients, momentum(_params.size(), 0.0), velocity(_params.size(), 0.0);
+    double lastError = 0.0;
+    for (int epoch = 1; epoch <= _options.epochs; epoch++) {
+        const double start = nowSeconds();
+        lastError = gradient(scale, gradients);
+        for (size_t i = 0; i < _params.size(); i++) {
+            if (!_tunable[i]) continue;
+            momentum[i] = beta1 * momentum[i] + (1.0 - beta1) * gradients[i];
+            velocity[i] = beta2 * velocity[i] + (1.0 - beta2) * gradients[i] * gradients[i];
+            const double m = momentum[i] / (1.0 - std::pow(beta1, epoch));
+            const double v = velocity[i] / (1.0 - std::pow(beta2, epoch));
+            _params[i] -= _options.learningRate * m / (std::sqrt(v) + 1e-12);
+        }
+        const double seconds = nowSeconds() - start;
+        log << "epoch " << epoch << " error " << std::setprecision(6) << lastError
+            << " (" << (uint64_t)(seconds > 0.0 ? _positions.size() / seconds : 0.0) << " positions/s)" << std::endl;
+    }
+    lastError = error(scale);
+    log << "final error " << lastError << std::endl;
+
+    if (!writeHeader(lastError, _options.epochs)) {
+        log << "could not write " << _options.outputPath << std::endl;
+        return false;
+    }
+    log << "wrote " << _options.outputPath << std::endl;
+    return true;
+}
+
+bool Tuner::writeHeader(double error, int epochs) const
+{
+    // move each table's average into the material value so the tables read as adjustments
+    std::vector<double> params = _params;
+    for (int piece = Pawn; piece <= King; piece++) {
+        double sum = 0.0;
+        int count = 0;
+        for (int square = 0; square < 64; square++) {
+            if (!_tunable[pieceSquareIndex(piece, square)]) continue;
+            sum += params[pieceSquareIndex(piece, square)];
+            count++;
+        }
+        const double mean = sum / count;
+        for (int square = 0; square < 64; square++) {
+            if (_tunable[pieceSquareIndex(piece, square)]) params[pieceSquareIndex(piece, square)] -= mean;
+        }
+        if (piece != King) params[materialIndex(piece)] += mean;
+    }
+
+    std::ofstream file(_options.outputPath);
+    if (!file) return false;
+    file << "#pragma once\n\n"
+         << "// evaluation constants, indexed by ChessPiece. 'engine tune' writes a file in this format\n"
+         << "// piece square values are from white's point of view with a1 first, black pieces use the mirrored square\n"
+         << "// tuned on " << _positions.size() << " positions for " << epochs << " epochs, error "
+         << std::fixed << std::setprecision(6) << error << "\n\n";
+
+    file << "constexpr int EvalMaterial[7] = { ";
+    for (int piece = NoPiece; piece <= King; piece++) {
+        file << std::lround(params[materialIndex(piece)]) << (piece < King ? ", " : " };\n\n");
+    }
+    file << "constexpr int EvalPieceSquare[7][64] = {\n";
+    for (int piece = NoPiece; piece <= King; piece++) {
+        file << "    { // " << PieceNames[piece] << "\n";
+        for (int rank = 0; rank < 8; rank++) {
+            file << "       ";
+            for (int column = 0; column < 8; column++) {
+                file << " " << std::setw(4) << std::lround(params[pieceSquareIndex(piece, rank * 8 + column)]) << ",";
+            }
+            file << "\n";
+        }
+        file << "    },\n";
+    }
+    file << "};\n";
+    return bool(file);
+}
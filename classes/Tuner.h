@@ -0,0 +1,49 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "PackedPosition.h"
+
+struct TunerOptions {
+    std::string inputPath;          // PackedPosition file, see DataGenerator
+    std::string outputPath = "EvalParams.h";
+    int threads = 1;
+    int epochs = 200;
+    double learningRate = 1.0;      // Adam step size in centipawns
+    uint64_t maxPositions = 0;      // 0 loads the whole file
+    double scale = 0.0;             // sigmoid scale K, fitted to the data when 0
+};
+
+//
+// Texel style tuner for the evaluation constants in EvalParams.h
+// every labelled position is resolved once to the quiet leaf of a quiescence search,
+// then the mean squared error between the game result and sigmoid(eval) of the leaves
+// is minimised with full batch Adam, each epoch split across the worker threads
+//
+class Tuner
+{
+public:
+    Tuner(const TunerOptions& options);
+
+    // returns false when no positions could be loaded or the header could not be written
+    bool run(std::ostream& log);
+
+private:
+    bool loadPositions(std::ostream& log);
+    double fitScale();
+    double error(double scale);
+    // fills gradient with d error / d parameter and returns the error
+    double gradient(double scale, std::vector<double>& gradient);
+    double evaluate(const PackedPosition& leaf) const;
+    bool writeHeader(double error, int epochs) const;
+
+    // work(begin, end, thread) over _positions, one slice per thread
+    template <typename Work>
+    void parallel(Work work);
+
+    TunerOptions _options;
+    std::vector<PackedPosition> _positions;     // quiet leaves, result copied from the source record
+    std::vector<double> _params;                // EvalMaterial[7] followed by EvalPieceSquare[7][64]
+    std::vector<bool> _tunable;
+};
@@ -0,0 +1,953 @@
+// Headless entry point for the chess engine.
+// Everything in here runs without a window so it can be left going overnight on a build box.
+
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include "classes/Annotation.h"
+#include "classes/BatchEval.h"
+#include "classes/Bench.h"
+#include "classes/DataGen.h"
+#include "classes/Eco.h"
+#include "classes/GameDatabase.h"
+#include "classes/GameDedupe.h"
+#include "classes/Match.h"
+#include "classes/MaterialIndex.h"
+#include "classes/OpeningExplorer.h"
+#include "classes/Pgn.h"
+#include "classes/PgnExport.h"
+#include "classes/PositionIndex.h"
+#include "classes/QueryServer.h"
+#include "classes/SearchOptions.h"
+#include "classes/Spsa.h"
+#include "classes/Tuner.h"
+
+//
+// --name value pairs following the command, a name with no value reads as "1"
+//
+class CommandLine
+{
+public:
+    CommandLine(int argc, char** argv)
+    {
+        for (int i = 0; i < argc; i++) {
+            const std::string_view arg = argv[i];
+            if (!arg.starts_with("--")) {
+                _unknown.emplace_back(arg);
+                continue;
+            }
+            // a flag with no value reads as "1"
+            const bool hasValue = i + 1 < argc && !std::string_view(argv[i + 1]).starts_with("--");
+            _values.insert_or_assign(std::string(arg.substr(2)), std::string(hasValue ? argv[++i] : "1"));
+        }
+    }
+
+    bool has(const std::string& name) const { return _values.count(name) != 0; }
+    std::string getString(const std::string& name, const std::string& fallback) const
+    {
+        auto it = _values.find(name);
+        return it == _values.end() ? fallback : it->second;
+    }
+    long long getInt(const std::string& name, long long fallback) const
+    {
+        auto it = _values.find(name);
+        return it == _values.end() ? fallback : std::atoll(it->second.c_str());
+    }
+    double getDouble(const std::string& name, double fallback) const
+    {
+        auto it = _values.find(name);
+        return it == _values.end() ? fallback : std::atof(it->second.c_str());
+    }
+    const std::vector<std::string>& unknown() const { return _unknown; }
+
+private:
+    std::unordered_map<std::string, std::string> _values;
+    std::vector<std::string> _unknown;
+};
+
+static std::string searchOptionNames()
+{
+    std::string names;
+    for (const SearchOption& option : searchOptions()) {
+        if (!names.empty()) names += ' ';
+        names += option.name;
+    }
+    return names;
+}
+
+static bool searchParamsFromCommandLine(const CommandLine& args, const std::string& name, SearchParams& params)
+{
+    if (!parseSearchParams(args.getString(name, ""), params)) {
+        std::cerr << "could not parse --" << name << ", expected Name=value,... with names from: " << searchOptionNames() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+static void printUsage()
+{
+    std::cout <<
+        "usage: engine <command> [--option value ...]\n"
+        "\n"
+        "bench    search the built in positions to a fixed depth, the node total is the signature\n"
+        "         --depth N\n"
+        "seebench time static exchange evaluation over the captures in the bench positions\n"
+        "         --iterations N\n"
+        "search   search one position and print the result with its stats as JSON\n"
+        "         --fen F --depth N --nodes N --movetime ms --hash MB\n"
+        "         --noaspiration  search every iteration with a full window\n"
+        "         --params Name=value,...  set search constants, see spsa for the names\n"
+        "         --multipv N  report the N best moves and compare the time against a single line\n"
+        "         --infinite  analyse until enter is pressed, every iteration is printed as it completes\n"
+        "batch    score every position in a file, one FEN per line or packed 32 byte records\n"
+        "         --input file --packed --output file (default stdout) --threads N\n"
+        "         --depth N --nodes N --hash MB  (neither depth nor nodes: static evaluation)\n"
+        "datagen  play fixed node self-play games and write quiet positions as packed training records\n"
+        "         --output file --positions N --threads N --nodes N --book file.epd --plies N --seed N --maxplies N\n"
+        "dataset  decode a packed position file through a memory map and report the throughput\n"
+        "         --input file --threads N --seed N  (a seed shuffles blocks and the records inside them)\n"
+        "tune     fit the evaluation constants to game results and write them as a header like classes/EvalParams.h\n"
+        "         --input file --output file --threads N --epochs N --rate cp --positions N --scale K (fitted when omitted)\n"
+        "spsa     tune search constants with SPSA self-play mini matches on every thread\n"
+        "         --iterations N --games N (per iteration) --threads N --rate r --log file.csv\n"
+        "         --tune Name,... (default all, IterationTimePercent only with --movetime) --params Name=value,... (start values)\n"
+        "         --depth N --nodes N --movetime ms --hash MB --book file.epd --plies N --seed N --maxplies N\n"
+        "         tunable: " + searchOptionNames() + "\n"
+        "import   parse a PGN file in parallel chunks, check every move with GameState and store the games\n"
+        "         --input file.pgn --output base (writes base.games and base.headers) --threads N\n"
+        "         --comments (keep comments) --errors (list the games that failed)\n"
+        "         --explorer (also write base.explorer, see explorer) --plies N\n"
+        "         --dedupe (skip games whose moves and final position were already imported)\n"
+        "game     print one game of a database, found in constant time by its number\n"
+        "         --db base --id N\n"
+        "index    build base.positions, every position of every game keyed by its hash\n"
+        "         --db base --threads N --memory MB (sort buffers, larger databases sort in several runs)\n"
+        "find     list the games that reached a position, needs the index\n"
+        "         --db base --fen F (default the start position) --limit N\n"
+        "explorer build base.explorer, the moves played from every opening position with their results\n"
+        "         --db base --threads N --plies N (positions kept, default 40)\n"
+        "explore  list the moves played from a position with games, results, average rating and last date\n"
+        "         --db base --fen F (default the start position)\n"
+        "material build base.material, per position material signatures and piece boards stored as columns\n"
+        "         --db base --threads N\n"
+        "scan     find the games reaching a material balance or piece pattern by scanning base.material\n"
+        "         --db base --material KRP*vKRP* (repeat letters for counts, * for any number) --pattern Pe5,nd6\n"
+        "         --minply N --maxply N --threads N --limit N --scalar (no AVX2)\n"
+        "eco      classify every game of a database by the deepest built in ECO line it reaches\n"
+        "         --db base --threads N\n"
+        "export   write games of a database back to PGN with SAN moves, blocks of games are formatted in parallel\n"
+        "         --db base --output file.pgn --threads N\n"
+        "         --player name --eco B9 (code or prefix) --minelo N (both players) --first N --count N\n"
+        "annotate search every position of every game and write base.evals with scores and move marks, engine game shows them\n"
+        "         --db base --threads N --nodes N (per position, default 20000) --hash MB (per thread)\n"
+        "         --inaccuracy cp --mistake cp --blunder cp (score drops for ?!, ? and ??, default 50 100 250)\n"
+        "serve    answer line delimited JSON queries on a Unix socket from one shared copy of a database\n"
+        "         --db base --socket path (default chessdb.sock) --threads N (workers)\n"
+        "         --connections N (open at once, default 256)\n"
+        "query    send one request line to a server and print the reply\n"
+        "         --socket path --request '{\"op\":\"game\",\"id\":0}' (default a stats request)\n"
+        "match    play engine one against engine two\n"
+        "         --games N --threads N --book file.epd --plies N --seed N --maxplies N\n"
+        "         --depth N --nodes N --movetime ms --hash MB --noaspiration  (both engines, add 1 or 2 to set one side)\n"
+        "         --params Name=value,...  (add 1 or 2 to set one side) --name1 S --name2 S\n"
+        "         --elo0 E --elo1 E --alpha A --beta B --nosprt\n"
+        "         --drawmove N --drawscore cp --drawplies N --resignscore cp --resignplies N\n";
+}
+
+static int runBatch(const CommandLine& args)
+{
+    const std::string inputPath = args.getString("input", "");
+    std::ifstream input(inputPath, std::ios::binary);
+    if (!input) {
+        std::cerr << "could not open " << inputPath << std::endl;
+        return 1;
+    }
+
+    BatchOptions options;
+    options.threads = (int)args.getInt("threads", std::thread::hardware_concurrency());
+    options.depth = (int)args.getInt("depth", 0);
+    options.nodes = (uint64_t)args.getInt("nodes", 0);
+    options.hashMegabytes = (size_t)args.getInt("hash", options.hashMegabytes);
+    BatchEvaluator evaluator(options);
+
+    std::vector<std::string> fens;
+    std::vector<BatchResult> results;
+    if (args.has("packed")) {
+        std::vector<PackedPosition> packed;
+        PackedPosition record;
+        while (input.read(reinterpret_cast<char*>(&record), sizeof(record))) {
+            packed.push_back(record);
+        }
+        results = evaluator.evaluate(packed);
+        GameState position;
+        for (const PackedPosition& entry : packed) {
+            fens.push_back(entry.unpack(position) ? position.toFEN() : "-");
+        }
+    } else {
+        std::string line;
+        while (std::getline(input, line)) {
+            if (!line.empty()) fens.push_back(line);
+        }
+        results = evaluator.evaluate(fens);
+    }
+
+    const std::string outputPath = args.getString("output", "-");
+    std::ofstream file;
+    if (outputPath != "-") file.open(outputPath);
+    std::ostream& out = outputPath == "-" ? std::cout : file;
+    for (size_t i = 0; i < results.size(); i++) {
+        out << fens[i] << '\t';
+        if (!results[i].valid) {
+            out << "invalid\n";
+            continue;
+        }
+        out << results[i].score << '\t' << (results[i].bestMove.isNull() ? "-" : GameState::moveToUCI(results[i].bestMove)) << '\n';
+    }
+    out.flush();
+
+    std::ostream& log = outputPath == "-" ? std::cerr : std::cout;
+    log << results.size() << " positions in " << evaluator.seconds() << "s, "
+        << (uint64_t)evaluator.positionsPerSecond() << " positions/s on " << options.threads << " threads" << std::endl;
+    return 0;
+}
+
+static int runDataGen(const CommandLine& args)
+{
+    DataGenOptions options;
+    options.outputPath = args.getString("output", "");
+    if (options.outputPath.empty()) {
+        std::cerr << "datagen needs --output" << std::endl;
+        return 1;
+    }
+    options.positions = (uint64_t)args.getInt("positions", (long long)options.positions);
+    options.threads = (int)args.getInt("threads", std::thread::hardware_concurrency());
+    options.nodes = (uint64_t)args.getInt("nodes", (long long)options.nodes);
+    options.bookPath = args.getString("book", "");
+    options.randomPlies = (int)args.getInt("plies", options.randomPlies);
+    options.seed = (uint64_t)args.getInt("seed", 1);
+    options.maxPlies = (int)args.getInt("maxplies", options.maxPlies);
+
+    DataGenerator generator(options);
+    return generator.run(std::cout) ? 0 : 1;
+}
+
+static int runTune(const CommandLine& args)
+{
+    TunerOptions options;
+    options.inputPath = args.getString("input", "");
+    if (options.inputPath.empty()) {
+        std::cerr << "tune needs --input" << std::endl;
+        return 1;
+    }
+    options.outputPath = args.getString("output", options.outputPath);
+    options.threads = (int)args.getInt("threads", std::thread::hardware_concurrency());
+    options.epochs = (int)args.getInt("epochs", options.epochs);
+    options.learningRate = args.getDouble("rate", options.learningRate);
+    options.maxPositions = (uint64_t)args.getInt("positions", 0);
+    options.scale = args.getDouble("scale", 0.0);
+
+    Tuner tuner(options);
+    return tuner.run(std::cout) ? 0 : 1;
+}
+
+static int runSpsa(const CommandLine& args)
+{
+    SpsaOptions options;
+    if (!searchParamsFromCommandLine(args, "params", options.start)) return 1;
+    std::istringstream names(args.getString("tune", ""));
+    std::string name;
+    while (std::getline(names, name, ',')) {
+        if (name.empty()) continue;
+        if (!findSearchOption(name)) {
+            std::cerr << "unknown search option " << name << ", tunable: " << searchOptionNames() << std::endl;
+            return 1;
+        }
+        if (findSearchOption(name)->needsMoveTime && !args.has("movetime")) {
+            std::cerr << name << " only affects searches with a move time, tune it with --movetime" << std::endl;
+            return 1;
+        }
+        options.names.push_back(name);
+    }
+    options.iterations = (int)args.getInt("iterations", options.iterations);
+    options.gamesPerIteration = (int)args.getInt("games", 0);
+    options.threads = (int)args.getInt("threads", std::thread::hardware_concurrency());
+    options.limits.depth = (int)args.getInt("depth", MAX_PLY - 1);
+    options.limits.nodes = (uint64_t)args.getInt("nodes", 5000);
+    options.limits.moveTimeMs = (int)args.getInt("movetime", 0);
+    options.hashMegabytes = (size_t)args.getInt("hash", (long long)options.hashMegabytes);
+    options.bookPath = args.getString("book", "");
+    options.randomPlies = (int)args.getInt("plies", options.randomPlies);
+    options.seed = (uint64_t)args.getInt("seed", 1);
+    options.maxPlies = (int)args.getInt("maxplies", options.maxPlies);
+    options.learningRate = args.getDouble("rate", options.learningRate);
+    options.logPath = args.getString("log", "");
+
+    Spsa spsa(options);
+    spsa.run(std::cout);
+    return 0;
+}
+
+static std::string pvToString(const std::vector<BitMove>& pv)
+{
+    std::string text;
+    for (const BitMove& move : pv) {
+        text += ' ';
+        text += GameState::moveToUCI(move);
+    }
+    return text;
+}
+
+static int runImport(const CommandLine& args)
+{
+    const std::string input = args.getString("input", "");
+    if (input.empty()) {
+        std::cerr << "import needs --input" << std::endl;
+        return 1;
+    }
+    PgnImportOptions options;
+    options.threads = (int)args.getInt("threads", std::thread::hardware_concurrency());
+    options.keepComments = args.has("comments");
+
+    const std::string output = args.getString("output", "");
+    GameDatabaseWriter writer;
+    if (!output.empty() && !writer.open(output)) {
+        std::cerr << "could not create " << output << ".games" << std::endl;
+        return 1;
+    }
+
+    ExplorerOptions explorerOptions;
+    explorerOptions.maxPly = (int)args.getInt("plies", explorerOptions.maxPly);
+    ExplorerBuilder explorer(explorerOptions);
+    const bool buildExplorer = !output.empty() && args.has("explorer");
+    DuplicateFilter duplicates;
+    const bool dedupe = args.has("dedupe");
+    const EcoTable& ecoTable = EcoTable::instance();
+    std::atomic<uint64_t> tagged(0);
+    std::atomic<uint64_t> classified(0);
+    std::atomic<uint64_t> tooLong(0);
+
+    std::mutex errorMutex;
+    const bool listErrors = args.has("errors");
+    PgnImporter importer(options);
+    bool opened = importer.run(input, [&](size_t chunk, std::span<PgnGame> games) {
+        std::vector<EncodedGame> encoded;
+        GameState start;
+        for (const PgnGame& game : games) {
+            if (game.valid) {
+                if (dedupe && !duplicates.insert(GameFingerprint::of(game))) continue;
+                if (output.empty()) continue;
+                const std::string_view fen = game.tag("FEN");
+                start.initFromFEN(fen.empty() ? std::string(StartFEN) : std::string(fen));
+                encoded.emplace_back();
+                encoded.back().fromPgn(game);
+                // left out before anything counts it, so the report and the explorer agree with base.games
+                if (!encoded.back().fitsBlock()) {
+                    encoded.pop_back();
+                    tooLong++;
+                    continue;
+                }
+                // a valid ECO tag is kept, the built in lines only know the main codes and would lose its detail
+                if (encoded.back().header.eco) {
+                    tagged++;
+                } else if (const EcoOpening* opening = ecoTable.classify(start, game.moves)) {
+                    encoded.back().header.eco = ecoFromString(opening->code);
+                    classified++;
+                }
+                if (buildExplorer) explorer.add(start, game.moves, encoded.back().header);
+            } else if (listErrors) {
+                std::lock_guard<std::mutex> lock(errorMutex);
+                std::cerr << "game at byte " << game.offset << ": move " << game.moves.size() + 1 << " '"
+                          << (game.moves.size() < game.san.size() ? game.san[game.moves.size()] : std::string_view()) << "' is not legal" << std::endl;
+            }
+        }
+        if (!output.empty()) writer.add(chunk, std::move(encoded));
+    });
+    if (!opened) {
+        std::cerr << "could not map " << input << std::endl;
+        return 1;
+    }
+
+    const PgnImportStats& stats = importer.stats();
+    std::cout << std::fixed << std::setprecision(1)
+              << "Games           : " << stats.games << " (" << stats.invalidGames << " with illegal moves)" << std::endl
+              << "Moves           : " << stats.moves << std::endl
+              << "Total time (ms) : " << (uint64_t)(stats.seconds * 1000.0) << std::endl
+              << "Games/second    : " << (uint64_t)stats.gamesPerSecond() << std::endl
+              << "MB/second       : " << (stats.seconds > 0.0 ? stats.bytes / stats.seconds / 1e6 : 0.0) << std::endl;
+    if (dedupe) {
+        const DedupeStats dedupeStats = duplicates.stats();
+        std::cout << "Duplicates      : " << dedupeStats.duplicates << " of " << dedupeStats.checked << " valid games ("
+                  << dedupeStats.duplicateRate() * 100.0 << "%), shards hold " << dedupeStats.smallestShard << " to "
+                  << dedupeStats.largestShard << " games" << std::endl;
+    }
+
+    if (!output.empty()) {
+        const uint64_t stored = writer.gameCount();
+        if (!writer.close()) {
+            std::cerr << "could not write " << output << std::endl;
+            return 1;
+        }
+        std::cout << "ECO codes       : " << tagged << " from tags, " << classified << " classified, of " << stored << " games" << std::endl;
+        if (buildExplorer && !explorer.write(output, std::cout)) return 1;
+        GameDatabase database;
+        if (database.open(output)) {
+            std::cout << "Stored          : " << stored << " games in " << database.bytes() << " bytes, "
+                      << (database.bytes() ? (double)stats.bytes / database.bytes() : 0.0) << "x smaller than the PGN, "
+                      << tooLong + writer.droppedGames() << " too long to store" << std::endl;
+        }
+    }
+    return 0;
+}
+
+static int runGame(const CommandLine& args)
+{
+    GameDatabase database;
+    const std::string base = args.getString("db", "");
+    if (!database.open(base)) {
+        std::cerr << "could not open database " << base << std::endl;
+        return 1;
+    }
+    const uint64_t id = (uint64_t)args.getInt("id", 0);
+    if (id >= database.size()) {
+        std::cerr << "the database has " << database.size() << " games" << std::endl;
+        return 1;
+    }
+
+    // the first position built also builds the move generation tables, keep that out of the timing
+    GameState position;
+    database.startPosition(id, position);
+    std::vector<BitMove> moves;
+    auto start = std::chrono::steady_clock::now();
+    const bool decoded = database.decode(id, position, moves);
+    const double micros = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+    const GameHeader header = database.header(id);
+    const int result = header.result;
+    std::cout << "[Event \"" << header.event << "\"]\n[Site \"" << header.site << "\"]\n"
+              << "[Date \"" << header.date / 10000 << "." << std::setw(2) << std::setfill('0') << header.date / 100 % 100
+              << "." << std::setw(2) << header.date % 100 << std::setfill(' ') << "\"]\n"
+              << "[White \"" << header.white << "\"]\n[Black \"" << header.black << "\"]\n"
+              << "[WhiteElo \"" << header.whiteElo << "\"]\n[BlackElo \"" << header.blackElo << "\"]\n"
+              << "[ECO \"" << ecoToString(header.eco) << "\"]\n"
+              << "[Result \"" << (result == 1 ? "1-0" : result == -1 ? "0-1" : result == 0 ? "1/2-1/2" : "*") << "\"]\n\n"
+              << "moves" << pvToString(moves) << std::endl;
+    // each move with its mark and the score of the position it leads to, when the database has been annotated
+    GameEvaluations evaluations;
+    if (evaluations.open(base)) {
+        const auto records = evaluations.game(id);
+        std::cout << "evals";
+        for (size_t ply = 0; ply < moves.size() && ply + 1 < records.size() && records[ply + 1].depth; ply++) {
+            std::cout << " " << GameState::moveToUCI(moves[ply]) << moveMarkText(records[ply].mark) << " "
+                      << std::showpos << std::fixed << std::setprecision(2) << records[ply + 1].score / 100.0 << std::noshowpos;
+        }
+        std::cout << std::endl;
+    }
+    if (!decoded) std::cerr << "the stored moves stop being legal after ply " << moves.size() << std::endl;
+    std::cout << "decoded in " << std::fixed << std::setprecision(1) << micros << " us" << std::endl;
+    return decoded ? 0 : 1;
+}
+
+static int runIndex(const CommandLine& args)
+{
+    GameDatabase database;
+    const std::string base = args.getString("db", "");
+    if (!database.open(base)) {
+        std::cerr << "could not open database " << base << std::endl;
+        return 1;
+    }
+    PositionIndexOptions options;
+    options.threads = (int)args.getInt("threads", std::thread::hardware_concurrency());
+    options.memoryMegabytes = (size_t)args.getInt("memory", (long long)options.memoryMegabytes);
+    PositionIndexBuilder builder(options);
+    return builder.build(database, std::cout) ? 0 : 1;
+}
+
+static int runFind(const CommandLine& args)
+{
+    GameDatabase database;
+    PositionIndex index;
+    const std::string base = args.getString("db", "");
+    if (!database.open(base) || !index.open(base)) {
+        std::cerr << "could not open database " << base << " with its position index, see index" << std::endl;
+        return 1;
+    }
+    GameState position;
+    if (!position.initFromFEN(args.getString("fen", StartFEN))) {
+        std::cerr << "could not parse the fen" << std::endl;
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<PositionHit> hits;
+    const uint32_t total = index.find(position.positionKey(), hits, (size_t)args.getInt("limit", 20));
+    const double millis = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    for (const PositionHit& hit : hits) {
+        std::cout << "game " << hit.game << " ply " << hit.ply << ": " << database.white(hit.game) << " - "
+                  << database.black(hit.game) << std::endl;
+    }
+    std::cout << std::fixed << std::setprecision(3) << total << " occurrences, found in " << millis << " ms" << std::endl;
+    return 0;
+}
+
+static int runExplorer(const CommandLine& args)
+{
+    GameDatabase database;
+    const std::string base = args.getString("db", "");
+    if (!database.open(base)) {
+        std::cerr << "could not open database " << base << std::endl;
+        return 1;
+    }
+    ExplorerOptions options;
+    options.threads = (int)args.getInt("threads", std::thread::hardware_concurrency());
+    options.maxPly = (int)args.getInt("plies", options.maxPly);
+    auto start = std::chrono::steady_clock::now();
+    ExplorerBuilder builder(options);
+    builder.addDatabase(database);
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << std::fixed << std::setprecision(1) << "tallied " << builder.gameCount() << " games in " << seconds << "s" << std::endl;
+    return builder.write(base, std::cout) ? 0 : 1;
+}
+
+static int runExplore(const CommandLine& args)
+{
+    OpeningExplorer explorer;
+    const std::string base = args.getString("db", "");
+    if (!explorer.open(base)) {
+        std::cerr << "could not open " << base << ".explorer, see explorer" << std::endl;
+        return 1;
+    }
+    GameState position;
+    if (!position.initFromFEN(args.getString("fen", StartFEN))) {
+        std::cerr << "could not parse the fen" << std::endl;
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    const std::span<const ExplorerMove> moves = explorer.moves(position.positionKey());
+    const double micros = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "move    games  white  draw  black  rating  last played" << std::endl;
+    for (const ExplorerMove& move : moves) {
+        const double games = move.games;
+        std::cout << std::left << std::setw(6) << GameState::moveToUCI(move.move) << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(7) << move.games << std::setw(6) << 100.0 * move.whiteWins / games << "%"
+                  << std::setw(5) << 100.0 * move.draws / games << "%" << std::setw(6) << 100.0 * move.blackWins / games << "%"
+                  << std::setw(8) << move.averageRating << "  " << move.lastPlayed / 10000 << "." << std::setw(2) << std::setfill('0')
+                  << move.lastPlayed / 100 % 100 << "." << std::setw(2) << move.lastPlayed % 100 << std::setfill(' ') << std::endl;
+    }
+    std::cout << std::fixed << std::setprecision(1) << moves.size() << " moves, looked up in " << micros << " us" << std::endl;
+    return 0;
+}
+
+static int runMaterial(const CommandLine& args)
+{
+    GameDatabase database;
+    const std::string base = args.getString("db", "");
+    if (!database.open(base)) {
+        std::cerr << "could not open database " << base << std::endl;
+        return 1;
+    }
+    MaterialIndexBuilder builder((int)args.getInt("threads", std::thread::hardware_concurrency()));
+    return builder.build(database, std::cout) ? 0 : 1;
+}
+
+static int runScan(const CommandLine& args)
+{
+    GameDatabase database;
+    MaterialIndex index;
+    const std::string base = args.getString("db", "");
+    if (!database.open(base) || !index.open(base)) {
+        std::cerr << "could not open database " << base << " with its material index, see material" << std::endl;
+        return 1;
+    }
+    MaterialQuery query;
+    const std::string material = args.getString("material", "");
+    const std::string pattern = args.getString("pattern", "");
+    if (!material.empty() && !query.setMaterial(material)) {
+        std::cerr << "could not parse the material " << material << std::endl;
+        return 1;
+    }
+    if (!pattern.empty() && !query.setPattern(pattern)) {
+        std::cerr << "could not parse the pattern " << pattern << std::endl;
+        return 1;
+    }
+    query.minPly = (int)args.getInt("minply", query.minPly);
+    query.maxPly = (int)args.getInt("maxply", query.maxPly);
+
+    std::vector<MaterialMatch> matches;
+    MaterialScanStats stats;
+    index.scan(query, (int)args.getInt("threads", std::thread::hardware_concurrency()), matches, stats, !args.has("scalar"));
+
+    const size_t limit = (size_t)args.getInt("limit", 20);
+    for (size_t i = 0; i < matches.size() && i < limit; i++) {
+        std::cout << "game " << matches[i].game << " from ply " << matches[i].ply << ": " << database.white(matches[i].game)
+                  << " - " << database.black(matches[i].game) << std::endl;
+    }
+    std::cout << std::fixed << std::setprecision(2) << matches.size() << " games, " << stats.matches << " positions of "
+              << stats.records << " scanned in " << stats.seconds * 1000.0 << " ms (" << (stats.simd ? "AVX2" : "scalar")
+              << "), " << stats.gigabytesPerSecond() << " GB/s" << std::endl;
+    return 0;
+}
+
+static int runEco(const CommandLine& args)
+{
+    GameDatabase database;
+    const std::string base = args.getString("db", "");
+    if (!database.open(base)) {
+        std::cerr << "could not open database " << base << std::endl;
+        return 1;
+    }
+    const EcoTable& table = EcoTable::instance();
+    const int threads = std::max(1, (int)args.getInt("threads", std::thread::hardware_concurrency()));
+
+    // games per ECO code, index 0 for the unclassified
+    std::vector<uint64_t> counts(501);
+    std::atomic<uint64_t> nextGame(0);
+    std::atomic<uint64_t> agreed(0);
+    std::mutex countMutex;
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int i = 0; i < threads; i++) {
+        workers.emplace_back([&]() {
+            std::vector<uint64_t> local(counts.size());
+            uint64_t same = 0;
+            GameState start;
+            GameState position;
+            std::vector<BitMove> legal;
+            std::vector<BitMove> moves;
+            for (uint64_t id = nextGame++; id < database.size(); id = nextGame++) {
+                // only as many moves as the deepest line are decoded
+                if (!database.startPosition(id, start)) continue;
+                moves.clear();
+                database.replay(id, position, legal, [&](int ply, const GameState&, const BitMove& move) {
+                    if (ply >= table.maxPly() || move.isNull()) return false;
+                    moves.push_back(move);
+                    return true;
+                });
+                const EcoOpening* opening = table.classify(start, moves);
+                const uint16_t eco = opening ? ecoFromString(opening->code) : 0;
+                local[eco]++;
+                same += eco == database.eco(id);
+            }
+            std::lock_guard<std::mutex> lock(countMutex);
+            for (size_t code = 0; code < counts.size(); code++) {
+                counts[code] += local[code];
+            }
+            agreed += same;
+        });
+    }
+    for (auto& thread : workers) {
+        thread.join();
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<std::pair<uint64_t, uint16_t>> ranked;
+    for (size_t code = 1; code < counts.size(); code++) {
+        if (counts[code]) ranked.push_back({ counts[code], uint16_t(code) });
+    }
+    std::sort(ranked.rbegin(), ranked.rend());
+    for (size_t i = 0; i < ranked.size() && i < 10; i++) {
+        std::cout << ecoToString(ranked[i].second) << " " << std::setw(8) << ranked[i].first << std::endl;
+    }
+    std::cout << std::fixed << std::setprecision(1) << database.size() - counts[0] << " of " << database.size() << " games classified ("
+              << agreed << " as stored) in " << seconds * 1000.0 << " ms, " << (seconds > 0.0 ? database.size() / seconds : 0.0)
+              << " games/s with " << table.size() << " ECO lines" << std::endl;
+    return 0;
+}
+
+static int runServe(const CommandLine& args)
+{
+    QueryServerOptions options;
+    options.socketPath = args.getString("socket", options.socketPath);
+    options.threads = (int)args.getInt("threads", options.threads);
+    options.maxConnections = (int)args.getInt("connections", options.maxConnections);
+    QueryServer server(options);
+    if (!server.open(args.getString("db", ""), std::cerr)) return 1;
+    return server.run(std::cerr) ? 0 : 1;
+}
+
+static int runQuery(const CommandLine& args)
+{
+    const std::string reply = queryServer(args.getString("socket", QueryServerOptions().socketPath), args.getString("request", "{\"op\":\"stats\"}"));
+    if (reply.empty()) {
+        std::cerr << "no reply from the server" << std::endl;
+        return 1;
+    }
+    std::cout << reply << std::endl;
+    return 0;
+}
+
+static int runExport(const CommandLine& args)
+{
+    GameDatabase database;
+    const std::string base = args.getString("db", "");
+    if (!database.open(base)) {
+        std::cerr << "could not open database " << base << std::endl;
+        return 1;
+    }
+    const std::string output = args.getString("output", "");
+    if (output.empty()) {
+        std::cerr << "export needs --output" << std::endl;
+        return 1;
+    }
+
+    // the filters are checked against the header columns only, the moves are decoded by the exporter
+    const std::string player = args.getString("player", "");
+    const std::string eco = args.getString("eco", "");
+    const int minElo = (int)args.getInt("minelo", 0);
+    const uint64_t first = (uint64_t)args.getInt("first", 0);
+    const uint64_t last = std::min(database.size(), first + (uint64_t)args.getInt("count", (long long)database.size()));
+    std::vector<uint64_t> ids;
+    for (uint64_t id = first; id < last; id++) {
+        if (!player.empty() && database.white(id) != player && database.black(id) != player) continue;
+        if (!eco.empty() && ecoToString(database.eco(id)).rfind(eco, 0) != 0) continue;
+        if (minElo && (database.whiteElo(id) < minElo || database.blackElo(id) < minElo)) continue;
+        ids.push_back(id);
+    }
+
+    PgnExportOptions options;
+    options.threads = (int)args.getInt("threads", std::thread::hardware_concurrency());
+    PgnExporter exporter(options);
+    if (!exporter.run(database, ids, output)) {
+        std::cerr << "could not write " << output << std::endl;
+        return 1;
+    }
+    const PgnExportStats& stats = exporter.stats();
+    std::cout << std::fixed << std::setprecision(1) << stats.games << " of " << database.size() << " games exported ("
+              << stats.failedGames << " failed to decode), " << stats.plies << " moves, " << stats.bytes / 1e6 << " MB in "
+              << stats.seconds * 1000.0 << " ms" << std::endl
+              << "Games/second    : " << (uint64_t)stats.gamesPerSecond() << std::endl
+              << "MB/second       : " << (stats.seconds > 0.0 ? stats.bytes / stats.seconds / 1e6 : 0.0) << std::endl;
+    return 0;
+}
+
+static int runAnnotate(const CommandLine& args)
+{
+    GameDatabase database;
+    const std::string base = args.getString("db", "");
+    if (!database.open(base)) {
+        std::cerr << "could not open database " << base << std::endl;
+        return 1;
+    }
+    AnnotateOptions options;
+    options.threads = (int)args.getInt("threads", std::thread::hardware_concurrency());
+    options.nodes = (uint64_t)args.getInt("nodes", (long long)options.nodes);
+    options.hashMegabytes = (size_t)args.getInt("hash", (long long)options.hashMegabytes);
+    options.inaccuracy = (int)args.getInt("inaccuracy", options.inaccuracy);
+    options.mistake = (int)args.getInt("mistake", options.mistake);
+    options.blunder = (int)args.getInt("blunder", options.blunder);
+    GameAnnotator annotator(options);
+    if (!annotator.build(database, std::cout)) return 1;
+
+    const AnnotateStats& stats = annotator.stats();
+    std::cout << "Marks           : " << stats.marks[MarkBlunder] << " blunders, " << stats.marks[MarkMistake] << " mistakes, "
+              << stats.marks[MarkInaccuracy] << " inaccuracies" << std::endl
+              << "Nodes searched  : " << stats.nodes << std::endl
+              << "Plies/second    : " << (uint64_t)stats.pliesPerSecond() << std::endl
+              << "Nodes/second    : " << (uint64_t)(stats.seconds > 0.0 ? stats.nodes / stats.seconds : 0.0) << std::endl;
+    return 0;
+}
+
+// side is "1" or "2", a per-side option wins over the shared one, false when --params does not parse
+static bool engineFromCommandLine(const CommandLine& args, const std::string& side, EngineConfig& config)
+{
+    config.name = args.getString("name" + side, "engine" + side);
+    config.limits.depth = (int)args.getInt("depth" + side, args.getInt("depth", MAX_PLY - 1));
+    config.limits.nodes = (uint64_t)args.getInt("nodes" + side, args.getInt("nodes", 20000));
+    config.limits.moveTimeMs = (int)args.getInt("movetime" + side, args.getInt("movetime", 0));
+    config.limits.aspiration = !args.has("noaspiration" + side) && !args.has("noaspiration");
+    config.hashMegabytes = (size_t)args.getInt("hash" + side, args.getInt("hash", 16));
+    return searchParamsFromCommandLine(args, "params", config.params)
+        && searchParamsFromCommandLine(args, "params" + side, config.params);
+}
+
+static int runSearch(const CommandLine& args)
+{
+    GameState position;
+    if (!position.initFromFEN(args.getString("fen", StartFEN))) {
+        std::cerr << "could not parse the fen" << std::endl;
+        return 1;
+    }
+
+    SearchLimits limits;
+    limits.depth = (int)args.getInt("depth", limits.depth);
+    limits.nodes = (uint64_t)args.getInt("nodes", 0);
+    limits.moveTimeMs = (int)args.getInt("movetime", 0);
+    limits.infinite = args.has("infinite");
+    limits.multiPV = (int)args.getInt("multipv", 1);
+    limits.aspiration = !args.has("noaspiration");
+    SearchParams params;
+    if (!searchParamsFromCommandLine(args, "params", params)) return 1;
+    Search search((size_t)args.getInt("hash", 16));
+    search.setParams(params);
+    search.setIterationCallback([](const SearchResult& iteration) {
+        std::cout << "info depth " << iteration.depth << " score " << iteration.score << " nodes " << iteration.nodes
+                  << " time " << (uint64_t)(iteration.seconds * 1000.0) << " pv" << pvToString(iteration.pv) << std::endl;
+    });
+
+    SearchResult result;
+    if (limits.infinite) {
+        std::atomic<bool> done(false);
+        std::thread worker([&]() {
+            result = search.think(position, limits);
+            done = true;
+        });
+        std::string line;
+        std::getline(std::cin, line);
+        // think() clears the stop flag when it starts, so keep asking until it has finished
+        while (!done) {
+            search.stop();
+            std::this_thread::yield();
+        }
+        worker.join();
+    } else {
+        result = search.think(position, limits);
+    }
+
+    std::cout << "bestmove " << GameState::moveToUCI(result.bestMove) << " score " << result.score << " pv"
+              << pvToString(result.pv) << std::endl;
+    if (limits.multiPV > 1) {
+        for (size_t i = 0; i < result.lines.size(); i++) {
+            std::cout << "line " << i + 1 << " depth " << result.lines[i].depth << " score " << result.lines[i].score
+                      << " pv" << pvToString(result.lines[i].pv) << std::endl;
+        }
+        if (!limits.infinite) {
+            // same limits with a single line on a fresh table, to show what the extra lines cost
+            SearchLimits single = limits;
+            single.multiPV = 1;
+            Search reference((size_t)args.getInt("hash", 16));
+            reference.setParams(params);
+            SearchResult singleResult = reference.think(position, single);
+            std::cout << "multipv " << limits.multiPV << ": " << result.nodes << " nodes " << (uint64_t)(result.seconds * 1000.0)
+                      << " ms, single pv: " << singleResult.nodes << " nodes " << (uint64_t)(singleResult.seconds * 1000.0)
+                      << " ms, cost x" << (singleResult.seconds > 0.0 ? result.seconds / singleResult.seconds : 0.0) << std::endl;
+        }
+    }
+    std::cout << result.stats.toJSON() << std::endl;
+    return 0;
+}
+
+static int runMatch(const CommandLine& args)
+{
+    MatchOptions options;
+    options.games = (int)args.getInt("games", options.games);
+    options.threads = (int)args.getInt("threads", std::max(1u, std::thread::hardware_concurrency()));
+    options.bookPath = args.getString("book", "");
+    options.randomPlies = (int)args.getInt("plies", options.randomPlies);
+    options.seed = (uint64_t)args.getInt("seed", (long long)options.seed);
+    options.maxPlies = (int)args.getInt("maxplies", options.maxPlies);
+    options.drawMoveNumber = (int)args.getInt("drawmove", options.drawMoveNumber);
+    options.drawScore = (int)args.getInt("drawscore", options.drawScore);
+    options.drawPlyCount = (int)args.getInt("drawplies", options.drawPlyCount);
+    options.resignScore = (int)args.getInt("resignscore", options.resignScore);
+    options.resignPlyCount = (int)args.getInt("resignplies", options.resignPlyCount);
+    options.sprt = !args.has("nosprt");
+    options.elo0 = args.getDouble("elo0", options.elo0);
+    options.elo1 = args.getDouble("elo1", options.elo1);
+    options.alpha = args.getDouble("alpha", options.alpha);
+    options.beta = args.getDouble("beta", options.beta);
+
+    EngineConfig first;
+    EngineConfig second;
+    if (!engineFromCommandLine(args, "1", first) || !engineFromCommandLine(args, "2", second)) return 1;
+    Match match(options, first, second);
+    match.run(std::cout);
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        printUsage();
+        return 1;
+    }
+
+    const std::string command = argv[1];
+    CommandLine args(argc - 2, argv + 2);
+    if (!args.unknown().empty()) {
+        std::cerr << "unexpected argument: " << args.unknown().front() << std::endl;
+        printUsage();
+        return 1;
+    }
+
+    if (command == "bench") {
+        runBench((int)args.getInt("depth", BENCH_DEFAULT_DEPTH), std::cout);
+        return 0;
+    }
+    if (command == "seebench") {
+        runSeeBench((int)args.getInt("iterations", 20000), std::cout);
+        return 0;
+    }
+    if (command == "search") {
+        return runSearch(args);
+    }
+    if (command == "batch") {
+        return runBatch(args);
+    }
+    if (command == "datagen") {
+        return runDataGen(args);
+    }
+    if (command == "dataset") {
+        return runDatasetBench(args.getString("input", ""), (int)args.getInt("threads", std::thread::hardware_concurrency()),
+                               (uint64_t)args.getInt("seed", 0), std::cout) ? 0 : 1;
+    }
+    if (command == "tune") {
+        return runTune(args);
+    }
+    if (command == "spsa") {
+        return runSpsa(args);
+    }
+    if (command == "import") {
+        return runImport(args);
+    }
+    if (command == "game") {
+        return runGame(args);
+    }
+    if (command == "index") {
+        return runIndex(args);
+    }
+    if (command == "find") {
+        return runFind(args);
+    }
+    if (command == "explorer") {
+        return runExplorer(args);
+    }
+    if (command == "explore") {
+        return runExplore(args);
+    }
+    if (command == "material") {
+        return runMaterial(args);
+    }
+    if (command == "scan") {
+        return runScan(args);
+    }
+    if (command == "eco") {
+        return runEco(args);
+    }
+    if (command == "export") {
+        return runExport(args);
+    }
+    if (command == "annotate") {
+        return runAnnotate(args);
+    }
+    if (command == "serve") {
+        return runServe(args);
+    }
+    if (command == "query") {
+        return runQuery(args);
+    }
+    if (command == "match") {
+        return runMatch(args);
+    }
+
+    printUsage();
+    return command == "help" || command == "--help" ? 0 : 1;
+}
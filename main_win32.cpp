@@ -11,7 +11,10 @@
 #include "imgui/imgui_impl_dx11.h"
 #include <d3d11.h>
 #include <tchar.h>
+#include <stdlib.h>
+#include <string.h>
 #include "Application.h"
+#include "classes/Bench.h"
 
 // Data
 ID3D11Device*            g_pd3dDevice = nullptr;
@@ -29,8 +32,17 @@ void CleanupRenderTarget();
 LRESULT WINAPI WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam);
 
 // Main code
-int main(int, char**)
+int main(int argc, char** argv)
 {
+    // --bench [depth] runs the engine benchmark and exits without opening a window
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--bench") == 0) {
+            int depth = (i + 1 < argc) ? atoi(argv[i + 1]) : 0;
+            runBench(depth > 0 ? depth : BENCH_DEFAULT_DEPTH, std::cout);
+            return 0;
+        }
+    }
+
     // Make process DPI aware and obtain main monitor scale
     ImGui_ImplWin32_EnableDpiAwareness();
     float main_scale = ImGui_ImplWin32_GetDpiScaleForMonitor(::MonitorFromPoint(POINT{ 0, 0 }, MONITOR_DEFAULTTOPRIMARY));
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "classes/GameDatabase.h"
+#include "classes/Pgn.h"
+#include "TestSupport.h"
+
+//
+// games for the database tests: a finished game with castling long, two move orders reaching the same
+// position, an en passant capture, and games set up from a FEN with a promotion and an underpromotion
+//
+inline const char* TestPgn = R"([Event "Paris"]
+[Site "Paris FRA"]
+[Date "1858.??.??"]
+[Round "?"]
+[White "Morphy, Paul"]
+[Black "Duke Karl / Count Isouard"]
+[Result "1-0"]
+[ECO "C41"]
+
+1. e4 e5 2. Nf3 d6 3. d4 Bg4 4. dxe5 Bxf3 5. Qxf3 dxe5 6. Bc4 Nf6 7. Qb3 Qe7
+8. Nc3 c6 9. Bg5 b5 10. Nxb5 cxb5 11. Bxb5+ Nbd7 12. O-O-O Rd8 13. Rxd7 Rxd7
+14. Rd1 Qe6 15. Bxd7+ Nxd7 16. Qb8+ Nxb8 17. Rd8# 1-0
+
+[Event "Transposition"]
+[Site "?"]
+[Date "2024.01.02"]
+[Round "?"]
+[White "Queen Pawn"]
+[Black "Indian"]
+[Result "1/2-1/2"]
+[WhiteElo "2400"]
+[BlackElo "2350"]
+
+1. d4 Nf6 2. c4 e6 3. Nc3 Bb4 4. e3 O-O 1/2-1/2
+
+[Event "Transposition"]
+[Site "?"]
+[Date "2024.01.03"]
+[Round "?"]
+[White "English"]
+[Black "Indian"]
+[Result "0-1"]
+
+1. c4 Nf6 2. d4 e6 3. Nf3 b6 4. g3 Bb7 0-1
+
+[Event "En passant"]
+[Site "?"]
+[Date "????.??.??"]
+[Round "?"]
+[White "Alekhine"]
+[Black "Defence"]
+[Result "*"]
+
+1. e4 Nf6 2. e5 d5 3. exd6 cxd6 4. d4 g6 5. c4 Bg7 6. Nc3 O-O 7. Be2 Nc6 *
+
+[Event "Promotion"]
+[Site "?"]
+[Date "2024.??.??"]
+[Round "?"]
+[White "White"]
+[Black "Black"]
+[Result "*"]
+[SetUp "1"]
+[FEN "8/P7/8/8/8/8/k6K/8 w - - 0 1"]
+
+1. a8=Q+ Kb2 2. Qb7+ Kc2 3. Qc6+ Kd2 *
+
+[Event "Underpromotion"]
+[Site "?"]
+[Date "2024.??.??"]
+[Round "?"]
+[White "White"]
+[Black "Black"]
+[Result "*"]
+[SetUp "1"]
+[FEN "4k3/8/8/8/8/8/1p6/4K3 b - - 0 40"]
+
+40... b1=N 41. Kd1 Kd7 *
+
+)";
+
+inline bool writeTestFile(const std::string& path, const std::string& text)
+{
+    std::ofstream file(path, std::ios::binary);
+    file << text;
+    return bool(file.flush());
+}
+
+// imports pgn into base as engine import does, on several threads with small chunks so the games
+// arrive out of order; moves receives every game's moves in file order
+inline bool importTestPgn(const std::string& pgn, const std::string& base, std::vector<std::vector<BitMove>>& moves)
+{
+    if (!writeTestFile(base + ".pgn", pgn)) return false;
+    GameDatabaseWriter writer;
+    if (!writer.open(base)) return false;
+
+    PgnImportOptions options;
+    options.threads = 3;
+    options.chunkBytes = 512;
+    std::mutex movesMutex;
+    std::map<size_t, std::vector<std::vector<BitMove>>> chunks;
+    bool valid = true;
+    PgnImporter importer(options);
+    const bool opened = importer.run(base + ".pgn", [&](size_t chunk, std::span<PgnGame> games) {
+        std::vector<EncodedGame> encoded;
+        std::vector<std::vector<BitMove>> chunkMoves;
+        for (const PgnGame& game : games) {
+            if (!game.valid) {
+                std::lock_guard<std::mutex> lock(movesMutex);
+                valid = false;
+                continue;
+            }
+            encoded.emplace_back();
+            encoded.back().fromPgn(game);
+            chunkMoves.push_back(game.moves);
+        }
+        writer.add(chunk, std::move(encoded));
+        std::lock_guard<std::mutex> lock(movesMutex);
+        chunks[chunk] = std::move(chunkMoves);
+    });
+    moves.clear();
+    for (auto& [chunk, chunkMoves] : chunks) {
+        for (auto& game : chunkMoves) {
+            moves.push_back(std::move(game));
+        }
+    }
+    return writer.close() && opened && valid;
+}
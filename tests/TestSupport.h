@@ -0,0 +1,46 @@
+#pragma once
+
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include "classes/GameState.h"
+
+//
+// checks shared by the test programs: a failed CHECK is reported and counted, and main returns
+// testResult() so ctest sees the failure without the program stopping at the first one
+//
+
+inline int& testFailures()
+{
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ") failed" << std::endl; \
+            testFailures()++; \
+        } \
+    } while (0)
+
+inline int testResult()
+{
+    if (testFailures()) std::cerr << testFailures() << " checks failed" << std::endl;
+    return testFailures() ? 1 : 0;
+}
+
+// the legal move of position written in UCI, null when there is none
+inline BitMove findMove(GameState& position, const std::string& uci)
+{
+    for (const BitMove& move : position.generateAllMoves()) {
+        if (GameState::moveToUCI(move) == uci) return move;
+    }
+    return BitMove();
+}
+
+// a file name in the temp directory, runs overwrite each other's files
+inline std::string testPath(const std::string& name)
+{
+    return (std::filesystem::temp_directory_path() / ("chess_test_" + name)).string();
+}
@@ -0,0 +1,46 @@
+#include <algorithm>
+#include "TestGames.h"
+
+int main()
+{
+    const std::string base = testPath("database");
+    std::vector<std::vector<BitMove>> imported;
+    CHECK(importTestPgn(TestPgn, base, imported));
+    CHECK(imported.size() == 6);
+
+    GameDatabase database;
+    CHECK(database.open(base));
+    CHECK(database.size() == imported.size());
+
+    // every game decodes to the moves the importer replayed from the PGN
+    GameState position;
+    std::vector<BitMove> moves;
+    for (uint64_t id = 0; id < database.size() && id < imported.size(); id++) {
+        CHECK(database.decode(id, position, moves));
+        CHECK(moves.size() == imported[id].size());
+        CHECK(std::equal(moves.begin(), moves.end(), imported[id].begin(), imported[id].end()));
+    }
+    // the Opera game ends in mate
+    CHECK(database.decode(0, position, moves));
+    CHECK(position.isInCheck() && position.generateAllMoves().empty());
+
+    // headers
+    CHECK(database.white(0) == "Morphy, Paul");
+    CHECK(database.black(0) == "Duke Karl / Count Isouard");
+    CHECK(database.date(0) == 18580000);
+    CHECK(database.result(0) == 1);
+    CHECK(database.result(1) == 0);
+    CHECK(database.result(2) == -1);
+    CHECK(database.result(3) == UnknownResult);
+    CHECK(database.whiteElo(1) == 2400 && database.blackElo(1) == 2350);
+    CHECK(database.whiteElo(0) == 0);
+    CHECK(database.game(0).fen.empty());
+
+    // a game set up from a FEN starts there, and its underpromotion survives the one byte encoding
+    CHECK(database.game(5).fen == "4k3/8/8/8/8/8/1p6/4K3 b - - 0 40");
+    CHECK(database.startPosition(5, position));
+    CHECK(position.color == BLACK);
+    CHECK(database.decode(5, position, moves));
+    CHECK(!moves.empty() && GameState::moveToUCI(moves[0]) == "b2b1n");
+    return testResult();
+}
@@ -0,0 +1,69 @@
+#include <sstream>
+#include "classes/MaterialIndex.h"
+#include "TestGames.h"
+
+static bool sameMatches(const std::vector<MaterialMatch>& a, const std::vector<MaterialMatch>& b)
+{
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a[i].game != b[i].game || a[i].ply != b[i].ply) return false;
+    }
+    return true;
+}
+
+int main()
+{
+    // the test games many times over, so the scans run through whole vector blocks and a tail
+    std::string pgn;
+    for (int copy = 0; copy < 37; copy++) {
+        pgn += TestPgn;
+    }
+    const std::string base = testPath("material");
+    std::vector<std::vector<BitMove>> imported;
+    CHECK(importTestPgn(pgn, base, imported));
+    GameDatabase database;
+    CHECK(database.open(base));
+    std::ostringstream log;
+    CHECK(MaterialIndexBuilder(2).build(database, log));
+    MaterialIndex index;
+    CHECK(index.open(base));
+    CHECK(index.gameCount() == database.size());
+    if (!MaterialIndex::hasAvx2()) std::cerr << "no AVX2 on this CPU, both scans take the scalar loop" << std::endl;
+
+    struct Scan {
+        const char* material;
+        const char* pattern;
+        int minPly;
+        int maxPly;
+        size_t games;               // of the six test games, times the copies
+    };
+    const Scan scans[] = {
+        { "KQRRBBNNPPPPPPPPvKQRRBBNNPPPPPPPP", "", 0, 255, 4 },    // the standard start
+        { "KQ*vK", "", 0, 255, 1 },                                 // the promotion game
+        { "KvKN", "", 0, 255, 1 },                                  // after the underpromotion
+        { "KR*B*N*Q*P*vKR*B*N*Q*P*", "Pe5", 0, 255, 2 },            // the Opera game and the en passant game
+        { "", "Pe4,pe5", 0, 255, 1 },
+        { "", "Ke1", 3, 8, 4 },
+        { "", "qe6", 0, 255, 1 },
+    };
+    for (const Scan& scan : scans) {
+        MaterialQuery query;
+        if (*scan.material) CHECK(query.setMaterial(scan.material));
+        if (*scan.pattern) CHECK(query.setPattern(scan.pattern));
+        query.minPly = scan.minPly;
+        query.maxPly = scan.maxPly;
+
+        std::vector<MaterialMatch> vector;
+        std::vector<MaterialMatch> scalar;
+        MaterialScanStats vectorStats;
+        MaterialScanStats scalarStats;
+        index.scan(query, 3, vector, vectorStats, true);
+        index.scan(query, 3, scalar, scalarStats, false);
+        if (vector.size() != scan.games * 37) std::cerr << scan.material << " " << scan.pattern << ": " << vector.size() << " games" << std::endl;
+        CHECK(vector.size() == scan.games * 37);
+        CHECK(sameMatches(vector, scalar));
+        CHECK(vectorStats.matches == scalarStats.matches);
+        CHECK(vectorStats.records == index.recordCount() && scalarStats.records == index.recordCount());
+    }
+    return testResult();
+}
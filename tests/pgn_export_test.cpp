@@ -0,0 +1,51 @@
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <numeric>
+#include "classes/PgnExport.h"
+#include "TestGames.h"
+
+static std::string readFile(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+int main()
+{
+    const std::string base = testPath("export");
+    std::vector<std::vector<BitMove>> imported;
+    CHECK(importTestPgn(TestPgn, base, imported));
+    GameDatabase database;
+    CHECK(database.open(base));
+
+    // export on several threads, then import the written PGN again
+    std::vector<uint64_t> ids(database.size());
+    std::iota(ids.begin(), ids.end(), 0);
+    PgnExportOptions options;
+    options.threads = 3;
+    PgnExporter exporter(options);
+    const std::string exported = testPath("export_out.pgn");
+    CHECK(exporter.run(database, ids, exported));
+    CHECK(exporter.stats().games == database.size() && exporter.stats().failedGames == 0);
+
+    const std::string text = readFile(exported);
+    CHECK(text.find("17. Rd8# 1-0") != std::string::npos);
+    CHECK(text.find("12. O-O-O") != std::string::npos);
+    CHECK(text.find("40... b1=N") != std::string::npos);
+    CHECK(text.find("1. a8=Q+") != std::string::npos);
+
+    const std::string again = testPath("export_again");
+    std::vector<std::vector<BitMove>> reimported;
+    CHECK(importTestPgn(text, again, reimported));
+    CHECK(reimported.size() == imported.size());
+    for (size_t game = 0; game < std::min(imported.size(), reimported.size()); game++) {
+        CHECK(std::equal(imported[game].begin(), imported[game].end(), reimported[game].begin(), reimported[game].end()));
+    }
+
+    // the database written from the export is the same, byte for byte, as the one it was exported from
+    database.close();
+    CHECK(readFile(base + ".games") == readFile(again + ".games"));
+    CHECK(readFile(base + ".headers") == readFile(again + ".headers"));
+    return testResult();
+}
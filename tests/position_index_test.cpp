@@ -0,0 +1,57 @@
+#include <algorithm>
+#include <sstream>
+#include "classes/PositionIndex.h"
+#include "TestGames.h"
+
+int main()
+{
+    const std::string base = testPath("positions");
+    std::vector<std::vector<BitMove>> imported;
+    CHECK(importTestPgn(TestPgn, base, imported));
+    GameDatabase database;
+    CHECK(database.open(base));
+
+    PositionIndexOptions options;
+    options.threads = 2;
+    std::ostringstream log;
+    CHECK(PositionIndexBuilder(options).build(database, log));
+    PositionIndex index;
+    CHECK(index.open(base));
+
+    // replaying every game, each position it reaches is found at that game and ply
+    GameState position;
+    std::vector<BitMove> legal;
+    std::vector<PositionHit> hits;
+    uint64_t positions = 0;
+    for (uint64_t id = 0; id < database.size(); id++) {
+        CHECK(database.replay(id, position, legal, [&](int ply, const GameState& reached, const BitMove&) {
+            hits.clear();
+            const uint32_t total = index.find(reached.positionKey(), hits);
+            CHECK(total == hits.size() && total == index.count(reached.positionKey()));
+            CHECK(std::any_of(hits.begin(), hits.end(), [&](const PositionHit& hit) { return hit.game == id && hit.ply == ply; }));
+            // hits come in game order
+            CHECK(std::is_sorted(hits.begin(), hits.end(), [](const PositionHit& a, const PositionHit& b) { return a.game < b.game; }));
+            positions++;
+            return true;
+        }));
+    }
+    CHECK(index.postingCount() == positions);
+
+    // 1. d4 Nf6 2. c4 e6 and 1. c4 Nf6 2. d4 e6 reach the same position, and the limit stops the list
+    CHECK(position.initFromFEN("rnbqkb1r/pppp1ppp/4pn2/8/2PP4/8/PP2PPPP/RNBQKBNR w KQkq -"));
+    hits.clear();
+    CHECK(index.find(position.positionKey(), hits, 1) == 2);
+    CHECK(hits.size() == 1 && hits[0].game == 1 && hits[0].ply == 4);
+
+    // an en passant square no pawn can use does not split a position: after 1. e4 the FEN has e3 but the key does not
+    GameState withSquare;
+    CHECK(withSquare.initFromFEN("rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3"));
+    CHECK(position.initFromFEN("rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq -"));
+    CHECK(withSquare.positionKey() == position.positionKey());
+    CHECK(index.count(position.positionKey()) == 2);
+
+    // a position no game reached
+    CHECK(position.initFromFEN("4k3/8/8/8/8/8/8/4K3 w - -"));
+    CHECK(index.count(position.positionKey()) == 0);
+    return testResult();
+}
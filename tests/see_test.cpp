@@ -0,0 +1,41 @@
+#include "TestSupport.h"
+
+// exchanges on one square with their outcome for the side making the first capture,
+// in the piece values GameState::see uses: pawn 100, knight 200, bishop 230, rook 400, queen 900
+struct SeeCase {
+    const char* fen;
+    const char* move;
+    int score;
+};
+
+static const SeeCase Cases[] = {
+    // an undefended pawn
+    { "1k1r4/1pp4p/p7/4p3/8/P5P1/1PP4P/2K1R3 w - -", "e1e5", 100 },
+    // knight for pawn: the rook and queen behind the knight never get to win the exchange back
+    { "1k1r3q/1ppn3p/p4b2/4p3/8/P2N2P1/1PP1R1BP/2K1Q3 w - -", "d3e5", -100 },
+    // knight for knight
+    { "4k3/8/3p4/4n3/8/5N2/8/4K3 w - -", "f3e5", 0 },
+    // queen takes a defended pawn
+    { "4k3/8/5p2/4p3/8/8/4Q3/4K3 w - -", "e2e5", -800 },
+    // a promotion nothing can take back
+    { "8/1P6/8/8/8/8/8/k3K3 w - -", "b7b8q", 800 },
+    // en passant removes the pawn behind the square
+    { "4k3/8/8/3pP3/8/8/8/4K3 w - d6", "e5d6", 100 },
+    // the second rook recaptures through the square the first one left
+    { "4k3/3r4/8/3p4/8/8/3R4/3RK3 w - -", "d2d5", 100 },
+};
+
+int main()
+{
+    GameState position;
+    for (const SeeCase& test : Cases) {
+        CHECK(position.initFromFEN(test.fen));
+        const BitMove move = findMove(position, test.move);
+        CHECK(!move.isNull());
+        if (move.isNull()) continue;
+        const int score = position.see(move);
+        if (score != test.score) std::cerr << test.fen << " " << test.move << ": " << score << std::endl;
+        CHECK(score == test.score);
+    }
+    return testResult();
+}